@@ -95,7 +95,7 @@ namespace graphene { namespace app {
       }
       else if (api_name == monitoring_api::get_api_name() )
       {
-         _monitoring_api = std::make_shared< monitoring_api >();
+         _monitoring_api = std::make_shared< monitoring_api >( std::ref(_app) );
       }
    }
 
@@ -204,6 +204,7 @@ namespace graphene { namespace app {
       result.firewalled = info["firewalled"].as<graphene::net::firewalled_state>();
       result.listening_on = info["listening_on"].as<fc::ip::endpoint>();
       result.node_public_key = info["node_public_key"].as<graphene::net::node_id_t>();
+      result.traffic = info["traffic"].as<std::vector<graphene::net::message_type_traffic>>();
       return result;
    }
 
@@ -232,6 +233,9 @@ namespace graphene { namespace app {
       result.maximum_number_of_blocks_to_handle_at_one_time = result_variant["maximum_number_of_blocks_to_handle_at_one_time"].as<unsigned>();
       result.maximum_number_of_sync_blocks_to_prefetch = result_variant["maximum_number_of_sync_blocks_to_prefetch"].as<unsigned>();
       result.maximum_blocks_per_peer_during_syncing = result_variant["maximum_blocks_per_peer_during_syncing"].as<unsigned>();
+      result.message_cache_size_in_bytes = result_variant["message_cache_size_in_bytes"].as<uint64_t>();
+      result.inventory_advertisement_interval_ms = result_variant["inventory_advertisement_interval_ms"].as<uint32_t>();
+      result.inventory_advertisement_batch_size = result_variant["inventory_advertisement_batch_size"].as<uint32_t>();
       return result;
    }
 
@@ -244,6 +248,9 @@ namespace graphene { namespace app {
       params_variant["maximum_number_of_blocks_to_handle_at_one_time"] = params.maximum_number_of_blocks_to_handle_at_one_time;
       params_variant["maximum_number_of_sync_blocks_to_prefetch"] = params.maximum_number_of_sync_blocks_to_prefetch;
       params_variant["maximum_blocks_per_peer_during_syncing"] = params.maximum_blocks_per_peer_during_syncing;
+      params_variant["message_cache_size_in_bytes"] = params.message_cache_size_in_bytes;
+      params_variant["inventory_advertisement_interval_ms"] = params.inventory_advertisement_interval_ms;
+      params_variant["inventory_advertisement_batch_size"] = params.inventory_advertisement_batch_size;
       return _app.p2p_node()->set_advanced_node_parameters(params_variant);
    }
 
@@ -538,7 +545,7 @@ namespace graphene { namespace app {
       return _app.chain_database()->get_objects(message_ids);
    }
 
-   monitoring_api::monitoring_api()
+   monitoring_api::monitoring_api(application& a) : _app(a)
    {
    }
 
@@ -554,4 +561,16 @@ namespace graphene { namespace app {
       return result;
    }
 
+   chain::apply_timing_info monitoring_api::get_apply_timing() const
+   {
+      FC_VERIFY_AND_THROW(_app.chain_database(), database_not_available_exception);
+      return _app.chain_database()->get_apply_timing().get_info();
+   }
+
+   void monitoring_api::reset_apply_timing() const
+   {
+      FC_VERIFY_AND_THROW(_app.chain_database(), database_not_available_exception);
+      _app.chain_database()->get_apply_timing().reset();
+   }
+
 } } // graphene::app
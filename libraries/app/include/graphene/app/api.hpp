@@ -29,6 +29,7 @@
 #include <fc/monitoring.hpp>
 
 #include <graphene/chain/protocol/asset.hpp>
+#include <graphene/chain/apply_timing.hpp>
 #include <graphene/chain/message_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/net/node.hpp>
@@ -70,6 +71,7 @@ namespace graphene { namespace app {
        net::node_id_t node_id;
        net::firewalled_state firewalled;
        uint32_t connection_count;
+       std::vector<net::message_type_traffic> traffic; ///< of all connected peers by message type, over the traffic statistics window
     };
 
     struct advanced_node_parameters
@@ -80,6 +82,9 @@ namespace graphene { namespace app {
        unsigned maximum_number_of_blocks_to_handle_at_one_time;
        unsigned maximum_number_of_sync_blocks_to_prefetch;
        unsigned maximum_blocks_per_peer_during_syncing;
+       uint64_t message_cache_size_in_bytes;
+       uint32_t inventory_advertisement_interval_ms;
+       uint32_t inventory_advertisement_batch_size;
     };
 
    /**
@@ -242,7 +247,7 @@ namespace graphene { namespace app {
          std::string info() const { return get_api_name(); }
 
          /**
-          * @brief Returns general network information, such as p2p port.
+          * @brief Returns general network information, such as p2p port and the recent traffic by message type.
           * @return general network information
           * @ingroup Network_NodeAPI
           */
@@ -398,7 +403,7 @@ namespace graphene { namespace app {
    class monitoring_api : public fc::api_base<monitoring_api>
    {
    public:
-      monitoring_api();
+      monitoring_api(application& a);
 
       /**
       * @brief Get the name of the API.
@@ -421,6 +426,22 @@ namespace graphene { namespace app {
       * @ingroup MonitoringAPI
       */
       std::vector<monitoring::counter_item> get_counters(const std::vector<std::string>& names) const;
+
+      /**
+      * @brief Retrieves execution time statistics of block phases and operation evaluators over the sliding window.
+      * @return Min, avg, max and percentiles in microseconds per block phase and per applied operation type.
+      * @ingroup MonitoringAPI
+      */
+      chain::apply_timing_info get_apply_timing() const;
+
+      /**
+      * @brief Clears collected execution time statistics of block phases and operation evaluators.
+      * @ingroup MonitoringAPI
+      */
+      void reset_apply_timing() const;
+
+   private:
+      application& _app;
    };
 
    /**
@@ -517,8 +538,8 @@ namespace graphene { namespace app {
 FC_REFLECT( graphene::app::network_broadcast_api::transaction_confirmation, (id)(block_num)(trx_num)(trx) )
 FC_REFLECT( graphene::app::asset_array, (asset0)(asset1) )
 FC_REFLECT( graphene::app::balance_change_result, (hist_object)(balance)(fee)(timestamp)(transaction_id) )
-FC_REFLECT( graphene::app::network_node_info, (listening_on)(node_public_key)(node_id)(firewalled)(connection_count) )
-FC_REFLECT( graphene::app::advanced_node_parameters, (peer_connection_retry_timeout)(desired_number_of_connections)(maximum_number_of_connections)(maximum_number_of_blocks_to_handle_at_one_time)(maximum_number_of_sync_blocks_to_prefetch)(maximum_blocks_per_peer_during_syncing) )
+FC_REFLECT( graphene::app::network_node_info, (listening_on)(node_public_key)(node_id)(firewalled)(connection_count)(traffic) )
+FC_REFLECT( graphene::app::advanced_node_parameters, (peer_connection_retry_timeout)(desired_number_of_connections)(maximum_number_of_connections)(maximum_number_of_blocks_to_handle_at_one_time)(maximum_number_of_sync_blocks_to_prefetch)(maximum_blocks_per_peer_during_syncing)(message_cache_size_in_bytes)(inventory_advertisement_interval_ms)(inventory_advertisement_batch_size) )
 
 FC_API(graphene::app::history_api,
        (info)
@@ -559,6 +580,8 @@ FC_API(graphene::app::monitoring_api,
    (info)
       (reset_counters)
       (get_counters)
+      (get_apply_timing)
+      (reset_apply_timing)
    )
 FC_API(graphene::app::login_api,
        (info)
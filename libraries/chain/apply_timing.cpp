@@ -0,0 +1,174 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/chain/apply_timing.hpp>
+#include <graphene/chain/protocol/operations.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+   struct operation_name_visitor
+   {
+      typedef std::string result_type;
+
+      template<typename Type>
+      result_type operator()( const Type& )const
+      {
+         const static std::string prefix = "graphene::chain::";
+         std::string name = fc::get_typename<Type>::name();
+         if( name.compare( 0, prefix.size(), prefix ) == 0 )
+            name.erase( 0, prefix.size() );
+         return name;
+      }
+   };
+
+   int64_t percentile( const std::vector<int64_t>& sorted, uint32_t pct )
+   {
+      size_t idx = ( sorted.size() - 1 ) * pct / 100;
+      return sorted[idx];
+   }
+
+} // namespace
+
+const size_t timing_window::max_unbounded_window_size;
+
+timing_window::timing_window( size_t window_size )
+: _samples( window_size ), _window_size( window_size )
+{
+}
+
+void timing_window::record( int64_t duration, bool unbounded )
+{
+   if( unbounded && _samples.full() && _samples.capacity() < max_unbounded_window_size )
+      _samples.set_capacity( std::min<size_t>( std::max<size_t>( _samples.capacity() * 2, 1 ), max_unbounded_window_size ) );
+
+   if( _samples.capacity() )
+      _samples.push_back( duration );
+   ++_total_samples;
+}
+
+void timing_window::set_window_size( size_t window_size )
+{
+   _window_size = window_size;
+   _samples.set_capacity( window_size );
+}
+
+void timing_window::reset()
+{
+   _samples.clear();
+   _samples.set_capacity( _window_size );
+   _total_samples = 0;
+}
+
+timing_statistics timing_window::get_statistics( const std::string& name ) const
+{
+   timing_statistics result;
+   result.name = name;
+   result.samples = _samples.size();
+   result.total_samples = _total_samples;
+   if( _samples.empty() )
+      return result;
+
+   std::vector<int64_t> sorted( _samples.begin(), _samples.end() );
+   std::sort( sorted.begin(), sorted.end() );
+
+   int64_t sum = 0;
+   for( int64_t sample : sorted )
+      sum += sample;
+
+   result.min = sorted.front();
+   result.max = sorted.back();
+   result.avg = sum / static_cast<int64_t>( sorted.size() );
+   result.p50 = percentile( sorted, 50 );
+   result.p90 = percentile( sorted, 90 );
+   result.p99 = percentile( sorted, 99 );
+   return result;
+}
+
+apply_timing::apply_timing()
+{
+   operation op;
+   for( size_t i = 0; i < operation::type_info::count; ++i )
+   {
+      op.set_which( i );
+      _operation_names.push_back( op.visit( operation_name_visitor() ) );
+   }
+
+   _operations.resize( _operation_names.size() );
+   set_window_size( _window_size );
+}
+
+void apply_timing::set_window_size( size_t window_size )
+{
+   _window_size = window_size;
+   for( timing_window& w : _phases )
+      w.set_window_size( window_size );
+   for( timing_window& w : _operations )
+      w.set_window_size( window_size );
+}
+
+void apply_timing::record_phase( block_phase phase, const fc::microseconds& duration )
+{
+   _phases[phase].record( duration.count(), _unbounded );
+}
+
+void apply_timing::record_operation( int which, const fc::microseconds& duration )
+{
+   if( which >= 0 && static_cast<size_t>( which ) < _operations.size() )
+      _operations[which].record( duration.count(), _unbounded );
+}
+
+void apply_timing::reset()
+{
+   for( timing_window& w : _phases )
+      w.reset();
+   for( timing_window& w : _operations )
+      w.reset();
+}
+
+apply_timing_info apply_timing::get_info() const
+{
+   apply_timing_info result;
+   result.window_size = static_cast<uint32_t>( _window_size );
+   result.record_replay = _record_replay;
+
+   for( size_t i = 0; i < block_phase_count; ++i )
+      result.block_phases.push_back( _phases[i].get_statistics( get_phase_name( static_cast<block_phase>( i ) ) ) );
+
+   for( size_t i = 0; i < _operations.size(); ++i )
+   {
+      if( _operations[i].total_samples() )
+         result.operations.push_back( _operations[i].get_statistics( _operation_names[i] ) );
+   }
+
+   return result;
+}
+
+const char* apply_timing::get_phase_name( block_phase phase )
+{
+   switch( phase )
+   {
+      case apply_block_total:              return "apply_block";
+      case prevalidate_transactions:       return "prevalidate_transactions";
+      case merkle_check:                   return "merkle_check";
+      case validate_block_header:          return "validate_block_header";
+      case apply_transactions:             return "apply_transactions";
+      case update_global_dynamic_data:     return "update_global_dynamic_data";
+      case update_signing_miner:           return "update_signing_miner";
+      case update_last_irreversible_block: return "update_last_irreversible_block";
+      case perform_chain_maintenance:      return "perform_chain_maintenance";
+      case create_block_summary:           return "create_block_summary";
+      case clear_expired_transactions:     return "clear_expired_transactions";
+      case clear_expired_proposals:        return "clear_expired_proposals";
+      case update_expired_feeds:           return "update_expired_feeds";
+      case update_withdraw_permissions:    return "update_withdraw_permissions";
+      case update_maintenance_flag:        return "update_maintenance_flag";
+      case update_miner_schedule:          return "update_miner_schedule";
+      case applied_block_signal:           return "applied_block";
+      case notify_changed_objects:         return "notify_changed_objects";
+      default:                             return "unknown";
+   }
+}
+
+} } // graphene::chain
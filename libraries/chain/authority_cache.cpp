@@ -0,0 +1,57 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/chain/authority_cache.hpp>
+#include <graphene/chain/account_object.hpp>
+
+namespace graphene { namespace chain {
+
+void authority_cache::object_removed( const graphene::db::object& obj )
+{
+   clear();
+}
+
+fc::sha256 authority_cache::authorities_digest( const graphene::db::object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   fc::sha256::encoder enc;
+   fc::raw::pack( enc, a.owner );
+   fc::raw::pack( enc, a.active );
+   return enc.result();
+}
+
+void authority_cache::about_to_modify( const graphene::db::object& before )
+{
+   // accounts are modified by many operations, nothing is remembered while there is nothing to invalidate
+   _modification_tracked = !_approved.empty();
+   if( _modification_tracked )
+      _before_authorities = authorities_digest( before );
+}
+
+void authority_cache::object_modified( const graphene::db::object& after )
+{
+   // a cached result may depend on this account through account_auths of any other account
+   if( _modification_tracked && authorities_digest( after ) != _before_authorities )
+      clear();
+   _modification_tracked = false;
+}
+
+bool authority_cache::is_approved( const entry& e )const
+{
+   if( _approved.find( e ) != _approved.end() )
+   {
+      ++_hits;
+      return true;
+   }
+
+   ++_misses;
+   return false;
+}
+
+void authority_cache::add_approved( entry&& e )
+{
+   if( _approved.size() >= max_entries )
+      clear();
+   _approved.insert( std::move( e ) );
+}
+
+} } // graphene::chain
@@ -28,10 +28,12 @@
 #include <graphene/chain/hardfork.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/authority_cache.hpp>
 #include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/transaction_object.hpp>
+#include <graphene/chain/transaction_prevalidator.hpp>
 #include <graphene/chain/miner_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/exceptions.hpp>
@@ -488,7 +490,24 @@ void database::apply_block( const signed_block& next_block, uint32_t skip, bool
          FC_ASSERT( next_block.id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block.id()) );
 
       if( _checkpoints.rbegin()->first >= block_num )
-         skip = ~0;// WE CAN SKIP ALMOST EVERYTHING
+         skip = ~uint32_t(skip_trusted_block);// WE CAN SKIP ALMOST EVERYTHING
+   }
+
+   const fc::optional<block_id_type>& trusted_block_id = get_node_properties().trusted_block_id;
+   if( trusted_block_id.valid() )
+   {
+      uint32_t trusted_block_num = block_header::num_from_id( *trusted_block_id );
+      if( block_num == trusted_block_num )
+         FC_ASSERT( next_block.id() == *trusted_block_id, "Block did not match trusted block", ("trusted",*trusted_block_id)("block_id",next_block.id()) );
+
+      // the block database holds the trusted block, and the blocks it links to by their numbers, so a block found
+      // there is an ancestor of the trusted block, a block at the same height from a peer is not trusted
+      if( block_num <= trusted_block_num )
+      {
+         const signed_block_header* trusted_block = get_trusted_block();
+         if( trusted_block && _block_id_to_block.contains( next_block.id() ) )
+            skip |= keep_recent_dupe_check( trusted_replay_skip_flags, next_block, trusted_block->timestamp );
+      }
    }
 
    detail::with_skip_flags( *this, skip, [&]()
@@ -498,64 +517,122 @@ void database::apply_block( const signed_block& next_block, uint32_t skip, bool
    return;
 }
 
+const signed_block_header* database::get_trusted_block()
+{
+   const block_id_type& trusted_block_id = *get_node_properties().trusted_block_id;
+   if( !_trusted_block_looked_up.valid() || *_trusted_block_looked_up != trusted_block_id )
+   {
+      _trusted_block_looked_up = trusted_block_id;
+      _trusted_block.reset();
+      if( _block_id_to_block.is_open() )
+      {
+         fc::optional<signed_block> block = _block_id_to_block.fetch_optional( trusted_block_id );
+         if( block.valid() )
+            _trusted_block = signed_block_header( *block );
+      }
+   }
+   return _trusted_block.valid() ? &*_trusted_block : nullptr;
+}
+
+uint32_t database::keep_recent_dupe_check( uint32_t skip, const signed_block& next_block, const fc::time_point_sec& reference_time )const
+{
+   // transactions which did not expire by reference_time must be known to the dupe check of the blocks after it,
+   // the check records them as well
+   if( (skip & skip_transaction_dupe_check) &&
+       next_block.timestamp + get_global_properties().parameters.maximum_time_until_expiration >= reference_time )
+      skip &= ~uint32_t(skip_transaction_dupe_check);
+   return skip;
+}
+
 void database::_apply_block( const signed_block& next_block, bool sync_mode )
 { try {
+   fc::time_point apply_start = fc::time_point::now();
    uint32_t next_block_num = next_block.block_num();
    uint32_t skip = get_node_properties().skip_flags;
    _applied_ops.clear();
 
-   FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
+   // stateless checks of all transactions run in parallel before the state is touched
+   std::vector<precomputed_transaction> precomputed;
+   _apply_timing.measure_phase( apply_timing::prevalidate_transactions, [&]() {
+      precomputed = _prevalidator->run( next_block.transactions, !(skip & skip_trusted_block) || !(skip & skip_validate), !(skip & skip_merkle_check) );
+   } );
+
+   _apply_timing.measure_phase( apply_timing::merkle_check, [&]() {
+      if( !(skip & skip_merkle_check) )
+      {
+         std::vector<digest_type> merkle_digests;
+         merkle_digests.reserve( precomputed.size() );
+         for( const precomputed_transaction& pre : precomputed )
+            merkle_digests.push_back( pre.merkle_digest );
+         FC_ASSERT( next_block.transaction_merkle_root == signed_block::calculate_merkle_root( std::move( merkle_digests ) ), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
+      }
+   } );
 
-   const miner_object& signing_miner = validate_block_header(skip, next_block);
+   const miner_object* signing_miner = nullptr;
+   _apply_timing.measure_phase( apply_timing::validate_block_header, [&]() { signing_miner = &validate_block_header(skip, next_block); } );
    const auto& dynamic_global_props = get<dynamic_global_property_object>(dynamic_global_property_id_type());
    bool maint_needed = (dynamic_global_props.next_maintenance_time <= next_block.timestamp)  ;
 
    _current_op_info.block_num    = next_block_num;
    _current_op_info.trx_in_block = 0;
 
-   for( const auto& trx : next_block.transactions )
-   {
-      /* We do not need to push the undo state for each transaction
-       * because they either all apply and are valid or the
-       * entire block fails to apply.  We only need an "undo" state
-       * for transactions when validating broadcast transactions or
-       * when building a block.
-       */
-      apply_transaction( trx, skip | skip_transaction_signatures );
-      ++_current_op_info.trx_in_block;
-   }
+   uint64_t ops_in_block = 0;
+   _apply_timing.measure_phase( apply_timing::apply_transactions, [&]() {
+      for( size_t i = 0; i < next_block.transactions.size(); ++i )
+      {
+         const processed_transaction& trx = next_block.transactions[i];
+         /* We do not need to push the undo state for each transaction
+          * because they either all apply and are valid or the
+          * entire block fails to apply.  We only need an "undo" state
+          * for transactions when validating broadcast transactions or
+          * when building a block.
+          */
+         detail::with_skip_flags( *this, skip | skip_transaction_signatures, [&]()
+         {
+            _apply_transaction( trx, &precomputed[i] );
+         });
+         ++_current_op_info.trx_in_block;
+         ops_in_block += trx.operations.size();
+      }
+   } );
 
-   update_global_dynamic_data(next_block);
-   update_signing_miner(signing_miner, next_block);
-   update_last_irreversible_block();
+   _apply_timing.measure_phase( apply_timing::update_global_dynamic_data, [&]() { update_global_dynamic_data(next_block); } );
+   _apply_timing.measure_phase( apply_timing::update_signing_miner, [&]() { update_signing_miner(*signing_miner, next_block); } );
+   _apply_timing.measure_phase( apply_timing::update_last_irreversible_block, [&]() { update_last_irreversible_block(); } );
 
    // Are we at the maintenance interval?
    if( maint_needed )
-      perform_chain_maintenance(next_block);
+      _apply_timing.measure_phase( apply_timing::perform_chain_maintenance, [&]() { perform_chain_maintenance(next_block); } );
 
-   create_block_summary(next_block);
-   clear_expired_transactions();
-   clear_expired_proposals();
-   update_expired_feeds();
-   update_withdraw_permissions();
+   _apply_timing.measure_phase( apply_timing::create_block_summary, [&]() { create_block_summary(next_block); } );
+   _apply_timing.measure_phase( apply_timing::clear_expired_transactions, [&]() { clear_expired_transactions(); } );
+   _apply_timing.measure_phase( apply_timing::clear_expired_proposals, [&]() { clear_expired_proposals(); } );
+   _apply_timing.measure_phase( apply_timing::update_expired_feeds, [&]() { update_expired_feeds(); } );
+   _apply_timing.measure_phase( apply_timing::update_withdraw_permissions, [&]() { update_withdraw_permissions(); } );
 
    // n.b., update_maintenance_flag() happens this late
    // because get_slot_time() / get_slot_at_time() is needed above
    // TODO:  figure out if we could collapse this function into
    // update_global_dynamic_data() as perhaps these methods only need
    // to be called for header validation?
-   update_maintenance_flag( maint_needed );
-   update_miner_schedule();
+   _apply_timing.measure_phase( apply_timing::update_maintenance_flag, [&]() { update_maintenance_flag( maint_needed ); } );
+   _apply_timing.measure_phase( apply_timing::update_miner_schedule, [&]() { update_miner_schedule(); } );
 
    // notify observers that the block has been applied
-   applied_block( next_block ); //emit
+   _apply_timing.measure_phase( apply_timing::applied_block_signal, [&]() { applied_block( next_block ); } ); //emit
 
    MONITORING_COUNTER_VALUE(blocks_applied)++;
    MONITORING_COUNTER_VALUE(transactions_in_applied_blocks) += _current_op_info.trx_in_block;
+   MONITORING_COUNTER_VALUE(operations_in_applied_blocks) += ops_in_block;
 
    _applied_ops.clear();
 
-   notify_changed_objects(sync_mode);
+   _apply_timing.measure_phase( apply_timing::notify_changed_objects, [&]() { notify_changed_objects(sync_mode); } );
+
+   fc::microseconds apply_duration = fc::time_point::now() - apply_start;
+   MONITORING_COUNTER_VALUE(block_apply_time_us) += apply_duration.count();
+   if( _apply_timing.is_enabled() )
+      _apply_timing.record_phase( apply_timing::apply_block_total, apply_duration );
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
 void database::notify_changed_objects(bool sync_mode)
@@ -582,15 +659,26 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+processed_transaction database::_apply_transaction(const signed_transaction& trx, const precomputed_transaction* precomputed)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
-   if( true || !(skip&skip_validate) )   /* issue #505 explains why this skip_flag is disabled */
-      trx.validate();
+   transaction_id_type trx_id;
+   if( precomputed )
+   {
+      if( precomputed->validation_error )
+         std::rethrow_exception( precomputed->validation_error );
+      trx_id = precomputed->id;
+   }
+   else
+   {
+      /* issue #505 explains why this skip_flag is honoured only for trusted blocks */
+      if( !(skip & skip_trusted_block) || !(skip & skip_validate) )
+         trx.validate();
+      trx_id = trx.id();
+   }
 
    auto& trx_idx = get_index_type<transaction_index>().indices().get<by_trx_id>();
-   auto trx_id = trx.id();
    FC_ASSERT( (skip & skip_transaction_dupe_check) || trx_idx.find(trx_id) == trx_idx.end() );
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
@@ -598,9 +686,32 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
 
    if( !(skip & (skip_transaction_signatures | skip_authority_check) ) )
    {
-      auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
-      auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
-      trx.verify_authority( trx.get_signature_keys(get_chain_id()), get_active, get_owner, get_global_properties().parameters.max_authority_depth );
+      // transactions with the same required accounts and signature keys have the same result, see authority_cache
+      authority_cache::entry cache_entry;
+      std::vector<authority> other;
+      trx.get_required_authorities( cache_entry.required_active, cache_entry.required_owner, other );
+      cache_entry.keys = trx.get_signature_keys(get_chain_id());
+      cache_entry.max_authority_depth = chain_parameters.max_authority_depth;
+
+      authority_cache& auth_cache = get_authority_cache();
+      bool approved = false;
+      if( other.empty() )
+      {
+         approved = auth_cache.is_approved( cache_entry );
+         if( approved )
+            MONITORING_COUNTER_VALUE(authority_cache_hits)++;
+         else
+            MONITORING_COUNTER_VALUE(authority_cache_misses)++;
+      }
+      if( !approved )
+      {
+         auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
+         auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
+         trx.verify_authority( cache_entry.required_active, cache_entry.required_owner, other, cache_entry.keys,
+                               get_active, get_owner, cache_entry.max_authority_depth );
+         if( other.empty() )
+            auth_cache.add_approved( std::move( cache_entry ) );
+      }
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -644,9 +755,12 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    ptrx.operation_results = std::move(eval_state.operation_results);
 
    //Make sure the temp account has no non-zero balances
-   const auto& index = get_index_type<account_balance_index>().indices().get<by_account_asset>();
-   auto range = index.equal_range( boost::make_tuple( GRAPHENE_TEMP_ACCOUNT ) );
-   std::for_each(range.first, range.second, [](const account_balance_object& b) { FC_ASSERT(b.balance == 0); });
+   if( !(skip & skip_trusted_block) )
+   {
+      const auto& index = get_index_type<account_balance_index>().indices().get<by_account_asset>();
+      auto range = index.equal_range( boost::make_tuple( GRAPHENE_TEMP_ACCOUNT ) );
+      std::for_each(range.first, range.second, [](const account_balance_object& b) { FC_ASSERT(b.balance == 0); });
+   }
 
    return ptrx;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
@@ -663,7 +777,15 @@ operation_result database::apply_operation(transaction_evaluation_state& eval_st
    if( !eval )
       assert( "No registered evaluator for this operation" && false );
    auto op_id = push_applied_operation( op );
-   auto result = eval->evaluate( eval_state, op, true );
+   operation_result result;
+   if( _apply_timing.is_enabled() )
+   {
+      fc::time_point start = fc::time_point::now();
+      result = eval->evaluate( eval_state, op, true );
+      _apply_timing.record_operation( i_which, fc::time_point::now() - start );
+   }
+   else
+      result = eval->evaluate( eval_state, op, true );
    set_applied_operation_result( op_id, result );
    return result;
 } FC_CAPTURE_AND_RETHROW( (op) ) }
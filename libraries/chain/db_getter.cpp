@@ -25,6 +25,8 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/authority_cache.hpp>
 #include <graphene/chain/chain_property_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 
@@ -92,6 +94,12 @@ node_property_object& database::node_properties()
    return _node_property_object;
 }
 
+authority_cache& database::get_authority_cache()
+{
+   auto& idx = dynamic_cast<graphene::db::primary_index<account_index>&>( get_mutable_index_type<account_index>() );
+   return idx.get_secondary_index<authority_cache>();
+}
+
 uint32_t database::last_non_undoable_block_num() const
 {
    return head_block_num() - static_cast<uint32_t>(_undo_db.size());
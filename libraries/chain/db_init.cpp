@@ -25,6 +25,7 @@
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/authority_cache.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/budget_record_object.hpp>
@@ -128,6 +129,7 @@ void database::initialize_indexes()
    //Protocol object indexes
    auto acnt_index = add_index< graphene::db::primary_index<account_index> >();
    acnt_index->add_secondary_index<account_member_index>();
+   acnt_index->add_secondary_index<authority_cache>();
 
    add_index< graphene::db::primary_index<asset_index> >();
    add_index< graphene::db::primary_index<miner_index> >();
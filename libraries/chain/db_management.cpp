@@ -24,8 +24,11 @@
  */
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/authority_cache.hpp>
+#include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
+#include <graphene/chain/transaction_prevalidator.hpp>
 #include <boost/filesystem.hpp>
 #include <fc/io/fstream.hpp>
 #include <fstream>
@@ -37,6 +40,8 @@ namespace graphene { namespace chain {
 database::database(const std::vector< uint8_t >& object_type_count)
 : object_database(object_type_count)
 {
+   _prevalidator.reset( new transaction_prevalidator( default_prevalidation_threads() ) );
+
    initialize_indexes();
    initialize_evaluators();
 }
@@ -46,9 +51,37 @@ database::~database()
    clear_pending();
 }
 
+uint32_t database::default_prevalidation_threads()
+{
+   // the database thread runs its share of the pre-validation as well
+   uint32_t cores = std::thread::hardware_concurrency();
+   return cores > 1 ? cores - 1 : 0;
+}
+
+uint32_t database::get_prevalidation_threads() const
+{
+   return _prevalidator->get_worker_count();
+}
+
+void database::set_prevalidation_threads( uint32_t thread_count )
+{
+   _prevalidator->set_worker_count( thread_count );
+}
+
 void database::reindex(boost::filesystem::path data_dir, const genesis_state_type& initial_allocation)
 { try {
       dlog("reindexing blockchain");
+      // a database initialized from a snapshot has no blocks before it, the snapshot is imported again instead
+      boost::filesystem::path marker_file = state_snapshot_marker_file( data_dir );
+      if( exists( marker_file ) )
+      {
+         std::string snapshot_file;
+         fc::read_file_contents( marker_file, snapshot_file );
+         FC_ASSERT( exists( boost::filesystem::path( snapshot_file ) ),
+                    "The database was initialized from state snapshot ${f} which is required to reindex it", ("f", snapshot_file) );
+         _state_snapshot_to_import = boost::filesystem::path( snapshot_file );
+      }
+
       wipe(data_dir, false);
       open(data_dir, [&initial_allocation] {return initial_allocation; });
 
@@ -60,18 +93,26 @@ void database::reindex(boost::filesystem::path data_dir, const genesis_state_typ
          return;
       }
 
+      const auto first_block_num = head_block_num() + 1;
       const auto last_block_num = last_block->block_num();
 
       ilog("Replaying blocks...");
+      if( _node_property_object.trusted_block_id.valid() )
+         ilog("Using trusted replay profile up to block ${b}", ("b", *_node_property_object.trusted_block_id));
       _undo_db.disable();
-      double reindexing_status = 0.0;
-      double one_perc_step = last_block_num / 100.0;
-      for (uint32_t i = 1; i <= last_block_num; ++i)
+      if( _apply_timing.get_record_replay() )
+      {
+         _apply_timing.reset();
+         _apply_timing.set_unbounded(true);
+      }
+      double reindexing_status = first_block_num - 1;
+      double one_perc_step = ( last_block_num - first_block_num + 1 ) / 100.0;
+      for (uint32_t i = first_block_num; i <= last_block_num; ++i)
       {
          if (reindexing_status <= (i - 1))
          {
             // report progress done so far
-            auto progress = static_cast<uint8_t>((i - 1) * 100.0 / last_block_num);
+            auto progress = static_cast<uint8_t>((i - first_block_num) * 100.0 / (last_block_num - first_block_num + 1));
             reindexing_progress(progress);
             reindexing_status += one_perc_step;
             ilog("${p}%: ${i}/${t}", ("p", progress) ("i", i - 1) ("t", last_block_num));
@@ -97,24 +138,34 @@ void database::reindex(boost::filesystem::path data_dir, const genesis_state_typ
             wlog("Dropped ${n} blocks from after the gap", ("n", dropped_count));
             break;
          }
-         apply_block(*block, skip_miner_signature |
-            skip_transaction_signatures |
-            skip_transaction_dupe_check |
-            skip_tapos_check |
-            skip_miner_schedule_check |
-            skip_authority_check);
+         // apply_block() adds the trusted replay profile up to the trusted block
+         apply_block(*block, keep_recent_dupe_check(replay_skip_flags, *block, last_block->timestamp));
 
       }
       ilog("100%: ${t}/${t}", ("t", last_block_num));
       ilog("Done reindexing, elapsed time: ${t} sec", ("t", double((fc::time_point::now() - start).count()) / 1000000.0));
       reindexing_progress(100);
       _undo_db.enable();
+
+      if( _apply_timing.get_record_replay() )
+      {
+         _apply_timing.set_unbounded(false);
+         for( const timing_statistics& phase : _apply_timing.get_info().block_phases )
+            ilog("Replay timing ${n}: ${c} samples, min ${min} us, avg ${avg} us, max ${max} us, p99 ${p99} us",
+                 ("n", phase.name)("c", phase.total_samples)("min", phase.min)("avg", phase.avg)("max", phase.max)("p99", phase.p99));
+      }
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+boost::filesystem::path database::state_snapshot_marker_file( const boost::filesystem::path& data_dir )
+{
+   return data_dir / "database" / "state_snapshot";
+}
+
 void database::wipe(const boost::filesystem::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database (including blocks: ${blocks})", ("blocks", include_blocks));
-   close();
+   // neither a journal nor a rewind is needed for a state which is deleted
+   close(false);
    object_database::wipe(data_dir);
    if( include_blocks )
       remove_all( data_dir / "database" );
@@ -129,9 +180,29 @@ void database::open(
       object_database::open(data_dir );
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
+      _trusted_block_looked_up.reset();
+      _trusted_block.reset();
 
+      bool imported_snapshot = false;
       if( !find(global_property_id_type()) )
-         init_genesis(genesis_loader());
+      {
+         if( _state_snapshot_to_import.valid() )
+         {
+            import_state_snapshot( *_state_snapshot_to_import, genesis_loader().compute_chain_id() );
+            // the blocks before the snapshot are missing, reindex has to start from the snapshot again
+            std::ofstream marker( state_snapshot_marker_file( data_dir ).generic_string(), std::ofstream::out | std::ofstream::trunc );
+            marker << boost::filesystem::absolute( *_state_snapshot_to_import ).generic_string();
+            marker.close();
+            FC_ASSERT( marker, "Unable to write ${f}", ("f", state_snapshot_marker_file( data_dir )) );
+            imported_snapshot = true;
+         }
+         else
+            init_genesis(genesis_loader());
+      }
+      else if( _state_snapshot_to_import.valid() )
+      {
+         wlog( "Existing database found, state snapshot ${f} is not imported", ("f", *_state_snapshot_to_import) );
+      }
 
       fc::optional<signed_block> last_block = _block_id_to_block.last();
       if( last_block.valid() )
@@ -145,45 +216,159 @@ void database::open(
             ddump((_fork_db.head()->data));
             ddump((_fork_db.head()->num));
 
-            FC_ASSERT( head_block_num() == 0, "last block ID does not match current chain state" );
+            // a reindex continues with the blocks received after the imported snapshot
+            FC_ASSERT( head_block_num() == 0 || ( imported_snapshot && _block_id_to_block.contains( head_block_id() ) ),
+                       "last block ID does not match current chain state" );
          }
       }
+
+      if( !load_reversible_block_journal() &&
+          head_block_num() > get_dynamic_global_properties().last_irreversible_block_num )
+      {
+         // the reversible blocks can not be undone without their undo history, the state is rebuilt from the blocks
+         wlog( "No undo history for the blocks after the last irreversible block ${n}, replaying the blockchain",
+               ("n", get_dynamic_global_properties().last_irreversible_block_num) );
+         reindex( data_dir, genesis_loader() );
+      }
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
-void database::close(bool rewind)
+void database::pop_reversible_blocks()
 {
-   // TODO:  Save pending tx's on close()
-   clear_pending();
    // pop all of the blocks that we can given our undo history, this should
    // throw when there is no more undo history to pop
-   if( rewind )
+   try
    {
-      try
+      uint32_t cutoff = get_dynamic_global_properties().last_irreversible_block_num;
+      while( head_block_num() > cutoff )
       {
-         uint32_t cutoff = get_dynamic_global_properties().last_irreversible_block_num;
-         while( head_block_num() > cutoff )
+         block_id_type popped_block_id = head_block_id();
+         pop_block();
+         _fork_db.remove(popped_block_id); // doesn't throw on missing
+         try
+         {
+            _block_id_to_block.remove(popped_block_id);
+         }
+         catch (const fc::key_not_found_exception&)
+         {
+         }
+      }
+   } catch (const fc::exception &){
+      //elog("database::close Exception caught");
+      //elog( "${details}", ("details",er.to_detail_string()) );
+   } catch (...)
+   {
+      //elog("database::close Exception caught");
+   }
+}
+
+bool database::save_reversible_block_journal()
+{
+   if( get_data_dir().empty() || !find(dynamic_global_property_id_type()) )
+      return false;
+
+   try
+   {
+      const uint32_t first_num = last_non_undoable_block_num();
+      reversible_block_journal journal;
+      journal.head_block_id = head_block_id();
+
+      // the oldest block of the head branch goes first, the fork database is restored starting with it
+      item_ptr root = _fork_db.head();
+      FC_ASSERT( root && root->id == head_block_id(), "Fork database does not match the head block" );
+      for( item_ptr prev = root->prev.lock(); prev && prev->num >= first_num; prev = prev->prev.lock() )
+         root = prev;
+      journal.blocks.push_back( root->data );
+      for( const item_ptr& item : _fork_db.fetch_blocks_from_number( first_num ) )
+         if( item != root )
+            journal.blocks.push_back( item->data );
+      journal.undo_history = _undo_db.pack_history();
+
+      boost::filesystem::path journal_file = get_data_dir() / "database" / "reversible_blocks";
+      create_directories( journal_file.parent_path() );
+      std::ofstream out( journal_file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      fc::raw::pack( out, journal );
+      fc::raw::pack( out, fc::sha256::hash( journal ) );
+      out.close();
+      FC_ASSERT( out, "Unable to write ${f}", ("f", journal_file) );
+
+      ilog( "Saved ${n} reversible blocks and ${u} undo states", ("n", journal.blocks.size())("u", _undo_db.size()) );
+      return true;
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to save reversible blocks: ${e}", ("e", e.to_detail_string()) );
+   }
+   return false;
+}
+
+bool database::load_reversible_block_journal()
+{
+   boost::filesystem::path journal_file = get_data_dir() / "database" / "reversible_blocks";
+   if( !exists( journal_file ) )
+      return false;
+
+   bool loaded = false;
+   try
+   {
+      std::string data;
+      fc::read_file_contents( journal_file, data );
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      reversible_block_journal journal;
+      fc::sha256 checksum;
+      fc::raw::unpack( ds, journal );
+      fc::raw::unpack( ds, checksum );
+      FC_ASSERT( checksum == fc::sha256::hash( journal ), "Checksum mismatch" );
+      FC_ASSERT( journal.version == reversible_block_journal::current_version, "Unsupported version ${v}", ("v", journal.version) );
+
+      if( journal.head_block_id == head_block_id() && !journal.blocks.empty() )
+      {
+         _fork_db.reset();
+         _fork_db.start_block( journal.blocks.front() );
+         for( size_t i = 1; i < journal.blocks.size(); ++i )
          {
-            block_id_type popped_block_id = head_block_id();
-            pop_block();
-            _fork_db.remove(popped_block_id); // doesn't throw on missing
             try
             {
-               _block_id_to_block.remove(popped_block_id);
+               _fork_db.push_block( journal.blocks[i] );
             }
-            catch (const fc::key_not_found_exception&)
+            catch( const unlinkable_block_exception& )
             {
             }
          }
-      } catch (const fc::exception &){
-         //elog("database::close Exception caught");
-         //elog( "${details}", ("details",er.to_detail_string()) );
-      } catch (...)
+         item_ptr head = _fork_db.fetch_block( head_block_id() );
+         FC_ASSERT( head, "Head block is not in the journal" );
+         _fork_db.set_head( head );
+
+         _undo_db.unpack_history( journal.undo_history );
+         ilog( "Restored ${n} reversible blocks and ${u} undo states", ("n", journal.blocks.size())("u", _undo_db.size()) );
+         loaded = true;
+      }
+      else
       {
-         //elog("database::close Exception caught");
+         wlog( "Reversible blocks do not match the head block ${id}, ignoring them", ("id", head_block_id()) );
       }
    }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to load reversible blocks: ${e}", ("e", e.to_detail_string()) );
+      fc::optional<signed_block> last_block = _block_id_to_block.last();
+      _fork_db.reset();
+      if( last_block.valid() )
+         _fork_db.start_block( *last_block );
+   }
+
+   // the journal is rewritten on close, a stale one must not be applied to a newer state
+   remove( journal_file );
+   return loaded;
+}
+
+void database::close(bool rewind)
+{
+   // TODO:  Save pending tx's on close()
+   clear_pending();
+   if( rewind && !save_reversible_block_journal() )
+      pop_reversible_blocks();
 
    // Since pop_block() will move tx's in the popped blocks into pending,
    // we have to clear_pending() after we're done popping to get a clean
@@ -192,6 +377,8 @@ void database::close(bool rewind)
 
    object_database::flush();
    object_database::close();
+   // the results outlive blocks, not the state they were verified against
+   get_authority_cache().clear();
 
    if( _block_id_to_block.is_open() )
       _block_id_to_block.close();
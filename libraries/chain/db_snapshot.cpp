@@ -0,0 +1,145 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+#include <fc/io/raw.hpp>
+#include <algorithm>
+#include <fstream>
+
+namespace graphene { namespace chain {
+
+static const size_t hash_chunk_size = 64 * 1024 * 1024;
+
+state_snapshot_header database::export_state_snapshot( const boost::filesystem::path& snapshot_file )
+{ try {
+   pop_reversible_blocks();
+   clear_pending();
+
+   const dynamic_global_property_object& dpo = get_dynamic_global_properties();
+   FC_ASSERT( dpo.head_block_number == dpo.last_irreversible_block_num, "Unable to pop blocks after the last irreversible block",
+              ("head",dpo.head_block_number)("last_irreversible",dpo.last_irreversible_block_num) );
+
+   state_snapshot_header header;
+   header.chain_id = get_chain_id();
+   header.head_block_num = head_block_num();
+   header.head_block_id = head_block_id();
+   header.head_block_time = head_block_time();
+
+   std::ofstream out( snapshot_file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out, "Unable to create snapshot file" );
+
+   // the header is rewritten with the state hash when all sections are written
+   std::vector<char> data = fc::raw::pack( header );
+   out.write( data.data(), data.size() );
+   data = fc::raw::pack( fc::sha256() );
+   out.write( data.data(), data.size() );
+
+   fc::sha256::encoder state_encoder;
+   auto write = [&]( const std::vector<char>& d ) {
+      out.write( d.data(), d.size() );
+      state_encoder.write( d.data(), d.size() );
+   };
+
+   // the importing node needs the head block to link the next one
+   fc::optional<signed_block> head_block;
+   if( header.head_block_num != 0 )
+   {
+      head_block = _block_id_to_block.fetch_optional( header.head_block_id );
+      FC_ASSERT( head_block.valid(), "Head block is missing in the block database", ("id", header.head_block_id) );
+   }
+   write( fc::raw::pack( head_block ) );
+
+   inspect_all_indexes( [&]( const graphene::db::index& idx ) {
+      state_snapshot_index section;
+      section.space_id = idx.object_space_id();
+      section.type_id = idx.object_type_id();
+      section.next_id = idx.get_next_id();
+      idx.inspect_all_objects( [&]( const graphene::db::object& ) { ++section.object_count; } );
+
+      write( fc::raw::pack( section ) );
+      idx.inspect_all_objects( [&]( const graphene::db::object& o ) { write( fc::raw::pack( idx.store( o ) ) ); } );
+
+      ++header.index_count;
+      header.object_count += section.object_count;
+   });
+
+   header.state_hash = state_encoder.result();
+   out.seekp( 0 );
+   data = fc::raw::pack( header );
+   out.write( data.data(), data.size() );
+   data = fc::raw::pack( fc::sha256::hash( header ) );
+   out.write( data.data(), data.size() );
+   out.close();
+   FC_ASSERT( out, "Unable to write snapshot file" );
+
+   ilog( "Exported state snapshot at block ${n} ${id} with ${c} objects, state hash ${h}",
+         ("n", header.head_block_num)("id", header.head_block_id)("c", header.object_count)("h", header.state_hash) );
+   return header;
+} FC_CAPTURE_AND_RETHROW( (snapshot_file) ) }
+
+state_snapshot_header database::import_state_snapshot( const boost::filesystem::path& snapshot_file, const chain_id_type& chain_id )
+{ try {
+   ilog( "Importing state snapshot from ${f} ...", ("f", snapshot_file) );
+   FC_ASSERT( exists( snapshot_file ), "Snapshot file does not exist" );
+
+   boost::interprocess::file_mapping fm( snapshot_file.generic_string().c_str(), boost::interprocess::read_only );
+   boost::interprocess::mapped_region mr( fm, boost::interprocess::read_only, 0, file_size( snapshot_file ) );
+   const char* begin = static_cast<const char*>( mr.get_address() );
+   fc::datastream<const char*> ds( begin, mr.get_size() );
+
+   state_snapshot_header header;
+   fc::sha256 header_checksum;
+   fc::raw::unpack( ds, header );
+   fc::raw::unpack( ds, header_checksum );
+
+   FC_ASSERT( header.magic == state_snapshot_header::magic_value, "Not a state snapshot file" );
+   FC_ASSERT( header.version == state_snapshot_header::current_version, "Unsupported snapshot version", ("version", header.version) );
+   FC_ASSERT( fc::sha256::hash( header ) == header_checksum, "Snapshot header checksum mismatch" );
+   FC_ASSERT( header.chain_id == chain_id, "Snapshot belongs to a different chain", ("snapshot", header.chain_id)("expected", chain_id) );
+   // a reindex imports the snapshot again and keeps the blocks received after it
+   FC_ASSERT( !_block_id_to_block.last().valid() || _block_id_to_block.contains( header.head_block_id ),
+              "State snapshot can be imported only with an empty block database or one containing its head block" );
+
+   // the sections can exceed the 4 GiB limit of a single encoder write
+   fc::sha256::encoder state_encoder;
+   for( size_t pos = ds.tellp(); pos < mr.get_size(); pos += hash_chunk_size )
+      state_encoder.write( begin + pos, static_cast<uint32_t>( std::min( hash_chunk_size, mr.get_size() - pos ) ) );
+   FC_ASSERT( state_encoder.result() == header.state_hash, "Snapshot state hash mismatch" );
+
+   fc::optional<signed_block> head_block;
+   fc::raw::unpack( ds, head_block );
+   FC_ASSERT( head_block.valid() == ( header.head_block_num != 0 ), "Snapshot head block is missing" );
+   FC_ASSERT( !head_block.valid() || ( head_block->id() == header.head_block_id &&
+                                       head_block->calculate_merkle_root() == head_block->transaction_merkle_root ),
+              "Snapshot head block does not match its header" );
+
+   std::vector<char> tmp;
+   for( uint32_t i = 0; i < header.index_count; ++i )
+   {
+      state_snapshot_index section;
+      fc::raw::unpack( ds, section );
+
+      graphene::db::index& idx = get_mutable_index( section.space_id, section.type_id );
+      idx.set_next_id( section.next_id );
+      for( uint64_t n = 0; n < section.object_count; ++n )
+      {
+         fc::raw::unpack( ds, tmp );
+         idx.load( tmp );
+      }
+   }
+   FC_ASSERT( ds.remaining() == 0, "Unexpected data at the end of the snapshot" );
+
+   FC_ASSERT( head_block_id() == header.head_block_id && get_chain_id() == header.chain_id, "Snapshot state does not match its header" );
+
+   if( head_block.valid() && !_block_id_to_block.contains( header.head_block_id ) )
+      _block_id_to_block.store( header.head_block_id, *head_block );
+
+   ilog( "Imported state snapshot at block ${n} ${id} with ${c} objects",
+         ("n", header.head_block_num)("id", header.head_block_id)("c", header.object_count) );
+   return header;
+} FC_CAPTURE_AND_RETHROW( (snapshot_file) ) }
+
+} } // graphene::chain
@@ -196,6 +196,12 @@ std::vector<item_ptr> fork_database::fetch_block_by_number(uint32_t num)const
    return result;
 }
 
+std::vector<item_ptr> fork_database::fetch_blocks_from_number(uint32_t num)const
+{
+   const auto& num_idx = _index.get<block_num>();
+   return std::vector<item_ptr>( num_idx.lower_bound(num), num_idx.end() );
+}
+
 std::pair<fork_database::branch_type,fork_database::branch_type>
   fork_database::fetch_branch_from(block_id_type first, block_id_type second)const
 { try {
@@ -0,0 +1,151 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <boost/circular_buffer.hpp>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Duration statistics of a timed section, all values are in microseconds.
+    */
+   struct timing_statistics
+   {
+      std::string name;
+      uint64_t samples = 0;       ///< number of samples in the window the statistics are computed from
+      uint64_t total_samples = 0; ///< number of samples recorded since the last reset
+      int64_t min = 0;
+      int64_t avg = 0;
+      int64_t max = 0;
+      int64_t p50 = 0;
+      int64_t p90 = 0;
+      int64_t p99 = 0;
+   };
+
+   /**
+    * @brief Sliding window of duration samples.
+    *
+    * Holds the most recent samples up to the window size. In unbounded mode the window grows instead of
+    * dropping the oldest sample, up to max_unbounded_window_size samples, so the statistics cover everything
+    * recorded since the last reset or, once the limit is reached, the most recent part of it.
+    */
+   class timing_window
+   {
+      public:
+         static const size_t max_unbounded_window_size = 1024 * 1024;
+
+         explicit timing_window( size_t window_size = 0 );
+
+         void record( int64_t duration, bool unbounded );
+         void set_window_size( size_t window_size );
+         void reset();
+
+         uint64_t total_samples() const { return _total_samples; }
+         timing_statistics get_statistics( const std::string& name ) const;
+
+      private:
+         boost::circular_buffer<int64_t> _samples;
+         size_t                          _window_size;
+         uint64_t                        _total_samples = 0;
+   };
+
+   struct apply_timing_info
+   {
+      uint32_t                       window_size = 0;
+      bool                           record_replay = false;
+      std::vector<timing_statistics> block_phases;
+      std::vector<timing_statistics> operations;
+   };
+
+   /**
+    * @brief Collects execution times of the block application phases and of the operation evaluators.
+    */
+   class apply_timing
+   {
+      public:
+         enum block_phase
+         {
+            apply_block_total,
+            prevalidate_transactions,
+            merkle_check,
+            validate_block_header,
+            apply_transactions,
+            update_global_dynamic_data,
+            update_signing_miner,
+            update_last_irreversible_block,
+            perform_chain_maintenance,
+            create_block_summary,
+            clear_expired_transactions,
+            clear_expired_proposals,
+            update_expired_feeds,
+            update_withdraw_permissions,
+            update_maintenance_flag,
+            update_miner_schedule,
+            applied_block_signal,
+            notify_changed_objects,
+            block_phase_count
+         };
+
+         static const size_t default_window_size = 1000;
+
+         apply_timing();
+
+         bool is_enabled() const { return _enabled; }
+         void set_enabled( bool enabled ) { _enabled = enabled; }
+
+         /**
+          * @brief When set, database::reindex() keeps the samples of the replay, up to
+          * timing_window::max_unbounded_window_size per phase and operation, instead of the sliding window only.
+          */
+         bool get_record_replay() const { return _record_replay; }
+         void set_record_replay( bool record_replay ) { _record_replay = record_replay; }
+
+         bool is_unbounded() const { return _unbounded; }
+         void set_unbounded( bool unbounded ) { _unbounded = unbounded; }
+
+         size_t get_window_size() const { return _window_size; }
+         void set_window_size( size_t window_size );
+
+         void record_phase( block_phase phase, const fc::microseconds& duration );
+         void record_operation( int which, const fc::microseconds& duration );
+         void reset();
+
+         template<typename Lambda>
+         void measure_phase( block_phase phase, Lambda&& l )
+         {
+            if( !_enabled )
+            {
+               l();
+               return;
+            }
+
+            fc::time_point start = fc::time_point::now();
+            l();
+            record_phase( phase, fc::time_point::now() - start );
+         }
+
+         /**
+          * @brief Statistics of all block phases and of the operation types which were applied at least once.
+          */
+         apply_timing_info get_info() const;
+         static const char* get_phase_name( block_phase phase );
+
+      private:
+         bool                                          _enabled = true;
+         bool                                          _record_replay = false;
+         bool                                          _unbounded = false;
+         size_t                                        _window_size = default_window_size;
+         std::array<timing_window, block_phase_count>  _phases;
+         std::vector<timing_window>                    _operations;
+         std::vector<std::string>                      _operation_names;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::timing_statistics, (name)(samples)(total_samples)(min)(avg)(max)(p50)(p90)(p99) )
+FC_REFLECT( graphene::chain::apply_timing_info, (window_size)(record_replay)(block_phases)(operations) )
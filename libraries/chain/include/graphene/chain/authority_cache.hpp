@@ -0,0 +1,64 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+#include <graphene/chain/protocol/authority.hpp>
+#include <graphene/db/index.hpp>
+
+#include <fc/crypto/sha256.hpp>
+
+#include <boost/container/flat_set.hpp>
+
+#include <set>
+#include <tuple>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief Remembers signature key sets which were verified to satisfy the authorities required by a transaction.
+    *
+    *  The same accounts sign many transactions, and the pending transactions are verified again after every
+    *  block, so the result of walking their authority trees is reused for every transaction with the same
+    *  required accounts, recovered keys and maximum authority depth. It is attached to the account index as
+    *  a secondary index and drops all results when an owner or active authority changes, results are kept
+    *  across blocks otherwise.
+    */
+   class authority_cache : public graphene::db::secondary_index
+   {
+      public:
+         struct entry
+         {
+            boost::container::flat_set<account_id_type> required_active;
+            boost::container::flat_set<account_id_type> required_owner;
+            boost::container::flat_set<public_key_type> keys;
+            uint32_t                                    max_authority_depth = 0;
+
+            bool operator<( const entry& other )const
+            {
+               return std::tie( max_authority_depth, required_active, required_owner, keys ) <
+                      std::tie( other.max_authority_depth, other.required_active, other.required_owner, other.keys );
+            }
+         };
+
+         static const size_t max_entries = 10000;
+
+         virtual void object_removed( const graphene::db::object& obj ) override;
+         virtual void about_to_modify( const graphene::db::object& before ) override;
+         virtual void object_modified( const graphene::db::object& after ) override;
+
+         bool is_approved( const entry& e )const;
+         void add_approved( entry&& e );
+         void clear() { _approved.clear(); }
+
+         uint64_t get_hits()const { return _hits; }
+         uint64_t get_misses()const { return _misses; }
+
+      private:
+         static fc::sha256 authorities_digest( const graphene::db::object& obj );
+
+         std::set<entry>    _approved;
+         bool               _modification_tracked = false;
+         fc::sha256         _before_authorities;
+         mutable uint64_t   _hits = 0;
+         mutable uint64_t   _misses = 0;
+   };
+
+} } // graphene::chain
@@ -28,6 +28,8 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/chain/apply_timing.hpp>
+#include <graphene/chain/state_snapshot.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
@@ -43,6 +45,9 @@ namespace graphene { namespace chain {
    class asset_object;
    class global_property_object;
    class transaction_evaluation_state;
+   class authority_cache;
+   class transaction_prevalidator;
+   struct precomputed_transaction;
 
    struct miner_reward_input;
    struct real_supply;
@@ -50,6 +55,10 @@ namespace graphene { namespace chain {
    MONITORING_COUNTERS_BEGIN(database)
    MONITORING_DEFINE_COUNTER(blocks_applied)
    MONITORING_DEFINE_COUNTER(transactions_in_applied_blocks)
+   MONITORING_DEFINE_COUNTER(operations_in_applied_blocks)
+   MONITORING_DEFINE_COUNTER(block_apply_time_us)
+   MONITORING_DEFINE_COUNTER(authority_cache_hits)
+   MONITORING_DEFINE_COUNTER(authority_cache_misses)
    MONITORING_COUNTERS_DEPENDENCIES
    MONITORING_COUNTERS_END
 
@@ -87,9 +96,39 @@ namespace graphene { namespace chain {
             skip_assert_evaluation      = 1 << 8,  ///< used while reindexing
             skip_undo_history_check     = 1 << 9,  ///< used while reindexing
             skip_miner_schedule_check = 1 << 10,  ///< used while reindexing
-            skip_validate               = 1 << 11 ///< used prior to checkpoint, skips validate() call on transaction
+            skip_validate               = 1 << 11, ///< used prior to checkpoint, skips validate() call on transaction
+            skip_trusted_block          = 1 << 12  ///< used prior to trusted block, honours skip_validate and skips the temp account balance check
          };
 
+         /**
+          * Skip flags of a replay of the local block database, see reindex()
+          */
+         static const uint32_t replay_skip_flags =
+            skip_miner_signature |
+            skip_transaction_signatures |
+            skip_transaction_dupe_check |
+            skip_tapos_check |
+            skip_miner_schedule_check |
+            skip_authority_check;
+
+         /**
+          * Skip flags of the "trusted replay" profile. Blocks of the chain ending in the trusted block set in
+          * node_property_object are applied with these flags during replay and sync, as long as that chain is in the
+          * local block database. Blocks received from peers are checked as usual until they are stored there.
+          */
+         static const uint32_t trusted_replay_skip_flags =
+            skip_miner_signature |
+            skip_transaction_signatures |
+            skip_transaction_dupe_check |
+            skip_tapos_check |
+            skip_authority_check |
+            skip_merkle_check |
+            skip_assert_evaluation |
+            skip_undo_history_check |
+            skip_miner_schedule_check |
+            skip_validate |
+            skip_trusted_block;
+
          /**
           * @brief Open a database, creating a new one if necessary
           *
@@ -121,8 +160,39 @@ namespace graphene { namespace chain {
           * Will close the database before wiping. Database will be closed when this function returns.
           */
          void wipe(const boost::filesystem::path& data_dir, bool include_blocks);
+
+         /**
+          * @brief Close the database
+          *
+          * Reversible blocks and their undo history are saved to a journal beside the block database, so the node
+          * resumes at its head block when it is opened again. If the journal can not be restored, @ref database::open
+          * replays the blockchain instead of keeping a head block which can not be undone.
+          *
+          * @param rewind If the journal can not be saved, pop all blocks after the last irreversible block
+          */
          void close(bool rewind = true);
 
+         //////////////////// db_snapshot.cpp ////////////////////
+
+         /**
+          * @brief Export the complete object state to a snapshot file
+          *
+          * Blocks after the last irreversible block are popped first (and removed from the block database, as
+          * @ref database::close does), so the snapshot always describes an irreversible state.
+          */
+         state_snapshot_header export_state_snapshot( const boost::filesystem::path& snapshot_file );
+
+         /**
+          * @brief Initialize the state from a snapshot file instead of the genesis state
+          *
+          * When set before @ref database::open and no initialized database is found, the state is loaded from the
+          * snapshot and the node continues from its head block, which is stored in the snapshot and seeds the block
+          * and fork databases. The snapshot must belong to the chain of the genesis state and the block database must
+          * be empty. The path of the snapshot is remembered, @ref database::reindex imports it again and replays the
+          * blocks after it, so the file has to be kept.
+          */
+         void set_state_snapshot_to_import( const boost::filesystem::path& snapshot_file ) { _state_snapshot_to_import = snapshot_file; }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -198,6 +268,21 @@ namespace graphene { namespace chain {
          };
 
          const std::vector<applied_operation>& get_applied_operations() const { return _applied_ops; }
+
+         /**
+          * @brief Execution times of the block phases and operation evaluators, see apply_timing
+          */
+         apply_timing& get_apply_timing() { return _apply_timing; }
+         const apply_timing& get_apply_timing() const { return _apply_timing; }
+
+         /**
+          * @brief Number of threads pre-validating the transactions of a block together with the database thread,
+          * 0 to pre-validate them on the database thread only. The threads are started with the first block that
+          * needs them. Defaults to default_prevalidation_threads().
+          */
+         uint32_t get_prevalidation_threads() const;
+         void set_prevalidation_threads( uint32_t thread_count );
+         static uint32_t default_prevalidation_threads();
          std::string to_pretty_string(const asset& a) const;
 
          /**
@@ -436,6 +521,7 @@ namespace graphene { namespace chain {
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
+         authority_cache& get_authority_cache();
          void notify_changed_objects(bool sync_mode);
 
       private:
@@ -454,7 +540,14 @@ namespace graphene { namespace chain {
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
       private:
          void                  _apply_block( const signed_block& next_block, bool sync_mode );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         void                  pop_reversible_blocks();
+         bool                  save_reversible_block_journal();
+         bool                  load_reversible_block_journal();
+         state_snapshot_header import_state_snapshot( const boost::filesystem::path& snapshot_file, const chain_id_type& chain_id );
+         static boost::filesystem::path state_snapshot_marker_file( const boost::filesystem::path& data_dir );
+         processed_transaction _apply_transaction( const signed_transaction& trx, const precomputed_transaction* precomputed = nullptr );
+         const signed_block_header* get_trusted_block();
+         uint32_t              keep_recent_dupe_check( uint32_t skip, const signed_block& next_block, const fc::time_point_sec& reference_time )const;
 
          ///Steps involved in applying a new block
          ///@{
@@ -506,10 +599,18 @@ namespace graphene { namespace chain {
           */
          std::vector<applied_operation> _applied_ops;
          operation_info            _current_op_info;
+         apply_timing              _apply_timing;
+
+         std::unique_ptr<transaction_prevalidator> _prevalidator;
 
          boost::container::flat_map<uint32_t,block_id_type> _checkpoints;
 
          node_property_object              _node_property_object;
+
+         fc::optional<boost::filesystem::path> _state_snapshot_to_import;
+
+         fc::optional<block_id_type>       _trusted_block_looked_up; ///< the trusted block id _trusted_block was looked up for
+         fc::optional<signed_block_header> _trusted_block;           ///< the trusted block, if it is in the block database
    };
 
 } }
@@ -78,6 +78,8 @@ namespace graphene { namespace chain {
          bool                             is_known_block(const block_id_type& id)const;
          std::shared_ptr<fork_item>       fetch_block(const block_id_type& id)const;
          std::vector<item_ptr>            fetch_block_by_number(uint32_t n)const;
+         /// @return all linked blocks with number n or higher, ordered by block number
+         std::vector<item_ptr>            fetch_blocks_from_number(uint32_t n)const;
 
          /**
           *  @return the new head block ( the longest fork )
@@ -124,4 +126,22 @@ namespace graphene { namespace chain {
          std::shared_ptr<fork_item> _head;
    };
 
+   /**
+    * @brief Reversible blocks with the undo history of the state, saved when the database is closed
+    */
+   struct reversible_block_journal
+   {
+      static const uint32_t current_version = 1;
+
+      uint32_t                  version = current_version;
+      /// head block of the state the undo history belongs to
+      block_id_type             head_block_id;
+      /// blocks of the fork database which can still be switched to, ordered by block number
+      std::vector<signed_block> blocks;
+      /// serialized by undo_database::pack_history()
+      std::vector<char>         undo_history;
+   };
+
 } } // graphene::chain
+
+FC_REFLECT( graphene::chain::reversible_block_journal, (version)(head_block_id)(blocks)(undo_history) )
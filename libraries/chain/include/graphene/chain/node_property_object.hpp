@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <graphene/chain/protocol/types.hpp>
 #include <graphene/db/object.hpp>
 
 namespace graphene { namespace chain {
@@ -43,5 +44,12 @@ namespace graphene { namespace chain {
          ~node_property_object(){}
 
          uint32_t skip_flags = 0;
+
+         /**
+          * Blocks up to and including this one are applied with database::trusted_replay_skip_flags, when they are
+          * ancestors of it in the local block database. The dupe check is kept for the last expiration window before
+          * it. The id is checked when the block is reached, like a checkpoint.
+          */
+         fc::optional<block_id_type> trusted_block_id;
    };
 } } // graphene::chain
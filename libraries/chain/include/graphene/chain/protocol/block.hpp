@@ -52,6 +52,8 @@ namespace graphene { namespace chain {
    struct signed_block : public signed_block_header
    {
       checksum_type calculate_merkle_root()const;
+      /// Calculates the merkle root from already computed merkle digests of the transactions
+      static checksum_type calculate_merkle_root( std::vector<digest_type> ids );
       std::vector<processed_transaction> transactions;
    };
 
@@ -150,6 +150,16 @@ namespace graphene { namespace chain {
          const std::function<const authority*(account_id_type)>& get_owner,
          uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH )const;
 
+      /// same as above, for a caller which already got the required authorities by get_required_authorities()
+      void verify_authority(
+         const boost::container::flat_set<account_id_type>& required_active,
+         const boost::container::flat_set<account_id_type>& required_owner,
+         const std::vector<authority>& other,
+         const boost::container::flat_set<public_key_type>& sig_keys,
+         const std::function<const authority*(account_id_type)>& get_active,
+         const std::function<const authority*(account_id_type)>& get_owner,
+         uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH )const;
+
       /**
        * This is a slower replacement for get_required_signatures()
        * which returns a minimal set in all cases, including
@@ -181,12 +191,31 @@ namespace graphene { namespace chain {
                           const boost::container::flat_set<account_id_type>& active_aprovals = boost::container::flat_set<account_id_type>(),
                           const boost::container::flat_set<account_id_type>& owner_approvals = boost::container::flat_set<account_id_type>());
 
+   void verify_authority( const boost::container::flat_set<account_id_type>& required_active,
+                          const boost::container::flat_set<account_id_type>& required_owner,
+                          const std::vector<authority>& other,
+                          const boost::container::flat_set<public_key_type>& sigs,
+                          const std::function<const authority*(account_id_type)>& get_active,
+                          const std::function<const authority*(account_id_type)>& get_owner,
+                          uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH,
+                          bool allow_committee = false,
+                          const boost::container::flat_set<account_id_type>& active_aprovals = boost::container::flat_set<account_id_type>(),
+                          const boost::container::flat_set<account_id_type>& owner_approvals = boost::container::flat_set<account_id_type>());
+
    // optimized version if there is used only one sign
    void verify_authority1(const std::vector<operation>& ops, const public_key_type& sigs,
       const std::function<const authority*(account_id_type)>& get_active,
       const std::function<const authority*(account_id_type)>& get_owner,
       uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH);
 
+   void verify_authority1(const boost::container::flat_set<account_id_type>& required_active,
+      const boost::container::flat_set<account_id_type>& required_owner,
+      const std::vector<authority>& other,
+      const public_key_type& sigs,
+      const std::function<const authority*(account_id_type)>& get_active,
+      const std::function<const authority*(account_id_type)>& get_owner,
+      uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH);
+
    /**
     *  @brief captures the result of evaluating the operations contained in the transaction
     *
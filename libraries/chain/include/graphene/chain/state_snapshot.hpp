@@ -0,0 +1,43 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Describes the chain state stored in a snapshot file.
+    *
+    * The snapshot file consists of this header, the sha256 of the packed header, the head block (an optional
+    * signed_block, empty at the genesis state) and one section per index. Each section is a state_snapshot_index
+    * followed by the serialized objects of the index in the order of their ids. The head block lets the importing
+    * node seed its block and fork databases, so it can link the next block and report its head to peers.
+    */
+   struct state_snapshot_header
+   {
+      static const uint64_t magic_value = 0x50414e5354434544ULL; ///< "DECTSNAP"
+      static const uint32_t current_version = 2;
+
+      uint64_t           magic = magic_value;
+      uint32_t           version = current_version;
+      chain_id_type      chain_id;
+      uint32_t           head_block_num = 0;
+      block_id_type      head_block_id;
+      fc::time_point_sec head_block_time;
+      uint32_t           index_count = 0;
+      uint64_t           object_count = 0;
+      /// sha256 of the head block and all index sections
+      fc::sha256         state_hash;
+   };
+
+   struct state_snapshot_index
+   {
+      uint8_t                      space_id = 0;
+      uint8_t                      type_id = 0;
+      graphene::db::object_id_type next_id;
+      uint64_t                     object_count = 0;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::state_snapshot_header, (magic)(version)(chain_id)(head_block_num)(head_block_id)(head_block_time)(index_count)(object_count)(state_hash) )
+FC_REFLECT( graphene::chain::state_snapshot_index, (space_id)(type_id)(next_id)(object_count) )
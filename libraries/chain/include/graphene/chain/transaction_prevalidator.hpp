@@ -0,0 +1,74 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Results of the stateless checks of a transaction computed before it is applied.
+    */
+   struct precomputed_transaction
+   {
+      transaction_id_type  id;
+      digest_type          merkle_digest;
+      /// set when transaction::validate() failed, it is rethrown when the transaction is applied
+      std::exception_ptr   validation_error;
+   };
+
+   /**
+    * @brief Runs the stateless part of the transaction processing for all transactions of a block on worker threads.
+    *
+    * The workers are plain system threads and the calling thread waits without yielding, so no other task can run
+    * on the database thread while a block is being applied. They are started by the first block big enough to be
+    * processed in parallel, so a database which never applies one does not start any.
+    */
+   class transaction_prevalidator
+   {
+      public:
+         /// blocks with less transactions are processed on the calling thread only
+         static const size_t min_parallel_transactions = 8;
+
+         /// @param worker_count Number of threads helping the calling thread, 0 to process everything on the calling thread
+         explicit transaction_prevalidator( uint32_t worker_count );
+         ~transaction_prevalidator();
+
+         /**
+          * @param trxs Transactions of a block
+          * @param validate Whether to call transaction::validate()
+          * @param compute_merkle_digests Whether to compute merkle digests of the transactions
+          * @return Precomputed results in the order of the transactions
+          */
+         std::vector<precomputed_transaction> run( const std::vector<processed_transaction>& trxs, bool validate, bool compute_merkle_digests );
+
+         uint32_t get_worker_count()const { return _worker_count; }
+         /// running workers are stopped, the new number of them is started when needed
+         void set_worker_count( uint32_t worker_count );
+
+      private:
+         void start_workers();
+         void stop_workers();
+         void worker_loop( uint64_t last_generation );
+         void process_items();
+
+         uint32_t                           _worker_count;
+         std::vector<std::thread>           _workers;
+         std::mutex                         _mutex;
+         std::condition_variable            _work_ready;
+         std::condition_variable            _work_done;
+         const std::function<void(size_t)>* _task = nullptr;
+         std::atomic<size_t>                _next_item;
+         size_t                             _item_count = 0;
+         size_t                             _busy_workers = 0;
+         uint64_t                           _generation = 0;
+         bool                               _stop = false;
+   };
+
+} } // graphene::chain
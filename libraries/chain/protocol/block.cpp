@@ -63,14 +63,19 @@ namespace graphene { namespace chain {
 
    checksum_type signed_block::calculate_merkle_root()const
    {
-      if( transactions.size() == 0 )
-         return checksum_type();
-
       std::vector<digest_type> ids;
       ids.resize( transactions.size() );
       for( uint32_t i = 0; i < transactions.size(); ++i )
          ids[i] = transactions[i].merkle_digest();
 
+      return calculate_merkle_root( std::move( ids ) );
+   }
+
+   checksum_type signed_block::calculate_merkle_root( std::vector<digest_type> ids )
+   {
+      if( ids.size() == 0 )
+         return checksum_type();
+
       std::vector<digest_type>::size_type current_number_of_hashes = ids.size();
       while( current_number_of_hashes > 1 )
       {
@@ -300,6 +300,21 @@ void verify_authority( const std::vector<operation>& ops,
    for( const auto& op : ops )
       operation_get_required_authorities( op, required_active, required_owner, other );
 
+   verify_authority( required_active, required_owner, other, sigs, get_active, get_owner, max_recursion_depth,
+                     allow_committee, active_aprovals, owner_approvals );
+} FC_CAPTURE_AND_RETHROW( (ops)(sigs) ) }
+
+void verify_authority( const boost::container::flat_set<account_id_type>& required_active,
+                       const boost::container::flat_set<account_id_type>& required_owner,
+                       const std::vector<authority>& other,
+                       const boost::container::flat_set<public_key_type>& sigs,
+                       const std::function<const authority*(account_id_type)>& get_active,
+                       const std::function<const authority*(account_id_type)>& get_owner,
+                       uint32_t max_recursion_depth,
+                       bool  allow_committee,
+                       const boost::container::flat_set<account_id_type>& active_aprovals,
+                       const boost::container::flat_set<account_id_type>& owner_approvals )
+{ try {
    if( !allow_committee )
       FC_VERIFY_AND_THROW( required_active.find(GRAPHENE_MINER_ACCOUNT) == required_active.end(),
                        invalid_committee_approval_exception, "Committee account may only propose transactions" );
@@ -336,7 +351,7 @@ void verify_authority( const std::vector<operation>& ops,
       tx_irrelevant_sig_exception,
       "Unnecessary signature(s) detected"
       );
-} FC_CAPTURE_AND_RETHROW( (ops)(sigs) ) }
+} FC_CAPTURE_AND_RETHROW( (required_active)(required_owner)(sigs) ) }
 
 void verify_authority1(const std::vector<operation>& ops, const public_key_type& sigs,
   const std::function<const authority*(account_id_type)>& get_active,
@@ -351,6 +366,19 @@ void verify_authority1(const std::vector<operation>& ops, const public_key_type&
       for (const auto& op : ops)
           operation_get_required_authorities(op, required_active, required_owner, other);
 
+      verify_authority1(required_active, required_owner, other, sigs, get_active, get_owner, max_recursion_depth);
+   } FC_CAPTURE_AND_RETHROW((ops)(sigs))
+}
+
+void verify_authority1(const boost::container::flat_set<account_id_type>& required_active,
+   const boost::container::flat_set<account_id_type>& required_owner,
+   const std::vector<authority>& other,
+   const public_key_type& sigs,
+   const std::function<const authority*(account_id_type)>& get_active,
+   const std::function<const authority*(account_id_type)>& get_owner,
+   uint32_t max_recursion_depth)
+{
+   try {
       sign_state1 s(sigs, get_active);
       s.max_recursion = max_recursion_depth;
 
@@ -373,7 +401,7 @@ void verify_authority1(const std::vector<operation>& ops, const public_key_type&
             s.check_authority(get_owner(id)),
             tx_missing_owner_auth_exception, "Missing Owner Authority ${id}", ("id", id));
       }
-   } FC_CAPTURE_AND_RETHROW((ops)(sigs))
+   } FC_CAPTURE_AND_RETHROW((required_active)(required_owner)(sigs))
 }
 
 boost::container::flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
@@ -464,4 +492,20 @@ void signed_transaction::verify_authority(
       graphene::chain::verify_authority(operations, sig_keys, get_active, get_owner, max_recursion);
 } FC_CAPTURE_AND_RETHROW( (*this) ) }
 
+void signed_transaction::verify_authority(
+   const boost::container::flat_set<account_id_type>& required_active,
+   const boost::container::flat_set<account_id_type>& required_owner,
+   const std::vector<authority>& other,
+   const boost::container::flat_set<public_key_type>& sig_keys,
+   const std::function<const authority*(account_id_type)>& get_active,
+   const std::function<const authority*(account_id_type)>& get_owner,
+   uint32_t max_recursion )const
+
+{ try {
+   if(sig_keys.size() == 1)
+      graphene::chain::verify_authority1(required_active, required_owner, other, *sig_keys.begin(), get_active, get_owner, max_recursion);
+   else
+      graphene::chain::verify_authority(required_active, required_owner, other, sig_keys, get_active, get_owner, max_recursion);
+} FC_CAPTURE_AND_RETHROW( (*this) ) }
+
 } } // graphene::chain
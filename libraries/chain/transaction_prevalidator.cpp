@@ -0,0 +1,119 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/chain/transaction_prevalidator.hpp>
+
+namespace graphene { namespace chain {
+
+transaction_prevalidator::transaction_prevalidator( uint32_t worker_count )
+: _worker_count( worker_count ), _next_item( 0 )
+{
+}
+
+transaction_prevalidator::~transaction_prevalidator()
+{
+   stop_workers();
+}
+
+void transaction_prevalidator::set_worker_count( uint32_t worker_count )
+{
+   stop_workers();
+   _worker_count = worker_count;
+}
+
+void transaction_prevalidator::start_workers()
+{
+   // the workers wait for the next generation of work, not for the ones run on the calling thread alone
+   const uint64_t generation = _generation;
+   for( uint32_t i = 0; i < _worker_count; ++i )
+      _workers.emplace_back( [this, generation]() { worker_loop( generation ); } );
+}
+
+void transaction_prevalidator::stop_workers()
+{
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stop = true;
+   }
+   _work_ready.notify_all();
+   for( std::thread& t : _workers )
+      t.join();
+   _workers.clear();
+   _stop = false;
+}
+
+std::vector<precomputed_transaction> transaction_prevalidator::run( const std::vector<processed_transaction>& trxs, bool validate, bool compute_merkle_digests )
+{
+   std::vector<precomputed_transaction> result( trxs.size() );
+   const std::function<void(size_t)> task = [&]( size_t i ) {
+      const processed_transaction& trx = trxs[i];
+      precomputed_transaction& pre = result[i];
+      if( validate )
+      {
+         try
+         {
+            trx.validate();
+         }
+         catch( ... )
+         {
+            pre.validation_error = std::current_exception();
+         }
+      }
+      pre.id = trx.id();
+      if( compute_merkle_digests )
+         pre.merkle_digest = trx.merkle_digest();
+   };
+
+   if( _worker_count == 0 || trxs.size() < min_parallel_transactions )
+   {
+      for( size_t i = 0; i < trxs.size(); ++i )
+         task( i );
+      return result;
+   }
+
+   if( _workers.empty() )
+      start_workers();
+
+   std::unique_lock<std::mutex> lock( _mutex );
+   _task = &task;
+   _item_count = trxs.size();
+   _next_item = 0;
+   _busy_workers = _workers.size();
+   ++_generation;
+   lock.unlock();
+   _work_ready.notify_all();
+
+   // the calling thread takes its share of the work as well
+   process_items();
+
+   lock.lock();
+   _work_done.wait( lock, [this]() { return _busy_workers == 0; } );
+   _task = nullptr;
+   return result;
+}
+
+void transaction_prevalidator::worker_loop( uint64_t last_generation )
+{
+   for(;;)
+   {
+      {
+         std::unique_lock<std::mutex> lock( _mutex );
+         _work_ready.wait( lock, [&]() { return _stop || _generation != last_generation; } );
+         if( _stop )
+            return;
+         last_generation = _generation;
+      }
+
+      process_items();
+
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( --_busy_workers == 0 )
+         _work_done.notify_one();
+   }
+}
+
+void transaction_prevalidator::process_items()
+{
+   for( size_t i = _next_item++; i < _item_count; i = _next_item++ )
+      (*_task)( i );
+}
+
+} } // graphene::chain
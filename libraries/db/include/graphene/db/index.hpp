@@ -75,7 +75,9 @@ namespace graphene { namespace db {
          virtual void           set_next_id( object_id_type id ) = 0;
 
          virtual const object& load( const std::vector<char>& data ) = 0;
-         virtual std::vector<char> store( const object& obj ) = 0;
+         virtual std::vector<char> store( const object& obj )const = 0;
+         /** Deserializes an object stored by store() without inserting it into the index */
+         virtual std::unique_ptr<object> unpack( const std::vector<char>& data )const = 0;
 
          /**
           *  Polymorphically insert by moving an object into the index.
@@ -94,6 +96,11 @@ namespace graphene { namespace db {
           */
          void open( const boost::filesystem::path& db );
 
+         /**
+          *  Removes all objects and resets the next id, used when the database files are wiped
+          */
+         void clear();
+
          /**
           *  Saves the index saving objects to a file
           */
@@ -189,6 +196,12 @@ namespace graphene { namespace db {
             FC_THROW_EXCEPTION( invalid_index_exception, "invalid index type" );
          }
 
+         template<typename T>
+         T& get_secondary_index()
+         {
+            return const_cast<T&>( static_cast<const base_primary_index*>(this)->get_secondary_index<T>() );
+         }
+
       protected:
          std::vector<std::shared_ptr<index_observer>>   _observers;
          std::vector<std::unique_ptr<secondary_index>>  _sindex;
@@ -231,11 +244,24 @@ namespace graphene { namespace db {
             return result;
          }
 
-         virtual std::vector<char> store( const object& obj )override
+         virtual const object&  insert( object&& obj )override
+         {
+            const auto& result = DerivedIndex::insert( std::move( obj ) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
+         virtual std::vector<char> store( const object& obj )const override
          {
             return fc::raw::pack( static_cast<const object_type&>(obj) );
          }
 
+         virtual std::unique_ptr<object> unpack( const std::vector<char>& data )const override
+         {
+            return std::unique_ptr<object>( new object_type( fc::raw::unpack<object_type>( data ) ) );
+         }
+
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
@@ -85,6 +85,9 @@ namespace graphene { namespace db {
          const index&  get_index(object_id_type id)const { return get_index(id.space(),id.type()); }
          /// @}
 
+         /** Calls the inspector for all indexes in the order of space and type ids */
+         void inspect_all_indexes( const std::function<void(const index&)>& inspector )const;
+
          const object& get_object( object_id_type id )const;
          const object* find_object( object_id_type id )const;
 
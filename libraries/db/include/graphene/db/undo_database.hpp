@@ -24,6 +24,7 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <deque>
+#include <vector>
 #include <unordered_set>
 
 namespace graphene { namespace db {
@@ -137,6 +138,16 @@ namespace graphene { namespace db {
 
          const undo_state& head()const;
 
+         /**
+          * Serializes the whole undo history, used to keep the history of reversible blocks across restarts.
+          * There must be no active session.
+          */
+         std::vector<char> pack_history()const;
+         /** Replaces the undo history with one serialized by pack_history() */
+         void unpack_history( const std::vector<char>& data );
+         /** Drops the whole undo history, there must be no active session */
+         void clear_history();
+
       private:
          void undo();
          void merge();
@@ -58,6 +58,15 @@ namespace graphene { namespace db {
       } catch ( const fc::exception& ){}
    }FC_CAPTURE_AND_RETHROW((db))}
 
+   void index::clear()
+   {
+      std::vector<const object*> objects;
+      inspect_all_objects( [&objects]( const object& o ) { objects.push_back( &o ); } );
+      for( const object* o : objects )
+         remove( *o );
+      set_next_id( object_id_type( object_space_id(), object_type_id(), 0 ) );
+   }
+
    void index::save( const boost::filesystem::path& db )
    {
       std::ofstream out( db.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
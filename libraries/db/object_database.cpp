@@ -56,6 +56,14 @@ const object& object_database::get_object( object_id_type id )const
    return get_index(id.space(),id.type()).get( id );
 }
 
+void object_database::inspect_all_indexes( const std::function<void(const index&)>& inspector )const
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            inspector( *idx );
+}
+
 const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
 {
    if(_index.size() <= space_id)
@@ -99,6 +107,12 @@ void object_database::wipe(const boost::filesystem::path& data_dir)
    close();
    ilog("Wiping object database...");
    remove_all(data_dir / "object_database");
+   // the loaded objects go as well, so the database can be opened again in place
+   _undo_db.clear_history();
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            idx->clear();
    ilog("Done wiping object databse.");
 }
 
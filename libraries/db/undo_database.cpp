@@ -24,12 +24,41 @@
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
+#include <fc/io/raw.hpp>
+
+namespace graphene { namespace db { namespace detail {
+
+   /// serialized form of undo_state, objects are stored by their indexes
+   struct packed_undo_state
+   {
+      std::vector<std::pair<object_id_type, std::vector<char>>> old_values;
+      std::vector<std::pair<object_id_type, object_id_type>>    old_index_next_ids;
+      std::vector<object_id_type>                               new_ids;
+      std::vector<std::pair<object_id_type, std::vector<char>>> removed;
+   };
+
+   struct packed_undo_history
+   {
+      uint64_t                       max_size = 0;
+      std::vector<packed_undo_state> states;
+   };
+
+} } } // graphene::db::detail
+
+FC_REFLECT( graphene::db::detail::packed_undo_state, (old_values)(old_index_next_ids)(new_ids)(removed) )
+FC_REFLECT( graphene::db::detail::packed_undo_history, (max_size)(states) )
 
 namespace graphene { namespace db {
 
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
+void undo_database::clear_history()
+{
+   FC_ASSERT( _active_sessions == 0 );
+   _stack.clear();
+}
+
 undo_database::session undo_database::start_undo_session( bool force_enable )
 {
    if( _disabled && !force_enable ) return session(*this);
@@ -287,4 +316,51 @@ const undo_state& undo_database::head()const
    return _stack.back();
 }
 
+std::vector<char> undo_database::pack_history()const
+{
+   FC_ASSERT( _active_sessions == 0 );
+
+   auto pack_object = [this]( const object& obj ) {
+      return std::make_pair( obj.id, _db.get_index( obj.id ).store( obj ) );
+   };
+
+   detail::packed_undo_history history;
+   history.max_size = _max_size;
+   history.states.reserve( _stack.size() );
+   for( const undo_state& state : _stack )
+   {
+      detail::packed_undo_state packed;
+      for( const auto& item : state.old_values )
+         packed.old_values.push_back( pack_object( *item.second ) );
+      packed.old_index_next_ids.assign( state.old_index_next_ids.begin(), state.old_index_next_ids.end() );
+      packed.new_ids.assign( state.new_ids.begin(), state.new_ids.end() );
+      for( const auto& item : state.removed )
+         packed.removed.push_back( pack_object( *item.second ) );
+      history.states.push_back( std::move( packed ) );
+   }
+   return fc::raw::pack( history );
+}
+
+void undo_database::unpack_history( const std::vector<char>& data )
+{ try {
+   FC_ASSERT( _active_sessions == 0 );
+
+   detail::packed_undo_history history = fc::raw::unpack<detail::packed_undo_history>( data );
+   std::deque<undo_state> stack;
+   for( const detail::packed_undo_state& packed : history.states )
+   {
+      stack.emplace_back();
+      undo_state& state = stack.back();
+      for( const auto& item : packed.old_values )
+         state.old_values[item.first] = _db.get_index( item.first ).unpack( item.second );
+      state.old_index_next_ids.insert( packed.old_index_next_ids.begin(), packed.old_index_next_ids.end() );
+      state.new_ids.insert( packed.new_ids.begin(), packed.new_ids.end() );
+      for( const auto& item : packed.removed )
+         state.removed[item.first] = _db.get_index( item.first ).unpack( item.second );
+   }
+
+   _stack = std::move( stack );
+   _max_size = history.max_size;
+} FC_RETHROW() }
+
 } } // graphene::db
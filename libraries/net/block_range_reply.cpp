@@ -0,0 +1,68 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/net/block_range_reply.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net {
+
+  namespace
+  {
+    // the varint length prefix of the frame's message vector
+    const size_t frame_overhead = 5;
+  }
+
+  size_t block_range_reply::frame::get_size_in_queue() const
+  {
+    size_t size_in_queue = 0;
+    for (const std::shared_ptr<const message>& reply : messages)
+      size_in_queue += reply->data.size();
+    return size_in_queue;
+  }
+
+  block_range_reply::block_range_reply(const fetch_block_range_message& request, uint32_t max_message_size) :
+    _max_frame_size(std::min<size_t>(std::min(request.max_frame_size, max_message_size), GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE)),
+    _frame_size(frame_overhead)
+  {
+    FC_ASSERT(request.block_ids.size() <= GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST,
+              "Requested ${count} blocks, at most ${max} blocks can be requested at a time",
+              ("count", request.block_ids.size())("max", GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST));
+  }
+
+  void block_range_reply::add(std::shared_ptr<const message> reply)
+  {
+    size_t reply_size = fc::raw::pack_size(*reply);
+    if (frame_overhead + reply_size > _max_frame_size)
+    {
+      // the reply doesn't fit into a frame on its own, send it the old way
+      close_frame();
+      frame single;
+      single.messages.push_back(std::move(reply));
+      single.is_block_range = false;
+      _frames.push_back(std::move(single));
+      return;
+    }
+
+    if (_frame_size + reply_size > _max_frame_size)
+      close_frame();
+    _current_frame.messages.push_back(std::move(reply));
+    _frame_size += reply_size;
+  }
+
+  std::vector<block_range_reply::frame> block_range_reply::finish()
+  {
+    close_frame();
+    return std::move(_frames);
+  }
+
+  void block_range_reply::close_frame()
+  {
+    if (_current_frame.messages.empty())
+      return;
+    _frames.push_back(std::move(_current_frame));
+    _current_frame = frame();
+    _frame_size = frame_overhead;
+  }
+
+} } // graphene::net
@@ -45,6 +45,32 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum fetch_block_range_message::type               = core_message_type_enum::fetch_block_range_message_type;
+  const core_message_type_enum block_range_message::type                     = core_message_type_enum::block_range_message_type;
+  const core_message_type_enum compressed_message::type                      = core_message_type_enum::compressed_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_compact_block_transactions_message::type = core_message_type_enum::fetch_compact_block_transactions_message_type;
+  const core_message_type_enum compact_block_transactions_message::type      = core_message_type_enum::compact_block_transactions_message_type;
+  const core_message_type_enum transaction_batch_message::type               = core_message_type_enum::transaction_batch_message_type;
+  const core_message_type_enum start_authenticated_encryption_message::type  = core_message_type_enum::start_authenticated_encryption_message_type;
+
+  compact_block_message::compact_block_message(const item_hash_t& block_message_hash, const block_message& full_block) :
+    block_message_hash(block_message_hash),
+    header(full_block.block),
+    block_id(full_block.block_id)
+  {
+    transactions.reserve(full_block.block.transactions.size());
+    for (const graphene::chain::processed_transaction& trx : full_block.block.transactions)
+      transactions.push_back(compact_block_transaction{short_transaction_id(block_id, trx.id()), trx.operation_results});
+  }
+
+  uint64_t compact_block_message::short_transaction_id(const block_id_type& block_id, const transaction_id_type& trx_id)
+  {
+    fc::sha256::encoder enc;
+    enc.write(block_id.data(), block_id.data_size());
+    enc.write(trx_id.data(), trx_id.data_size());
+    return enc.result()._hash[0];
+  }
 
 } } // graphene::net
 
@@ -0,0 +1,55 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/config.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   *  Splits the reply to a fetch_block_range_message into frames.
+   *
+   *  The replies are loaded once, when the request is received, and the frames keep them until
+   *  they are sent.  A reply which doesn't fit into a frame on its own is sent as a plain message.
+   */
+  class block_range_reply
+  {
+  public:
+    struct frame
+    {
+      std::vector<std::shared_ptr<const message>> messages;
+      /** false for a single reply sent without a block_range_message around it */
+      bool is_block_range = true;
+
+      /** the bytes the frame takes in a send queue, the data of its messages */
+      size_t get_size_in_queue() const;
+    };
+
+    /**
+     *  @param request the request, rejected if it asks for more than
+     *                 GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST blocks
+     *  @param max_message_size our maximum message size, the frames fit into it and into the
+     *                          max_frame_size of the request
+     */
+    block_range_reply(const fetch_block_range_message& request, uint32_t max_message_size);
+
+    /** adds the reply for the next requested block */
+    void add(std::shared_ptr<const message> reply);
+    /** closes the last frame and returns all of them */
+    std::vector<frame> finish();
+
+    size_t get_max_frame_size() const { return _max_frame_size; }
+
+  private:
+    void close_frame();
+
+    size_t             _max_frame_size;
+    size_t             _frame_size;
+    std::vector<frame> _frames;
+    frame              _current_frame;
+  };
+
+} } // graphene::net
@@ -41,6 +41,16 @@
  */
 #define GRAPHENE_PEER_DATABASE_RETRY_DELAY                   15 // seconds
 
+/**
+ * The peer database keeps at most this many peers, the ones we have not seen for
+ * the longest time are dropped first.  Changes are appended to a journal next to
+ * the database file, which is folded into the file once it holds this many entries.
+ * The journal is flushed to disk at most once per flush interval
+ */
+#define GRAPHENE_NET_MAXIMUM_PEER_DATABASE_SIZE              1000
+#define GRAPHENE_NET_PEER_DATABASE_MAXIMUM_JOURNAL_ENTRIES   10000
+#define GRAPHENE_NET_PEER_DATABASE_JOURNAL_FLUSH_INTERVAL_MS 1000
+
 #define GRAPHENE_NET_PEER_HANDSHAKE_INACTIVITY_TIMEOUT       5
 
 #define GRAPHENE_NET_PEER_DISCONNECT_TIMEOUT                 20
@@ -50,7 +60,62 @@
 #define GRAPHENE_NET_DEFAULT_DESIRED_CONNECTIONS             20
 #define GRAPHENE_NET_DEFAULT_MAX_CONNECTIONS                 200
 
+/**
+ * Peers are ranked by the time we expect them to take to deliver a block of
+ * GRAPHENE_NET_PEER_SCORE_BLOCK_SIZE bytes, based on their round trip delay,
+ * block delivery latency and bandwidth.  Until measured, a peer is assumed to
+ * have the default round trip delay and bandwidth
+ */
+#define GRAPHENE_NET_PEER_SCORE_BLOCK_SIZE                   (64 * 1024)
+#define GRAPHENE_NET_PEER_DEFAULT_ROUND_TRIP_DELAY_MS        250
+#define GRAPHENE_NET_PEER_DEFAULT_DOWNLOAD_BYTES_PER_SECOND  (256 * 1024)
+
+/**
+ * The percentage of our connections we make to the measured peers expected to deliver
+ * blocks the fastest.  The others go to random peers, so a set of fast peers can't take
+ * over all our connections.  Either way we connect to one peer per address group (IPv4 /16)
+ * as long as there are candidates from groups we aren't connected to yet
+ */
+#define GRAPHENE_NET_LATENCY_PREFERRED_CONNECTIONS_PERCENT   50
+
+/**
+ * Per-peer limits of the send queue classes.  A peer whose block or housekeeping
+ * queue exceeds its limit is disconnected, inventory over the limit is dropped
+ * and requested transactions over the limit are answered with item_not_available
+ */
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
+#define GRAPHENE_NET_MAXIMUM_QUEUED_INVENTORY_IN_BYTES       (256 * 1024)
+#define GRAPHENE_NET_MAXIMUM_QUEUED_TRANSACTIONS_IN_BYTES    (512 * 1024)
+#define GRAPHENE_NET_MAXIMUM_QUEUED_HOUSEKEEPING_IN_BYTES    (256 * 1024)
+
+#define GRAPHENE_NET_SEND_QUEUE_HISTOGRAM_BUCKETS            8
+
+/**
+ * Traffic by message type is reported for each peer over a window of this many buckets
+ * of this many seconds each
+ */
+#define GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKETS              6
+#define GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKET_SECONDS       10
+
+/**
+ * Block and transaction messages at least this large are sent compressed
+ * to peers supporting compressed_messages_feature
+ */
+#define GRAPHENE_NET_MESSAGE_COMPRESSION_THRESHOLD           512
+
+/**
+ * Queued messages up to this size (inventory, transactions, ...) are sent
+ * together with the messages queued behind them in a single socket write,
+ * as long as the write does not exceed GRAPHENE_NET_MAXIMUM_COALESCED_WRITE_SIZE
+ */
+#define GRAPHENE_NET_MAXIMUM_COALESCED_MESSAGE_SIZE          1024
+#define GRAPHENE_NET_MAXIMUM_COALESCED_WRITE_SIZE            (64 * 1024)
+
+/**
+ * Size of the buffer each connection reads and decrypts incoming data into.
+ * Messages that fit are parsed in place, larger ones are read into the message
+ */
+#define GRAPHENE_NET_READ_BUFFER_SIZE                        (64 * 1024)
 
 /**
  * When we receive a message from the network, we advertise it to
@@ -63,6 +128,13 @@
  */
 #define GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS        5
 
+/**
+ * Default byte budget of the message cache, the least recently requested
+ * messages are evicted before they expire once the cache grows beyond it.
+ * Can be changed with the "message_cache_size_in_bytes" advanced node parameter
+ */
+#define GRAPHENE_NET_MESSAGE_CACHE_MAX_SIZE_IN_BYTES         (64 * 1024 * 1024)
+
 /**
  * We prevent a peer from offering us a list of blocks which, if we fetched them
  * all, would result in a blockchain that extended into the future.
@@ -74,8 +146,49 @@
 
 #define GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES           2
 
+/**
+ * New transactions are collected for this long, or until this many items are
+ * waiting, before they are advertised to our peers together.  A new block is
+ * advertised at once, along with whatever was collected so far.  Can be changed
+ * with the "inventory_advertisement_interval_ms" and
+ * "inventory_advertisement_batch_size" advanced node parameters
+ */
+#define GRAPHENE_NET_INVENTORY_ADVERTISEMENT_INTERVAL_MS     50
+#define GRAPHENE_NET_INVENTORY_ADVERTISEMENT_BATCH_SIZE      256
+
+/**
+ * Each peer remembers the inventory exchanged with it in rolling bloom filters
+ * (see rolling_inventory_filter) of three generations of at most this many items.
+ * 20 bits and 14 hash functions per item give a false positive rate of about 1 in 10^4
+ * per generation, for 50 KiB per generation
+ */
+#define GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION   20000
+#define GRAPHENE_NET_INVENTORY_FILTER_BITS_PER_ITEM          20
+#define GRAPHENE_NET_INVENTORY_FILTER_HASH_FUNCTIONS         14
+
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * Peers supporting block range sync are asked for up to this many blocks
+ * at a time, as long as our backlog of unprocessed sync blocks has room for them.
+ * The blocks are streamed back in frames of at most
+ * GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE bytes (further capped by the
+ * maximum message size of both peers)
+ */
+#define GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST      1000
+#define GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE              (1024 * 1024)
+
+/**
+ * During synchronization each idle peer is asked for the next chunk of blocks
+ * nobody has been asked for yet, sized so that the peer delivers it in about
+ * GRAPHENE_NET_SYNC_CHUNK_DURATION_MS at the rate it delivered its previous
+ * chunks.  Blocks still missing GRAPHENE_NET_SYNC_STALLED_REQUEST_MS after they
+ * were requested are requested once more from another idle peer
+ */
+#define GRAPHENE_NET_SYNC_CHUNK_DURATION_MS                  500
+#define GRAPHENE_NET_MIN_SYNC_CHUNK_SIZE                     10
+#define GRAPHENE_NET_SYNC_STALLED_REQUEST_MS                 2000
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
@@ -98,3 +211,23 @@
 #define GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
 
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      2000
+
+/**
+ * Transactions requested from peers supporting transaction_batch_feature are sent
+ * back in transaction_batch_messages of at most this many bytes
+ */
+#define GRAPHENE_NET_MAX_TRANSACTION_BATCH_SIZE              (64 * 1024)
+
+/**
+ * Blocks and transactions received during normal operation wait in a queue
+ * until the delegate (on the chain thread) has processed the ones before them.
+ * While this many are waiting we stop requesting transactions from our peers,
+ * transactions still arriving once twice as many are waiting are dropped
+ */
+#define GRAPHENE_NET_MAX_DELEGATE_HANDOFF_QUEUE_SIZE         1000
+
+/**
+ * Up to this many transactions waiting next to each other in that queue are passed
+ * to the delegate in a single handle_transactions call
+ */
+#define GRAPHENE_NET_MAX_TRANSACTIONS_PER_DELEGATE_CALL      100
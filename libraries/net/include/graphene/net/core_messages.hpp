@@ -25,6 +25,7 @@
 #pragma once
 
 #include <graphene/net/config.hpp>
+#include <graphene/net/message.hpp>
 #include <graphene/chain/protocol/block.hpp>
 
 #include <fc/crypto/ripemd160.hpp>
@@ -35,6 +36,8 @@
 #include <fc/variant_object.hpp>
 #include <fc/io/enum_type.hpp>
 
+#include <memory>
+
 namespace graphene { namespace net {
   using graphene::chain::signed_transaction;
   using graphene::chain::block_id_type;
@@ -82,11 +85,33 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    fetch_block_range_message_type               = 5018,
+    block_range_message_type                     = 5019,
+    compressed_message_type                      = 5020,
+    compact_block_message_type                   = 5021,
+    fetch_compact_block_transactions_message_type = 5022,
+    compact_block_transactions_message_type      = 5023,
+    transaction_batch_message_type               = 5024,
+    start_authenticated_encryption_message_type  = 5025,
     core_message_type_last                       = 5099
   };
 
   const uint32_t core_protocol_version = GRAPHENE_NET_PROTOCOL_VERSION;
 
+  /**
+   * Optional protocol features.  A node announces the features it supports in the
+   * "supported_features" field of the hello message's user_data, and only uses a feature
+   * with peers that announced it too
+   */
+  enum core_protocol_feature
+  {
+    block_range_sync_feature    = 1 << 0,
+    compressed_messages_feature = 1 << 1,
+    compact_block_relay_feature = 1 << 2,
+    transaction_batch_feature   = 1 << 3,
+    authenticated_encryption_feature = 1 << 4
+  };
+
    struct trx_message
    {
       static const core_message_type_enum type;
@@ -396,6 +421,151 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /**
+   * Requests the blocks with the given ids during synchronization from a peer supporting
+   * block_range_sync_feature.  The ids are consecutive blocks of the peer's chain and the peer
+   * streams them back in block_range_messages of at most max_frame_size bytes
+   */
+  struct fetch_block_range_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<item_hash_t> block_ids;
+    uint32_t                 max_frame_size;
+
+    fetch_block_range_message() : max_frame_size(0) {}
+    fetch_block_range_message(const std::vector<item_hash_t>& block_ids, uint32_t max_frame_size) :
+      block_ids(block_ids),
+      max_frame_size(max_frame_size)
+    {}
+  };
+
+  /**
+   * One frame of the reply to a fetch_block_range_message.  Contains the serialized block_messages
+   * in the order they were requested, and item_not_available_messages for blocks the peer doesn't have
+   */
+  struct block_range_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<message> messages;
+
+    block_range_message() {}
+    block_range_message(std::vector<message> messages) :
+      messages(std::move(messages))
+    {}
+  };
+
+  /**
+   * A message compressed with zlib, sent only to peers supporting compressed_messages_feature.
+   * It is unpacked by the message_oriented_connection, the node never sees it
+   */
+  struct compressed_message
+  {
+    static const core_message_type_enum type;
+
+    uint32_t          msg_type;
+    uint32_t          uncompressed_size;
+    std::vector<char> compressed_data;
+
+    compressed_message() : msg_type(0), uncompressed_size(0) {}
+  };
+
+  struct compact_block_transaction
+  {
+    uint64_t                                       short_id;
+    std::vector<graphene::chain::operation_result> operation_results;
+  };
+
+  /**
+   * A block sent to peers supporting compact_block_relay_feature in reply to a fetch_items_message
+   * of type compact_block_message_type.  Transactions are replaced by short ids, the receiver
+   * rebuilds the block from the transactions it already has and fetches the others with a
+   * fetch_compact_block_transactions_message
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t                            block_message_hash; ///< id of the full block_message
+    graphene::chain::signed_block_header   header;
+    block_id_type                          block_id;
+    std::vector<compact_block_transaction> transactions;
+
+    compact_block_message() {}
+    compact_block_message(const item_hash_t& block_message_hash, const block_message& full_block);
+
+    /** the block id salts the short ids, so collisions can't be precomputed for all blocks */
+    static uint64_t short_transaction_id(const block_id_type& block_id, const transaction_id_type& trx_id);
+  };
+
+  struct fetch_compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t           block_message_hash;
+    std::vector<uint32_t> transaction_indexes;
+
+    fetch_compact_block_transactions_message() {}
+    fetch_compact_block_transactions_message(const item_hash_t& block_message_hash, std::vector<uint32_t> transaction_indexes) :
+      block_message_hash(block_message_hash),
+      transaction_indexes(std::move(transaction_indexes))
+    {}
+  };
+
+  /** reply to a fetch_compact_block_transactions_message, in the order of the requested indexes */
+  struct compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t                     block_message_hash;
+    std::vector<signed_transaction> transactions;
+
+    compact_block_transactions_message() {}
+    compact_block_transactions_message(const item_hash_t& block_message_hash, std::vector<signed_transaction> transactions) :
+      block_message_hash(block_message_hash),
+      transactions(std::move(transactions))
+    {}
+  };
+
+  /**
+   * Transactions sent to peers supporting transaction_batch_feature in reply to a fetch_items_message
+   * of type transaction_batch_message_type.  Each element is a trx_message, handled as if it had
+   * been received on its own.  Requested transactions we don't have are still answered with
+   * item_not_available_messages
+   */
+  struct transaction_batch_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<message> transactions;
+
+    transaction_batch_message() {}
+    transaction_batch_message(std::vector<message> transactions) :
+      transactions(std::move(transactions))
+    {}
+  };
+
+  enum stcp_cipher_suite
+  {
+    aes_256_gcm_cipher_suite = 1
+  };
+
+  /**
+   * Sent to peers supporting authenticated_encryption_feature as the last message encrypted
+   * the old way, everything after it is encrypted with the cipher suite it names.  Each
+   * direction switches on its own.  Handled by the message_oriented_connection, the node
+   * never sees it
+   */
+  struct start_authenticated_encryption_message
+  {
+    static const core_message_type_enum type;
+
+    uint32_t cipher_suite;
+
+    start_authenticated_encryption_message() : cipher_suite(aes_256_gcm_cipher_suite) {}
+  };
+
 
 } } // graphene::net
 
@@ -420,6 +590,14 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (fetch_block_range_message_type)
+                 (block_range_message_type)
+                 (compressed_message_type)
+                 (compact_block_message_type)
+                 (fetch_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
+                 (transaction_batch_message_type)
+                 (start_authenticated_encryption_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -504,6 +682,51 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT(graphene::net::fetch_block_range_message, (block_ids)
+                                                (max_frame_size))
+FC_REFLECT(graphene::net::block_range_message, (messages))
+FC_REFLECT(graphene::net::compressed_message, (msg_type)
+                                         (uncompressed_size)
+                                         (compressed_data))
+FC_REFLECT(graphene::net::compact_block_transaction, (short_id)
+                                                (operation_results))
+FC_REFLECT(graphene::net::compact_block_message, (block_message_hash)
+                                            (header)
+                                            (block_id)
+                                            (transactions))
+FC_REFLECT(graphene::net::fetch_compact_block_transactions_message, (block_message_hash)
+                                                               (transaction_indexes))
+FC_REFLECT(graphene::net::compact_block_transactions_message, (block_message_hash)
+                                                         (transactions))
+FC_REFLECT(graphene::net::transaction_batch_message, (transactions))
+FC_REFLECT(graphene::net::start_authenticated_encryption_message, (cipher_suite))
+
+namespace graphene { namespace net {
+
+  /**
+   * Packs a MessageType whose only member is a std::vector<message>, like block_range_message or
+   * transaction_batch_message, straight from shared messages without copying them into one first
+   */
+  template<typename MessageType>
+  message pack_message_vector(const std::vector<std::shared_ptr<const message>>& messages)
+  {
+    const fc::unsigned_int count(static_cast<uint32_t>(messages.size()));
+    size_t packed_size = fc::raw::pack_size(count);
+    for (const std::shared_ptr<const message>& packed_message : messages)
+      packed_size += fc::raw::pack_size(*packed_message);
+
+    message result;
+    result.msg_type = MessageType::type;
+    result.data.resize(packed_size);
+    fc::datastream<char*> stream(result.data.data(), result.data.size());
+    fc::raw::pack(stream, count);
+    for (const std::shared_ptr<const message>& packed_message : messages)
+      fc::raw::pack(stream, *packed_message);
+    result.size = static_cast<uint32_t>(result.data.size());
+    return result;
+  }
+
+} } // graphene::net
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
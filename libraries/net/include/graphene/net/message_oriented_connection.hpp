@@ -24,6 +24,9 @@
 #pragma once
 #include <fc/network/tcp_socket.hpp>
 #include <graphene/net/message.hpp>
+#include <graphene/net/traffic_statistics.hpp>
+
+#include <memory>
 
 namespace graphene { namespace net {
 
@@ -37,6 +40,12 @@ namespace graphene { namespace net {
   public:
     virtual void on_message(message_oriented_connection* originating_connection, const message& received_message) = 0;
     virtual void on_connection_closed(message_oriented_connection* originating_connection) = 0;
+    /**
+     * returns what to send instead of a message to peers reading compressed_message: its compressed form, or the
+     * message itself if compressing it doesn't pay.  The result is shared by all connections sending the message.
+     * A null pointer if the message isn't shared, it is compressed for this connection only then
+     */
+    virtual std::shared_ptr<const message> get_shared_compressed_message(const message& message_to_send) { return std::shared_ptr<const message>(); }
   };
 
   /** uses a secure socket to create a connection that reads and writes a stream of `fc::net::message` objects */
@@ -53,13 +62,34 @@ namespace graphene { namespace net {
        void bind(const fc::ip::endpoint& local_endpoint);
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
+       /** compresses a large block or transaction message, returns false if that doesn't save at least one padded block */
+       static bool compress_message(const message& message_to_compress, message& result);
+
        void set_block_size(uint32_t block_size);
+       /** compress large block and transaction messages, only for peers that can read compressed_message */
+       void set_compression_enabled(bool enabled);
+       /**
+        * switch what we send to authenticated encryption before the next message, only for peers
+        * supporting authenticated_encryption_feature.  What they send is switched by them
+        */
+       void enable_authenticated_encryption();
+       /** sends a single message and flushes the socket */
        void send_message(const message& message_to_send);
+       /**
+        * sends the messages with one gathered write, directly from their buffers.  The socket is
+        * not flushed, the caller calls flush() once it has nothing more to send
+        */
+       void send_messages(const std::vector<const message*>& messages_to_send);
+       void flush();
        void close_connection();
        void destroy_connection();
 
        uint64_t       get_total_bytes_sent() const;
        uint64_t       get_total_bytes_received() const;
+       uint64_t       get_total_bytes_saved_by_compression() const;
+       /** counts what is read, written and handled inline here, the caller adds queueing delays and deferred processing */
+       traffic_statistics&       get_traffic_statistics();
+       const traffic_statistics& get_traffic_statistics() const;
        fc::time_point get_last_message_sent_time() const;
        fc::time_point get_last_message_received_time() const;
        fc::time_point get_connection_time() const;
@@ -27,6 +27,7 @@
 #include <graphene/net/core_messages.hpp>
 #include <graphene/net/message.hpp>
 #include <graphene/net/peer_database.hpp>
+#include <graphene/net/traffic_statistics.hpp>
 
 #include <graphene/chain/protocol/types.hpp>
 
@@ -89,6 +90,16 @@ namespace graphene { namespace net {
           */
          virtual void handle_transaction( const graphene::net::trx_message& trx_msg ) = 0;
 
+         /**
+          *  @brief Called with transactions that arrived from the network one after another,
+          *         instead of calling handle_transaction for each of them
+          *
+          *  @returns for each transaction the error validating it, or an empty optional if
+          *           it is safe to broadcast on.  The default implementation calls
+          *           handle_transaction for each transaction
+          */
+         virtual std::vector<fc::optional<fc::exception>> handle_transactions( const std::vector<graphene::net::trx_message>& trx_msgs );
+
          /**
           *  @brief Called when a new message comes in from the network other than a
           *         block or a transaction.  Currently there are no other possible
@@ -168,6 +179,21 @@ namespace graphene { namespace net {
          virtual uint8_t get_current_block_interval_in_seconds() const = 0;
    };
 
+   /**
+    *  State of one class of a peer's send queue.  The histograms have
+    *  GRAPHENE_NET_SEND_QUEUE_HISTOGRAM_BUCKETS buckets, bucket 0 counts the value 0,
+    *  bucket n counts values from 4^(n-1) to 4^n - 1 and the last one is open ended.
+    */
+   struct peer_send_queue_status
+   {
+      std::string           queue_class;       ///< blocks, inventory, transactions or housekeeping
+      uint32_t              queued_messages = 0;
+      uint64_t              queued_bytes = 0;
+      uint64_t              dropped_messages = 0;
+      std::vector<uint64_t> queue_depth_histogram;     ///< messages already queued in the class when a message was queued
+      std::vector<uint64_t> queueing_delay_histogram;  ///< milliseconds messages waited before being sent
+   };
+
    /**
     *  Information about connected peers that the client may want to make
     *  available to the user.
@@ -195,6 +221,10 @@ namespace graphene { namespace net {
       graphene::net::item_hash_t current_head_block;
       uint32_t current_head_block_number;
       fc::time_point_sec current_head_block_time;
+      std::vector<peer_send_queue_status> send_queues;
+      peer_performance_record performance;
+      uint32_t expected_block_delivery_time_ms;
+      std::vector<message_type_traffic> traffic; ///< by message type, over the traffic statistics window
    };
 
    struct peer_status
@@ -329,6 +359,14 @@ namespace graphene { namespace net {
 } } // graphene::net
 
 FC_REFLECT(graphene::net::message_propagation_data, (received_time)(validated_time)(originating_peer));
+FC_REFLECT(graphene::net::peer_send_queue_status,
+   (queue_class)
+   (queued_messages)
+   (queued_bytes)
+   (dropped_messages)
+   (queue_depth_histogram)
+   (queueing_delay_histogram)
+);
 FC_REFLECT(graphene::net::peer_status_info,
    (addr)
    (addrlocal)
@@ -351,5 +389,9 @@ FC_REFLECT(graphene::net::peer_status_info,
    (current_head_block)
    (current_head_block_number)
    (current_head_block_time)
+   (send_queues)
+   (performance)
+   (expected_block_delivery_time_ms)
+   (traffic)
 );
 FC_REFLECT( graphene::net::peer_status, (version)(host)(info) );
@@ -27,6 +27,8 @@
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/rolling_inventory_filter.hpp>
+#include <graphene/net/block_range_reply.hpp>
 #include <graphene/net/config.hpp>
 
 #include <boost/tuple/tuple.hpp>
@@ -40,7 +42,9 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
-#include <queue>
+#include <array>
+#include <list>
+#include <map>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
 
@@ -69,7 +73,10 @@ namespace graphene { namespace net
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
       virtual message get_message_for_item(const item_id& item) = 0;
-      virtual message get_message_for_item_optimized(const item_id& item) = 0;
+      /** like get_message_for_item, but shares the buffer of a cached message instead of copying it */
+      virtual std::shared_ptr<const message> get_message_for_item_optimized(const item_id& item) = 0;
+      /** @see message_oriented_connection_delegate::get_shared_compressed_message */
+      virtual std::shared_ptr<const message> get_shared_compressed_message(const message& message_to_send) = 0;
     };
 
     class peer_connection;
@@ -124,7 +131,10 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        /** returns the message to send, it stays valid until the queued_message is destroyed */
+        virtual const message& get_message(peer_connection_delegate* node) = 0;
+        /** returns the type of the message, without generating it */
+        virtual uint32_t get_message_type() const = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -146,7 +156,24 @@ namespace graphene { namespace net
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        const message& get_message(peer_connection_delegate* node) override;
+        uint32_t get_message_type() const override;
+        size_t get_size_in_queue() override;
+      };
+
+      /* a 'shared_queued_message' references an immutable message, typically one from the
+       * node's message cache, so queueing it for many peers doesn't copy it
+       */
+      struct shared_queued_message : queued_message
+      {
+        std::shared_ptr<const message> message_to_send;
+
+        shared_queued_message(std::shared_ptr<const message> message_to_send) :
+          message_to_send(std::move(message_to_send))
+        {}
+
+        const message& get_message(peer_connection_delegate* node) override;
+        uint32_t get_message_type() const override;
         size_t get_size_in_queue() override;
       };
 
@@ -157,18 +184,58 @@ namespace graphene { namespace net
       struct virtual_queued_message : queued_message
       {
         item_id item_to_send;
+        std::shared_ptr<const message> generated_message;
 
         virtual_queued_message(item_id item_to_send) :
           item_to_send(std::move(item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        const message& get_message(peer_connection_delegate* node) override;
+        uint32_t get_message_type() const override;
         size_t get_size_in_queue() override;
       };
 
+      /* a 'block_range_queued_message' is a frame of a block range reply.  It holds the
+       * block messages loaded when the reply was split into frames, the frame itself is
+       * packed when it reaches the top of the queue.
+       */
+      struct block_range_queued_message : queued_message
+      {
+        std::vector<std::shared_ptr<const message>> messages;
+        std::unique_ptr<message> generated_message;
+        size_t size_in_queue;
+
+        block_range_queued_message(std::vector<std::shared_ptr<const message>> messages);
+
+        const message& get_message(peer_connection_delegate* node) override;
+        uint32_t get_message_type() const override;
+        size_t get_size_in_queue() override;
+      };
+
+
+      /* messages are sent from the first non-empty class, in the order of this enum */
+      enum send_queue_class
+      {
+        block_send_queue,        ///< blocks, sync replies and the requests for them
+        inventory_send_queue,
+        transaction_send_queue,
+        housekeeping_send_queue, ///< connection negotiation, addresses, time, firewall checks
+        send_queue_class_count
+      };
+      struct send_queue
+      {
+        std::list<std::unique_ptr<queued_message> > messages;
+        size_t   queued_bytes = 0;
+        uint64_t dropped_messages = 0;
+        std::array<uint64_t, GRAPHENE_NET_SEND_QUEUE_HISTOGRAM_BUCKETS> queue_depth_histogram{};
+        std::array<uint64_t, GRAPHENE_NET_SEND_QUEUE_HISTOGRAM_BUCKETS> queueing_delay_histogram{};
+      };
 
       size_t _total_queued_messages_size;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      size_t _total_queued_messages_count;
+      send_queue _send_queues[send_queue_class_count];
+      /// the frames of block range replies which wait for room in the block send queue
+      std::list<block_range_reply::frame> _pending_block_range_frames;
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -179,6 +246,8 @@ namespace graphene { namespace net
       firewalled_state is_firewalled;
       fc::microseconds clock_offset;
       fc::microseconds round_trip_delay;
+      /// measured on this connection, starting from what we measured on earlier connections to the peer
+      peer_performance_record performance;
 
       our_connection_state our_state;
       bool they_have_requested_close;
@@ -204,6 +273,9 @@ namespace graphene { namespace net
       std::string      user_agent;
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
+      uint32_t         supported_features; /// core_protocol_feature flags from the hello message
+      uint64_t         bytes_saved_by_compression_reported; /// part of get_total_bytes_saved_by_compression() already counted by the bandwidth monitor
+      message_type_traffic traffic_reported; /// part of the total traffic of all types already added to the monitoring counters
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
@@ -227,6 +299,11 @@ namespace graphene { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      std::map<item_hash_t, fc::time_point> sync_items_requested_elsewhere; /// sync items we've requested from this peer (and when), but received from another peer first.  ignored when they arrive, forgotten when the request times out
+      fc::time_point sync_items_request_time; /// when we've requested the outstanding sync items
+      uint32_t sync_items_received_in_batch; /// number of the outstanding sync items received so far
+      double sync_blocks_per_second; /// moving average of the rate the peer delivered sync items at, 0 until measured
+      uint64_t sync_items_request_bytes_received; /// get_total_bytes_received() when we requested the outstanding sync items
       /// @}
 
       /// non-synchronization state data
@@ -246,10 +323,22 @@ namespace graphene { namespace net
                                                                                                             std::hash<item_id> >,
                                                                           boost::multi_index::ordered_non_unique<boost::multi_index::tag<timestamp_index>,
                                                                                                                  boost::multi_index::member<timestamped_item_id, fc::time_point_sec, &timestamped_item_id::timestamp> > > > timestamped_items_set_type;
-      timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      rolling_inventory_filter inventory_peer_advertised_to_us; /// everything this peer advertised to us recently
+      rolling_inventory_filter inventory_advertised_to_peer;    /// everything we advertised to this peer recently
+      /// the items from inventory_peer_advertised_to_us we didn't have when the peer advertised them,
+      /// kept exactly because we decide which peers to fetch from by them
+      timestamped_items_set_type fetchable_inventory_peer_advertised_to_us;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      /// a compact block from this peer waiting for the transactions we didn't have
+      struct partial_compact_block
+      {
+        signed_block          block;
+        std::vector<uint32_t> missing_transaction_indexes;
+        fc::time_point        time_received;
+      };
+      std::map<item_hash_t, partial_compact_block> partial_compact_blocks; /// keyed by the hash of the full block_message
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -284,15 +373,24 @@ namespace graphene { namespace net
 
       void on_message(message_oriented_connection* originating_connection, const message& received_message) override;
       void on_connection_closed(message_oriented_connection* originating_connection) override;
+      std::shared_ptr<const message> get_shared_compressed_message(const message& message_to_send) override;
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      void send_message(std::shared_ptr<const message> message_to_send);
       void send_item(const item_id& item_to_send);
+      /** queues the frames of a block range reply, the ones that don't fit yet follow as the block send queue drains */
+      void send_block_range_reply(std::vector<block_range_reply::frame> frames);
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      uint64_t get_total_bytes_saved_by_compression() const;
+      traffic_statistics&       get_traffic_statistics();
+      const traffic_statistics& get_traffic_statistics() const;
+      void set_compression_enabled(bool enabled);
+      void enable_authenticated_encryption();
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
@@ -303,6 +401,7 @@ namespace graphene { namespace net
 
       bool busy();
       bool idle();
+      bool supports_feature(core_protocol_feature feature) const;
 
       bool is_transaction_fetching_inhibited() const;
       fc::sha512 get_shared_secret() const;
@@ -311,7 +410,13 @@ namespace graphene { namespace net
       bool is_inventory_advertised_to_us_list_full() const;
       bool performing_firewall_check() const;
       fc::optional<fc::ip::endpoint> get_endpoint_for_connecting() const;
+      std::vector<peer_send_queue_status> get_send_queue_status() const;
+      /** whether messages of this type taking size_in_queue bytes fit into their send queue */
+      bool can_queue_message(uint32_t message_type, size_t size_in_queue) const;
     private:
+      static send_queue_class get_send_queue_class(uint32_t message_type);
+      static size_t get_maximum_queued_bytes(send_queue_class queue_class);
+      void queue_pending_block_range_frames();
       void send_queued_messages_task();
       void accept_connection_task();
       void connect_to_task(const fc::ip::endpoint& remote_endpoint);
@@ -42,6 +42,32 @@ namespace graphene { namespace net {
     last_connection_succeeded
   };
 
+  /**
+   * What we measured on our connections to a peer, kept as moving averages.  Zero means
+   * not measured yet
+   */
+  struct peer_performance_record
+  {
+    uint32_t round_trip_delay_ms;       ///< from current_time_request/reply
+    uint32_t block_delivery_latency_ms; ///< from requesting a block during normal operation until receiving it
+    uint32_t download_bytes_per_second; ///< while the peer was sending us sync blocks
+
+    peer_performance_record() :
+      round_trip_delay_ms(0),
+      block_delivery_latency_ms(0),
+      download_bytes_per_second(0)
+    {}
+
+    bool is_measured() const;
+    /** folds the measured values of sample into the moving averages */
+    void update(const peer_performance_record& sample);
+    /**
+     * the time we expect the peer to take to deliver a block, lower is better.
+     * Values not measured yet are assumed to be average
+     */
+    uint32_t get_expected_block_delivery_time_ms() const;
+  };
+
   struct potential_peer_record
   {
     fc::ip::endpoint                  endpoint;
@@ -51,6 +77,7 @@ namespace graphene { namespace net {
     uint32_t                          number_of_successful_connection_attempts;
     uint32_t                          number_of_failed_connection_attempts;
     fc::optional<fc::exception>       last_error;
+    peer_performance_record           performance;
 
     potential_peer_record() :
       number_of_successful_connection_attempts(0),
@@ -91,6 +118,12 @@ namespace graphene { namespace net {
   }
 
 
+  /**
+   * The peers we know about.  Every change is appended to a journal on disk as it is made,
+   * the journal is flushed at most once per GRAPHENE_NET_PEER_DATABASE_JOURNAL_FLUSH_INTERVAL_MS
+   * and by flush(), and folded into the database file when it grows large and at close.
+   * At most GRAPHENE_NET_MAXIMUM_PEER_DATABASE_SIZE peers are kept
+   */
   class peer_database
   {
   public:
@@ -100,6 +133,8 @@ namespace graphene { namespace net {
     void open(const boost::filesystem::path& databaseFilename);
     void close();
     void clear();
+    /** writes the journal entries still buffered to disk */
+    void flush();
 
     void erase(const fc::ip::endpoint& endpointToErase);
 
@@ -118,4 +153,5 @@ namespace graphene { namespace net {
 } } // end namespace graphene::net
 
 FC_REFLECT_ENUM(graphene::net::potential_peer_last_connection_disposition, (never_attempted_to_connect)(last_connection_failed)(last_connection_rejected)(last_connection_handshaking_failed)(last_connection_succeeded))
-FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error) )
+FC_REFLECT(graphene::net::peer_performance_record, (round_trip_delay_ms)(block_delivery_latency_ms)(download_bytes_per_second) )
+FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error)(performance) )
@@ -0,0 +1,60 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/time.hpp>
+
+#include <array>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   *  Remembers which items were seen during roughly the last
+   *  GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES, in a fixed amount of memory.
+   *
+   *  The items are kept in a few generations of bloom filters.  New items go into the
+   *  newest generation, which is retired once it covers its share of the time window or
+   *  holds GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION items; the oldest generation
+   *  is then cleared and reused.  When flooded, items are forgotten earlier rather than the
+   *  filter growing.
+   *
+   *  contains() can report an item that was never inserted (with a probability of roughly
+   *  1 in 10^4), never the other way round, so it must only be used where a false positive
+   *  is harmless or is double-checked against an exact source.
+   */
+  class rolling_inventory_filter
+  {
+  public:
+    rolling_inventory_filter();
+
+    void   insert(const item_id& item);
+    bool   contains(const item_id& item) const;
+    /** retires generations that are older than the time window */
+    void   expire();
+    void   clear();
+
+    /** number of items inserted into the generations that are still live */
+    size_t size() const;
+    size_t memory_usage() const;
+
+  private:
+    struct generation
+    {
+      std::vector<uint64_t> bits; // allocated on the first insert
+      uint32_t              item_count = 0;
+      fc::time_point        start_time;
+    };
+    enum { generation_count = 3 };
+
+    void   start_new_generation(const fc::time_point& now);
+    void   get_hashes(const item_id& item, uint64_t& h1, uint64_t& h2) const;
+
+    std::array<generation, generation_count> _generations;
+    unsigned       _current_generation;
+    uint64_t       _salt[2]; // per-filter random key, peers can't craft items that collide in our filters
+  };
+
+} } // graphene::net
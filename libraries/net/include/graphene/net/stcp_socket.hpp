@@ -26,11 +26,20 @@
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
 
+#include <vector>
+
 namespace graphene { namespace net {
 
+namespace detail { class authenticated_cipher; }
+
 /**
  *  Uses ECDH to negotiate a aes key for communicating
  *  with other nodes on the network.
+ *
+ *  The stream starts out encrypted with the aes stream both sides set up in the key
+ *  exchange.  Each direction can then be switched to AES-256-GCM records, which are
+ *  authenticated and run on AES-NI where the cpu has it.  The switch is announced in
+ *  band by the layer above, see start_authenticated_send() and start_authenticated_receive().
  */
 class stcp_socket : public virtual fc::iostream
 {
@@ -49,6 +58,31 @@ class stcp_socket : public virtual fc::iostream
 
     virtual size_t   writesome( const char* buffer, size_t len ) override;
 
+    /** a piece of the plaintext passed to write_gather() */
+    struct gather_buffer
+    {
+      const char* data;
+      size_t      size;
+    };
+    /**
+     *  Encrypts and writes the concatenation of the buffers, whose total size must be
+     *  a multiple of 16 bytes.  The buffers are encrypted in large chunks through
+     *  reusable per-socket buffers instead of being joined together first.
+     */
+    void             write_gather( const std::vector<gather_buffer>& buffers );
+
+    /**
+     *  Encrypts everything written from now on as authenticated records.  The peer has to
+     *  call start_authenticated_receive() right after reading what was written before.
+     */
+    void             start_authenticated_send();
+    /**
+     *  Decrypts everything read from now on as authenticated records.  The last
+     *  bytes_to_reread bytes returned by readsome() came after the switch, the caller
+     *  drops them and reads them again.
+     */
+    void             start_authenticated_receive( size_t bytes_to_reread );
+
     virtual void     flush() override;
     virtual void     close() override;
 
@@ -57,9 +91,15 @@ class stcp_socket : public virtual fc::iostream
     fc::sha512       get_shared_secret() const { return _shared_secret; }
   private:
     void do_key_exchange();
+    fc::sha256 get_authenticated_key( const fc::ecc::public_key_data& sender_public_key ) const;
+    void read_raw( char* buffer, size_t len );
+    size_t read_authenticated( char* buffer, size_t len );
+    void write_authenticated( const std::vector<gather_buffer>& buffers );
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
+    fc::ecc::public_key_data _local_public_key;
+    fc::ecc::public_key_data _remote_public_key;
     fc::array<char,8>    _buf;
     //uint32_t             _buf_len;
     fc::tcp_socket       _sock;
@@ -67,6 +107,18 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_decoder      _recv_aes;
     std::unique_ptr<char[]> _read_buffer;
     std::unique_ptr<char[]> _write_buffer;
+    std::unique_ptr<char[]> _gather_plaintext_buffer;
+    std::unique_ptr<char[]> _gather_ciphertext_buffer;
+
+    std::unique_ptr<detail::authenticated_cipher> _send_cipher;
+    std::unique_ptr<detail::authenticated_cipher> _recv_cipher;
+    size_t               _last_read_length = 0;
+    std::vector<char>    _reread_buffer;       ///< raw bytes read before the receive direction switched
+    size_t               _reread_begin = 0;
+    std::unique_ptr<char[]> _record_read_buffer;  ///< plaintext of a record larger than the caller asked for
+    size_t               _record_begin = 0;
+    size_t               _record_end = 0;
+    std::unique_ptr<char[]> _record_write_buffer;
 };
 
 typedef std::shared_ptr<stcp_socket> stcp_socket_ptr;
@@ -0,0 +1,72 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+
+#include <graphene/net/config.hpp>
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   *  Traffic of one message type.  Bytes are counted as on the wire, with padding, and a
+   *  compressed message counts for the type it contains
+   */
+  struct message_type_traffic
+  {
+    uint32_t message_type = 0;
+    uint64_t messages_received = 0;
+    uint64_t bytes_received = 0;
+    uint64_t messages_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t queueing_delay_us = 0;   ///< total time the sent messages waited in the send queue
+    uint64_t processing_time_us = 0;  ///< total time spent handling the received messages, by us and by the delegate
+
+    void add(const message_type_traffic& other);
+  };
+
+  /**
+   *  Counts the traffic of a connection by message type, in total and over a window of
+   *  the last GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKETS * GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKET_SECONDS
+   *  seconds.  The window moves in steps of one bucket.
+   */
+  class traffic_statistics
+  {
+  public:
+    void message_received(uint32_t message_type, size_t bytes);
+    void message_sent(uint32_t message_type, size_t bytes);
+    void add_queueing_delay(uint32_t message_type, const fc::microseconds& delay);
+    void add_processing_time(uint32_t message_type, const fc::microseconds& processing_time);
+
+    /** one entry per message type seen in the window, ordered by type */
+    std::vector<message_type_traffic> get_recent_traffic() const;
+    /** since the connection was opened, by type */
+    const std::map<uint32_t, message_type_traffic>& get_total_traffic() const { return _total_traffic; }
+
+  private:
+    struct bucket
+    {
+      uint64_t                                 number; ///< seconds since the epoch / GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKET_SECONDS
+      std::map<uint32_t, message_type_traffic> traffic;
+    };
+
+    template<typename Update>
+    void update(uint32_t message_type, Update update_traffic);
+
+    std::deque<bucket>                       _buckets;
+    std::map<uint32_t, message_type_traffic> _total_traffic;
+  };
+
+} } // graphene::net
+
+FC_REFLECT(graphene::net::message_type_traffic, (message_type)
+                                           (messages_received)
+                                           (bytes_received)
+                                           (messages_sent)
+                                           (bytes_sent)
+                                           (queueing_delay_us)
+                                           (processing_time_us))
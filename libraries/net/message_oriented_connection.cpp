@@ -29,9 +29,15 @@
 #include <fc/io/enum_type.hpp>
 
 #include <graphene/net/message_oriented_connection.hpp>
+#include <graphene/net/core_messages.hpp>
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
 
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -44,6 +50,12 @@
 #endif
 
 namespace graphene { namespace net {
+
+  static size_t padded_message_size(size_t message_size)
+  {
+    return 16 * ((sizeof(message_header) + message_size + 15) / 16);
+  }
+
   namespace detail
   {
     class message_oriented_connection_impl
@@ -56,6 +68,11 @@ namespace graphene { namespace net {
       size_t _max_message_size;
       uint64_t _bytes_received;
       uint64_t _bytes_sent;
+      uint64_t _bytes_saved_by_compression; /// both sent and received
+      traffic_statistics _traffic_statistics;
+      bool _compression_enabled;
+      bool _authenticated_encryption_enabled;
+      bool _sending_authenticated;
       bool _send_message_in_progress;
       bool _run_loop;
 
@@ -69,11 +86,14 @@ namespace graphene { namespace net {
 
       void read_loop();
       void start_read_loop();
+      void decompress_message(const message& compressed_message_received, message& result) const;
     public:
       fc::tcp_socket& get_socket();
       void accept();
       void connect_to(const fc::ip::endpoint& remote_endpoint);
       void set_block_size(uint32_t block_size);
+      void set_compression_enabled(bool enabled);
+      void enable_authenticated_encryption();
       void bind(const fc::ip::endpoint& local_endpoint);
 
       message_oriented_connection_impl(message_oriented_connection* self, message_oriented_connection_delegate* delegate, const std::string& cert_file)
@@ -83,6 +103,10 @@ namespace graphene { namespace net {
         _max_message_size(0),
         _bytes_received(0),
         _bytes_sent(0),
+        _bytes_saved_by_compression(0),
+        _compression_enabled(false),
+        _authenticated_encryption_enabled(false),
+        _sending_authenticated(false),
         _send_message_in_progress(false),
         _run_loop(true)
   #ifndef NDEBUG
@@ -99,6 +123,10 @@ namespace graphene { namespace net {
         _max_message_size(0),
         _bytes_received(0),
         _bytes_sent(0),
+        _bytes_saved_by_compression(0),
+        _compression_enabled(false),
+        _authenticated_encryption_enabled(false),
+        _sending_authenticated(false),
         _send_message_in_progress(false),
         _run_loop(true)
   #ifndef NDEBUG
@@ -109,12 +137,15 @@ namespace graphene { namespace net {
 
       ~message_oriented_connection_impl();
 
-      void send_message(const message& message_to_send);
+      void send_messages(const std::vector<const message*>& messages_to_send);
+      void flush();
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      uint64_t get_total_bytes_saved_by_compression() const;
+      traffic_statistics& get_traffic_statistics() { return _traffic_statistics; }
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
@@ -157,18 +188,48 @@ namespace graphene { namespace net {
       dlog("Set max message size: ${s}", ("s", _max_message_size));
     }
 
+    void message_oriented_connection_impl::set_compression_enabled(bool enabled)
+    {
+      VERIFY_CORRECT_THREAD();
+      _compression_enabled = enabled;
+    }
+
+    void message_oriented_connection_impl::enable_authenticated_encryption()
+    {
+      VERIFY_CORRECT_THREAD();
+      // ssl connections are already authenticated, stcp_socket doesn't encrypt them
+      if (!_sock.get_socket().uses_ssl())
+        _authenticated_encryption_enabled = true;
+    }
+
     void message_oriented_connection_impl::bind(const fc::ip::endpoint& local_endpoint)
     {
       VERIFY_CORRECT_THREAD();
       _sock.bind(local_endpoint);
     }
 
+    void message_oriented_connection_impl::decompress_message(const message& compressed_message_received, message& result) const
+    {
+      compressed_message compressed = compressed_message_received.as<compressed_message>();
+      FC_ASSERT( compressed.uncompressed_size + sizeof(message_header) <= _max_message_size,
+                 "Max message size exceeded by compressed message: ${s} <= ${m}", ("s",compressed.uncompressed_size)("m",_max_message_size) );
+
+      result.msg_type = compressed.msg_type;
+      result.size = compressed.uncompressed_size;
+      result.data.resize(compressed.uncompressed_size);
+
+      boost::iostreams::filtering_istream in;
+      in.push(boost::iostreams::zlib_decompressor());
+      in.push(boost::iostreams::array_source(compressed.compressed_data.data(), compressed.compressed_data.size()));
+      in.read(result.data.data(), result.data.size());
+      FC_ASSERT( (size_t)in.gcount() == result.data.size() && in.peek() == std::char_traits<char>::eof(), "Invalid compressed message" );
+    }
+
     void message_oriented_connection_impl::read_loop()
     {
       VERIFY_CORRECT_THREAD();
-      const int BUFFER_SIZE = 16;
-      const int LEFTOVER = BUFFER_SIZE - sizeof(message_header);
-      static_assert(BUFFER_SIZE >= sizeof(message_header), "insufficient buffer");
+      static_assert(sizeof(message_header) <= 16, "the header must fit in the first padded block");
+      static_assert((GRAPHENE_NET_READ_BUFFER_SIZE % 16) == 0, "the read buffer must hold whole aes blocks");
 
       _connected_time = fc::time_point::now();
 
@@ -179,33 +240,90 @@ namespace graphene { namespace net {
 
       try
       {
+        // decrypted bytes not parsed yet are [read_begin, read_end) of read_buffer.  Everything on the wire
+        // is padded to 16 bytes, so both offsets and the free space behind read_end stay multiples of 16
+        std::unique_ptr<char[]> read_buffer(new char[GRAPHENE_NET_READ_BUFFER_SIZE]);
+        size_t read_begin = 0;
+        size_t read_end = 0;
+        auto fill_read_buffer = [&](size_t bytes_wanted) {
+          if (GRAPHENE_NET_READ_BUFFER_SIZE - read_begin < bytes_wanted)
+          {
+            memmove(read_buffer.get(), read_buffer.get() + read_begin, read_end - read_begin);
+            read_end -= read_begin;
+            read_begin = 0;
+          }
+          while (read_end - read_begin < bytes_wanted)
+          {
+            size_t bytes_read = _sock.readsome(read_buffer.get() + read_end, GRAPHENE_NET_READ_BUFFER_SIZE - read_end);
+            read_end += bytes_read;
+            _bytes_received += bytes_read;
+          }
+        };
+
+        // m and decompressed keep their data capacity from one message to the next
         message m;
+        message decompressed;
         _run_loop = true;
         while(true)
         {
-          char buffer[BUFFER_SIZE];
-          _sock.read(buffer, BUFFER_SIZE);
-          _bytes_received += BUFFER_SIZE;
-          memcpy((char*)&m, buffer, sizeof(message_header));
+          if (read_begin == read_end)
+            read_begin = read_end = 0;
+          fill_read_buffer(16);
+          memcpy((char*)&m, read_buffer.get() + read_begin, sizeof(message_header));
 
           FC_ASSERT( m.size <= _max_message_size, "Max message size exceeded: ${s} <= ${m}", ("s",m.size)("m",_max_message_size) );
 
-          size_t remaining_bytes_with_padding = 16 * ((m.size - LEFTOVER + 15) / 16);
-          m.data.resize(LEFTOVER + remaining_bytes_with_padding); //give extra 16 bytes to allow for padding added in send call
-          std::copy(buffer + sizeof(message_header), buffer + sizeof(buffer), m.data.begin());
-          if (remaining_bytes_with_padding)
+          size_t size_with_padding = padded_message_size(m.size);
+          if (size_with_padding <= GRAPHENE_NET_READ_BUFFER_SIZE)
           {
-            _sock.read(&m.data[LEFTOVER], remaining_bytes_with_padding);
+            fill_read_buffer(size_with_padding);
+            const char* message_data = read_buffer.get() + read_begin + sizeof(message_header);
+            m.data.assign(message_data, message_data + m.size);
+            read_begin += size_with_padding;
+          }
+          else
+          {
+            // too large for the buffer, take what is buffered and read the rest straight into the message
+            size_t buffered_bytes = read_end - read_begin - sizeof(message_header);
+            m.data.resize(size_with_padding - sizeof(message_header));
+            memcpy(m.data.data(), read_buffer.get() + read_begin + sizeof(message_header), buffered_bytes);
+            read_begin = read_end = 0;
+            size_t remaining_bytes_with_padding = size_with_padding - sizeof(message_header) - buffered_bytes;
+            _sock.read(m.data.data() + buffered_bytes, remaining_bytes_with_padding);
             _bytes_received += remaining_bytes_with_padding;
+            m.data.resize(m.size); // truncate off the padding bytes
+          }
+
+          if (m.msg_type == start_authenticated_encryption_message_type)
+          {
+            start_authenticated_encryption_message start_message = m.as<start_authenticated_encryption_message>();
+            FC_ASSERT( start_message.cipher_suite == aes_256_gcm_cipher_suite,
+                       "Unknown cipher suite ${suite}", ("suite", start_message.cipher_suite) );
+            // whatever we read after the switch went through the wrong cipher, have the socket read it again
+            _sock.start_authenticated_receive(read_end - read_begin);
+            _bytes_received -= read_end - read_begin;
+            read_begin = read_end = 0;
+            _traffic_statistics.message_received(m.msg_type, size_with_padding);
+            continue;
+          }
+
+          const message* received_message = &m;
+          if (m.msg_type == compressed_message_type)
+          {
+            decompress_message(m, decompressed);
+            if (padded_message_size(decompressed.size) > padded_message_size(m.size))
+              _bytes_saved_by_compression += padded_message_size(decompressed.size) - padded_message_size(m.size);
+            received_message = &decompressed;
           }
-          m.data.resize(m.size); // truncate off the padding bytes
 
           _last_message_received_time = fc::time_point::now();
+          _traffic_statistics.message_received(received_message->msg_type, size_with_padding);
 
           try
           {
             // message handling errors are warnings...
-            _delegate->on_message(_self, m);
+            _delegate->on_message(_self, *received_message);
+            _traffic_statistics.add_processing_time(received_message->msg_type, fc::time_point::now() - _last_message_received_time);
           }
           /// Dedicated catches needed to distinguish from general fc::exception
           catch ( const fc::canceled_exception& e ) { throw e; }
@@ -266,7 +384,7 @@ namespace graphene { namespace net {
         throw *exception_to_rethrow;
     }
 
-    void message_oriented_connection_impl::send_message(const message& message_to_send)
+    void message_oriented_connection_impl::send_messages(const std::vector<const message*>& messages_to_send)
     {
       VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
@@ -276,8 +394,8 @@ namespace graphene { namespace net {
         remote_endpoint = _sock.get_socket().remote_endpoint();
       struct scope_logger {
         const fc::optional<fc::ip::endpoint>& endpoint;
-        scope_logger(const fc::optional<fc::ip::endpoint>& endpoint) : endpoint(endpoint) { dlog("entering message_oriented_connection::send_message() for peer ${endpoint}", ("endpoint", endpoint)); }
-        ~scope_logger() { dlog("leaving message_oriented_connection::send_message() for peer ${endpoint}", ("endpoint", endpoint)); }
+        scope_logger(const fc::optional<fc::ip::endpoint>& endpoint) : endpoint(endpoint) { dlog("entering message_oriented_connection::send_messages() for peer ${endpoint}", ("endpoint", endpoint)); }
+        ~scope_logger() { dlog("leaving message_oriented_connection::send_messages() for peer ${endpoint}", ("endpoint", endpoint)); }
       } send_message_scope_logger(remote_endpoint);
 #endif
 #endif
@@ -295,21 +413,83 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        FC_ASSERT( size_of_message_and_header <= _max_message_size,
-          "Trying to send a message larger than max message size: ${s} <= ${m}", ("s",size_of_message_and_header)("m",_max_message_size));
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
-        _sock.flush();
-        _bytes_sent += size_with_padding;
+        static const char zero_padding[16] = {};
+
+        if (_authenticated_encryption_enabled && !_sending_authenticated)
+        {
+          // the last message the peer decrypts the old way
+          message start_message(start_authenticated_encryption_message{});
+          size_t padding = padded_message_size(start_message.size) - sizeof(message_header) - start_message.size;
+          _sock.write_gather({{(const char*)&start_message, sizeof(message_header)},
+                              {start_message.data.data(), start_message.size},
+                              {zero_padding, padding}});
+          _sock.start_authenticated_send();
+          _sending_authenticated = true;
+          _bytes_sent += padded_message_size(start_message.size);
+          _traffic_statistics.message_sent(start_message.msg_type, padded_message_size(start_message.size));
+        }
+
+        // the messages are written straight from their own buffers, only the compressed
+        // ones are built here.  Reserved up front so the pointers into it stay valid
+        std::vector<message> compressed_messages;
+        compressed_messages.reserve(messages_to_send.size());
+        // messages shared by several connections are compressed once, for all of them
+        std::vector<std::shared_ptr<const message>> shared_compressed_messages;
+        std::vector<stcp_socket::gather_buffer> buffers;
+        buffers.reserve(3 * messages_to_send.size());
+        size_t bytes_to_send = 0;
+
+        for (const message* message_to_send : messages_to_send)
+        {
+          size_t size_of_message_and_header = sizeof(message_header) + message_to_send->size;
+          FC_ASSERT( size_of_message_and_header <= _max_message_size,
+            "Trying to send a message larger than max message size: ${s} <= ${m}", ("s",size_of_message_and_header)("m",_max_message_size));
+
+          const message* message_on_wire = message_to_send;
+          if (_compression_enabled)
+          {
+            std::shared_ptr<const message> shared_compressed = _delegate->get_shared_compressed_message(*message_to_send);
+            if (shared_compressed)
+            {
+              message_on_wire = shared_compressed.get();
+              shared_compressed_messages.push_back(std::move(shared_compressed));
+            }
+            else
+            {
+              compressed_messages.emplace_back();
+              if (message_oriented_connection::compress_message(*message_to_send, compressed_messages.back()))
+                message_on_wire = &compressed_messages.back();
+              else
+                compressed_messages.pop_back();
+            }
+            if (message_on_wire != message_to_send)
+              _bytes_saved_by_compression += padded_message_size(message_to_send->size) - padded_message_size(message_on_wire->size);
+          }
+
+          //pad the message we send to a multiple of 16 bytes
+          size_t size_with_padding = padded_message_size(message_on_wire->size);
+          buffers.push_back({(const char*)message_on_wire, sizeof(message_header)});
+          if (message_on_wire->size)
+            buffers.push_back({message_on_wire->data.data(), message_on_wire->size});
+          size_t padding = size_with_padding - sizeof(message_header) - message_on_wire->size;
+          if (padding)
+            buffers.push_back({zero_padding, padding});
+          bytes_to_send += size_with_padding;
+          _traffic_statistics.message_sent(message_to_send->msg_type, size_with_padding);
+        }
+
+        _sock.write_gather(buffers);
+        _bytes_sent += bytes_to_send;
         _last_message_sent_time = fc::time_point::now();
       } FC_LOG_AND_RETHROW( )
     }
 
+    void message_oriented_connection_impl::flush()
+    {
+      VERIFY_CORRECT_THREAD();
+      _sock.flush();
+    }
+
     void message_oriented_connection_impl::close_connection()
     {
       VERIFY_CORRECT_THREAD();
@@ -356,6 +536,12 @@ namespace graphene { namespace net {
       return _bytes_received;
     }
 
+    uint64_t message_oriented_connection_impl::get_total_bytes_saved_by_compression() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _bytes_saved_by_compression;
+    }
+
     fc::time_point message_oriented_connection_impl::get_last_message_sent_time() const
     {
       VERIFY_CORRECT_THREAD();
@@ -376,6 +562,33 @@ namespace graphene { namespace net {
 
   } // end namespace graphene::net::detail
 
+  bool message_oriented_connection::compress_message(const message& message_to_compress, message& result)
+  {
+    if (message_to_compress.size < GRAPHENE_NET_MESSAGE_COMPRESSION_THRESHOLD ||
+        (message_to_compress.msg_type != trx_message_type &&
+         message_to_compress.msg_type != transaction_batch_message_type &&
+         message_to_compress.msg_type != block_message_type &&
+         message_to_compress.msg_type != block_range_message_type))
+      return false;
+
+    compressed_message compressed;
+    compressed.msg_type = message_to_compress.msg_type;
+    compressed.uncompressed_size = message_to_compress.size;
+    {
+      boost::iostreams::filtering_ostream out;
+      out.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
+      out.push(boost::iostreams::back_inserter(compressed.compressed_data));
+      out.write(message_to_compress.data.data(), message_to_compress.data.size());
+      out.reset();
+    }
+
+    result.msg_type = compressed_message_type;
+    result.data = fc::raw::pack(compressed);
+    result.size = (uint32_t)result.data.size();
+    // sending it compressed has to save at least one padded block
+    return padded_message_size(result.size) < padded_message_size(message_to_compress.size);
+  }
+
   message_oriented_connection::message_oriented_connection(message_oriented_connection_delegate* delegate, const std::string& cert_file)
     : my(new detail::message_oriented_connection_impl(this, delegate, cert_file))
   {
@@ -416,9 +629,30 @@ namespace graphene { namespace net {
     my->set_block_size(block_size);
   }
 
+  void message_oriented_connection::set_compression_enabled(bool enabled)
+  {
+    my->set_compression_enabled(enabled);
+  }
+
+  void message_oriented_connection::enable_authenticated_encryption()
+  {
+    my->enable_authenticated_encryption();
+  }
+
   void message_oriented_connection::send_message(const message& message_to_send)
   {
-    my->send_message(message_to_send);
+    my->send_messages(std::vector<const message*>{&message_to_send});
+    my->flush();
+  }
+
+  void message_oriented_connection::send_messages(const std::vector<const message*>& messages_to_send)
+  {
+    my->send_messages(messages_to_send);
+  }
+
+  void message_oriented_connection::flush()
+  {
+    my->flush();
   }
 
   void message_oriented_connection::close_connection()
@@ -441,6 +675,21 @@ namespace graphene { namespace net {
     return my->get_total_bytes_received();
   }
 
+  traffic_statistics& message_oriented_connection::get_traffic_statistics()
+  {
+    return my->get_traffic_statistics();
+  }
+
+  const traffic_statistics& message_oriented_connection::get_traffic_statistics() const
+  {
+    return my->get_traffic_statistics();
+  }
+
+  uint64_t message_oriented_connection::get_total_bytes_saved_by_compression() const
+  {
+    return my->get_total_bytes_saved_by_compression();
+  }
+
   fc::time_point message_oriented_connection::get_last_message_sent_time() const
   {
     return my->get_last_message_sent_time();
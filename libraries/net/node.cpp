@@ -26,10 +26,13 @@
 #include <iomanip>
 #include <deque>
 #include <unordered_set>
+#include <unordered_map>
 #include <list>
 #include <forward_list>
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <random>
 #include <tuple>
 #include <boost/tuple/tuple.hpp>
 #include <boost/circular_buffer.hpp>
@@ -73,6 +76,7 @@
 #include <fc/smart_ref_impl.hpp>
 #include <fc/monitoring.hpp>
 
+#include <graphene/net/block_range_reply.hpp>
 #include <graphene/net/node.hpp>
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/peer_connection.hpp>
@@ -115,6 +119,12 @@ namespace graphene { namespace net {
   namespace detail
   {
     namespace bmi = boost::multi_index;
+    /**
+     * Keeps the messages we relayed recently, so we can serve them to peers that request them.
+     * The messages are immutable and reference counted, the copies queued for our peers share
+     * their buffers with the cache.  Messages expire after cache_duration_in_blocks blocks, and
+     * the least recently used ones are evicted early when the cache exceeds its byte budget.
+     */
     class blockchain_tied_message_cache
     {
     private:
@@ -123,10 +133,14 @@ namespace graphene { namespace net {
       struct message_hash_index{};
       struct message_contents_hash_index{};
       struct block_clock_index{};
+      struct lru_index{};
+      struct message_body_index{};
       struct message_info
       {
         message_hash_type message_hash;
-        message           message_body;
+        std::shared_ptr<const message> message_body;
+        /// what peers reading compressed_message get, compressed on the first send to such a peer
+        mutable std::shared_ptr<const message> compressed_body;
         uint32_t          block_clock_when_received;
 
         // for network performance stats
@@ -134,50 +148,128 @@ namespace graphene { namespace net {
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      std::shared_ptr<const message> message_body,
                       uint32_t                 block_clock_when_received,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
           message_hash( message_hash ),
-          message_body( message_body ),
+          message_body( std::move(message_body) ),
           block_clock_when_received( block_clock_when_received ),
           propagation_data( propagation_data ),
           message_contents_hash( message_contents_hash )
         {}
+
+        const message* get_message_body() const { return message_body.get(); }
+      };
+      struct hash_hasher
+      {
+        size_t operator()( const fc::uint160_t& hash ) const { return fc::city_hash_size_t( hash.data(), hash.data_size() ); }
       };
       typedef boost::multi_index_container
         < message_info,
-            bmi::indexed_by< bmi::ordered_unique< bmi::tag<message_hash_index>,
-                                                  bmi::member<message_info, message_hash_type, &message_info::message_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<message_contents_hash_index>,
-                                                      bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash> >,
+            bmi::indexed_by< bmi::hashed_unique< bmi::tag<message_hash_index>,
+                                                 bmi::member<message_info, message_hash_type, &message_info::message_hash>,
+                                                 hash_hasher >,
+                             bmi::hashed_non_unique< bmi::tag<message_contents_hash_index>,
+                                                     bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash>,
+                                                     hash_hasher >,
                              bmi::ordered_non_unique< bmi::tag<block_clock_index>,
-                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> > >
+                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> >,
+                             bmi::sequenced< bmi::tag<lru_index> >,
+                             bmi::hashed_unique< bmi::tag<message_body_index>,
+                                                 bmi::const_mem_fun<message_info, const message*, &message_info::get_message_body> > >
         > message_cache_container;
 
       message_cache_container _message_cache;
 
+      /// short ids depend on the block, so the cached transactions are indexed by the short ids of one block, the one
+      /// a compact block arrived for last.  Ambiguous short ids have several entries
+      block_id_type _short_id_block_id;
+      std::unordered_multimap<uint64_t, const message*> _transactions_by_short_id;
+
       uint32_t block_clock;
 
+      size_t   _max_size_in_bytes;
+      size_t   _size_in_bytes;
+      uint64_t _lookups;
+      uint64_t _hits;
+      uint64_t _evictions;
+
+      static size_t get_size_in_bytes( const message_info& info )
+      {
+        size_t size = sizeof(message_info) + sizeof(message) + info.message_body->data.size();
+        if( info.compressed_body && info.compressed_body != info.message_body )
+          size += sizeof(message) + info.compressed_body->data.size();
+        return size;
+      }
+      void erase( message_cache_container::index<block_clock_index>::type::iterator first,
+                  message_cache_container::index<block_clock_index>::type::iterator last );
+      void evict_least_recently_used();
+      void add_short_id( const message_info& info );
+      void remove_short_id( const message_info& info );
+
     public:
       blockchain_tied_message_cache() :
-        block_clock( 0 )
+        block_clock( 0 ),
+        _max_size_in_bytes( GRAPHENE_NET_MESSAGE_CACHE_MAX_SIZE_IN_BYTES ),
+        _size_in_bytes( 0 ),
+        _lookups( 0 ),
+        _hits( 0 ),
+        _evictions( 0 )
       {}
       void block_accepted();
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
-      const message* get_message_ptr(const message_hash_type& hash_of_message_to_lookup);
+      /** returns the cached message, or a null pointer if it isn't cached */
+      std::shared_ptr<const message> get_message( const message_hash_type& hash_of_message_to_lookup );
+      bool contains( const message_hash_type& hash_of_message_to_lookup ) const;
+      /**
+       * returns the form of a cached message sent to peers reading compressed_message, it is compressed only once.
+       * A null pointer if the message isn't from the cache
+       */
+      std::shared_ptr<const message> get_compressed_message( const message& message_to_send );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
+      /** returns the cached transaction message with the short id in a compact block, or nullptr if it isn't cached or is ambiguous */
+      const message* get_transaction_message_by_short_id( const block_id_type& block_id, uint64_t short_id );
+      void set_max_size_in_bytes( size_t max_size_in_bytes );
+      size_t get_max_size_in_bytes() const { return _max_size_in_bytes; }
       size_t size() const { return _message_cache.size(); }
+      size_t size_in_bytes() const { return _size_in_bytes; }
+      uint64_t get_evictions() const { return _evictions; }
+      /** the fraction of lookups that found the message in the cache */
+      double get_hit_rate() const { return _lookups ? (double)_hits / _lookups : 0.; }
     };
 
+    void blockchain_tied_message_cache::erase( message_cache_container::index<block_clock_index>::type::iterator first,
+                                               message_cache_container::index<block_clock_index>::type::iterator last )
+    {
+      for( auto iter = first; iter != last; ++iter )
+      {
+        _size_in_bytes -= get_size_in_bytes( *iter );
+        remove_short_id( *iter );
+      }
+      _message_cache.get<block_clock_index>().erase( first, last );
+    }
+
+    void blockchain_tied_message_cache::evict_least_recently_used()
+    {
+      // the most recently used message stays even if it is larger than the whole budget
+      auto& lru = _message_cache.get<lru_index>();
+      while( _size_in_bytes > _max_size_in_bytes && lru.size() > 1 )
+      {
+        _size_in_bytes -= get_size_in_bytes( lru.front() );
+        remove_short_id( lru.front() );
+        lru.pop_front();
+        ++_evictions;
+      }
+    }
+
     void blockchain_tied_message_cache::block_accepted()
     {
       ++block_clock;
       if( block_clock > cache_duration_in_blocks )
-        _message_cache.get<block_clock_index>().erase(_message_cache.get<block_clock_index>().begin(),
-                                                      _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
+        erase( _message_cache.get<block_clock_index>().begin(),
+               _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
     }
 
     void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
@@ -185,30 +277,55 @@ namespace graphene { namespace net {
                                                      const message_propagation_data& propagation_data,
                                                      const fc::uint160_t& message_content_hash )
     {
-      _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
-                                         block_clock,
-                                         propagation_data,
-                                         message_content_hash ) );
+      auto insert_result = _message_cache.insert( message_info(hash_of_message_to_cache,
+                                                               std::make_shared<const message>(message_to_cache),
+                                                               block_clock,
+                                                               propagation_data,
+                                                               message_content_hash ) );
+      if( insert_result.second )
+      {
+        _size_in_bytes += get_size_in_bytes( *insert_result.first );
+        add_short_id( *insert_result.first );
+        evict_least_recently_used();
+      }
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    std::shared_ptr<const message> blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
     {
-      message_cache_container::index<message_hash_index>::type::const_iterator iter =
-         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
-      if( iter != _message_cache.get<message_hash_index>().end() )
-        return iter->message_body;
-      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+      ++_lookups;
+      auto iter = _message_cache.get<message_hash_index>().find( hash_of_message_to_lookup );
+      if( iter == _message_cache.get<message_hash_index>().end() )
+        return std::shared_ptr<const message>();
+      ++_hits;
+      auto& lru = _message_cache.get<lru_index>();
+      lru.relocate( lru.end(), _message_cache.project<lru_index>( iter ) );
+      return iter->message_body;
     }
 
-    const message* blockchain_tied_message_cache::get_message_ptr(const message_hash_type& hash_of_message_to_lookup)
+    bool blockchain_tied_message_cache::contains( const message_hash_type& hash_of_message_to_lookup ) const
     {
-       message_cache_container::index<message_hash_index>::type::const_iterator iter =
-          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup);
-       if (iter != _message_cache.get<message_hash_index>().end()) {
-          return &(iter->message_body);
-       }
-       return nullptr;
+      return _message_cache.get<message_hash_index>().find( hash_of_message_to_lookup ) != _message_cache.get<message_hash_index>().end();
+    }
+
+    std::shared_ptr<const message> blockchain_tied_message_cache::get_compressed_message( const message& message_to_send )
+    {
+      auto iter = _message_cache.get<message_body_index>().find( &message_to_send );
+      if( iter == _message_cache.get<message_body_index>().end() )
+        return std::shared_ptr<const message>();
+      if( !iter->compressed_body )
+      {
+        message compressed;
+        if( message_oriented_connection::compress_message( *iter->message_body, compressed ) )
+        {
+          std::shared_ptr<const message> compressed_body = std::make_shared<const message>( std::move( compressed ) );
+          iter->compressed_body = compressed_body;
+          _size_in_bytes += sizeof(message) + compressed_body->data.size();
+          evict_least_recently_used();
+          return compressed_body;
+        }
+        iter->compressed_body = iter->message_body;
+      }
+      return iter->compressed_body;
     }
 
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
@@ -223,6 +340,48 @@ namespace graphene { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    void blockchain_tied_message_cache::set_max_size_in_bytes( size_t max_size_in_bytes )
+    {
+      _max_size_in_bytes = max_size_in_bytes;
+      evict_least_recently_used();
+    }
+
+    void blockchain_tied_message_cache::add_short_id( const message_info& info )
+    {
+      if( _short_id_block_id != block_id_type() && info.message_body->msg_type == trx_message_type )
+        _transactions_by_short_id.emplace( compact_block_message::short_transaction_id( _short_id_block_id, info.message_contents_hash ),
+                                           info.message_body.get() );
+    }
+
+    void blockchain_tied_message_cache::remove_short_id( const message_info& info )
+    {
+      if( _short_id_block_id == block_id_type() || info.message_body->msg_type != trx_message_type )
+        return;
+      auto range = _transactions_by_short_id.equal_range( compact_block_message::short_transaction_id( _short_id_block_id, info.message_contents_hash ) );
+      for( auto iter = range.first; iter != range.second; ++iter )
+        if( iter->second == info.message_body.get() )
+        {
+          _transactions_by_short_id.erase( iter );
+          return;
+        }
+    }
+
+    const message* blockchain_tied_message_cache::get_transaction_message_by_short_id( const block_id_type& block_id, uint64_t short_id )
+    {
+      if( block_id != _short_id_block_id )
+      {
+        _short_id_block_id = block_id;
+        _transactions_by_short_id.clear();
+        _transactions_by_short_id.reserve( _message_cache.size() );
+        for( const message_info& info : _message_cache )
+          add_short_id( info );
+      }
+      auto range = _transactions_by_short_id.equal_range( short_id );
+      if( range.first == range.second || std::next( range.first ) != range.second )
+        return nullptr;
+      return range.first->second;
+    }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -275,6 +434,22 @@ namespace graphene { namespace net { namespace detail {
       }
     };
 
+    // a sync block waiting in the backlog until it is the next block a peer expects us to process
+    struct received_sync_item
+    {
+      graphene::net::block_message message;
+      item_hash_t                  block_id;
+      uint32_t                     block_number;
+      fc::time_point               received_time;
+
+      received_sync_item(const graphene::net::block_message& message) :
+        message(message),
+        block_id(message.block_id),
+        block_number(message.block.block_num()),
+        received_time(fc::time_point::now())
+      {}
+    };
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
     class statistics_gathering_node_delegate_wrapper : public node_delegate
     {
@@ -291,6 +466,7 @@ namespace graphene { namespace net { namespace detail {
                                    (handle_message) \
                                    (handle_block) \
                                    (handle_transaction) \
+                                   (handle_transactions) \
                                    (get_block_ids) \
                                    (get_item) \
                                    (get_chain_id) \
@@ -386,6 +562,7 @@ namespace graphene { namespace net { namespace detail {
       void handle_message( const message& ) override;
       uint32_t handle_block( const graphene::net::block_message& block_message, bool sync_mode, std::vector<fc::uint160_t>& contained_transaction_message_ids ) override;
       void handle_transaction( const graphene::net::trx_message& transaction_message ) override;
+      std::vector<fc::optional<fc::exception>> handle_transactions( const std::vector<graphene::net::trx_message>& transaction_messages ) override;
       std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 5000) override;
@@ -413,9 +590,20 @@ namespace graphene { namespace net { namespace detail {
     MONITORING_DEFINE_COUNTER(connections_node_outbound_active_max)
     MONITORING_DEFINE_COUNTER(transactions_queued_to_broadcast)
     MONITORING_DEFINE_COUNTER(transactions_received)
+    MONITORING_DEFINE_TRANSIENT_COUNTER(sync_backlog_size)
+    MONITORING_DEFINE_COUNTER(sync_backlog_size_max)
+    MONITORING_DEFINE_COUNTER(sync_blocks_handed_off)
+    MONITORING_DEFINE_COUNTER(sync_handoff_latency_us)
+    MONITORING_DEFINE_COUNTER(p2p_messages_received)
+    MONITORING_DEFINE_COUNTER(p2p_bytes_received)
+    MONITORING_DEFINE_COUNTER(p2p_messages_sent)
+    MONITORING_DEFINE_COUNTER(p2p_bytes_sent)
+    MONITORING_DEFINE_COUNTER(p2p_queueing_delay_us)
+    MONITORING_DEFINE_COUNTER(p2p_processing_time_us)
     MONITORING_COUNTERS_DEPENDENCIES
     MONITORING_COUNTER_DEPENDENCY(connections_node_inbound_active_max, connections_node_inbound_active)
     MONITORING_COUNTER_DEPENDENCY(connections_node_outbound_active_max, connections_node_outbound_active)
+    MONITORING_COUNTER_DEPENDENCY(sync_backlog_size_max, sync_backlog_size)
     MONITORING_COUNTERS_END
 
     class node_impl : public peer_connection_delegate PUBLIC_DERIVATION_FROM_MONITORING_CLASS(node_impl)
@@ -429,7 +617,7 @@ namespace graphene { namespace net { namespace detail {
       fc::sha256           _chain_id;
 
 #define NODE_CONFIGURATION_FILENAME      "node_config.json"
-#define POTENTIAL_PEER_DATABASE_FILENAME "peers.json"
+#define POTENTIAL_PEER_DATABASE_FILENAME "peers.dat" // replaces peers.json, which is imported if found
       boost::filesystem::path _node_configuration_directory;
       node_configuration   _node_configuration;
 
@@ -451,6 +639,8 @@ namespace graphene { namespace net { namespace detail {
       peer_database             _potential_peer_db;
       bool                      _potential_peer_database_updated;
       fc::future<void>          _p2p_network_connect_loop_done;
+      std::unordered_set<fc::ip::endpoint> _connections_chosen_by_latency; /// the endpoints we connected to for their expected block delivery time
+      std::mt19937              _connection_candidate_shuffler;
       // @}
 
       /// used by the task that fetches sync items during synchronization
@@ -461,9 +651,19 @@ namespace graphene { namespace net { namespace detail {
 
       typedef std::unordered_map<graphene::net::block_id_type, fc::time_point> active_sync_requests_map;
 
+      struct sync_item_block_id_index{};
+      struct sync_item_block_number_index{};
+      typedef boost::multi_index_container<received_sync_item,
+                                           boost::multi_index::indexed_by<boost::multi_index::hashed_unique<boost::multi_index::tag<sync_item_block_id_index>,
+                                                                                                            boost::multi_index::member<received_sync_item, item_hash_t, &received_sync_item::block_id>,
+                                                                                                            std::hash<item_hash_t> >,
+                                                                          boost::multi_index::ordered_non_unique<boost::multi_index::tag<sync_item_block_number_index>,
+                                                                                                                 boost::multi_index::member<received_sync_item, uint32_t, &received_sync_item::block_number> > >
+                                           > received_sync_items_set_type;
+
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
-      std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
-      std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      received_sync_items_set_type          _received_sync_items; /// sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      std::unordered_set<item_hash_t>       _rerequested_sync_items; /// sync blocks we've asked a second peer for because the first request stalled
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -492,6 +692,32 @@ namespace graphene { namespace net { namespace detail {
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
       fc::future<void>              _advertise_inventory_loop_done;
       std::unordered_set<item_id>   _new_inventory; /// list of items we have received but not yet advertised to our peers
+      std::unordered_set<item_id>   _inventory_to_readvertise; /// items some peers' full inventory queues couldn't take, retried with the next new inventory
+      bool                          _new_inventory_contains_block; /// advertise _new_inventory without waiting for the interval to end
+      bool                          _collecting_new_inventory; /// the loop waits for the interval to end, not for the first new item
+      uint32_t                      _inventory_advertisement_interval_ms;
+      uint32_t                      _inventory_advertisement_batch_size;
+      // @}
+
+      /// blocks and transactions received during normal operation, on their way to the delegate.
+      /// The read loops of the connections only queue them, process_delegate_handoff_queue_loop
+      /// hands them to the delegate, so a delegate busy with a long block doesn't stop us from
+      /// reading keepalives and inventory from our peers.  Blocks have their own queue and are
+      /// handed over before the transactions and other messages, each queue in order
+      // @{
+      struct delegate_handoff_item
+      {
+        peer_connection_ptr originating_peer;
+        message             message_to_process; // not set for blocks
+        message_hash_type   message_hash;
+        fc::time_point      message_receive_time;
+        fc::optional<graphene::net::block_message> block;
+      };
+      std::deque<delegate_handoff_item> _delegate_handoff_queue;
+      std::deque<delegate_handoff_item> _delegate_handoff_block_queue;
+      uint64_t                  _delegate_handoff_dropped_messages;
+      fc::promise<void>::ptr    _retrigger_delegate_handoff_loop_promise;
+      fc::future<void>          _delegate_handoff_loop_done;
       // @}
 
       fc::future<void>     _terminate_inactive_connections_loop_done;
@@ -561,6 +787,9 @@ namespace graphene { namespace net { namespace detail {
       boost::circular_buffer<uint32_t> _average_network_write_speed_minutes;
       boost::circular_buffer<uint32_t> _average_network_read_speed_hours;
       boost::circular_buffer<uint32_t> _average_network_write_speed_hours;
+      boost::circular_buffer<uint32_t> _average_compression_savings_seconds; /// bytes compression saved us, sent and received
+      boost::circular_buffer<uint32_t> _average_compression_savings_minutes;
+      boost::circular_buffer<uint32_t> _average_compression_savings_hours;
       unsigned _average_network_usage_second_counter;
       unsigned _average_network_usage_minute_counter;
 
@@ -607,6 +836,9 @@ namespace graphene { namespace net { namespace detail {
       bool have_already_received_sync_item( const item_hash_t& item_hash );
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
+      size_t get_sync_chunk_size( const peer_connection_ptr& peer, size_t maximum_items_to_request ) const;
+      void record_sync_batch_finished( peer_connection* peer );
+      void cancel_duplicate_sync_requests( peer_connection* receiving_peer, const item_hash_t& block_id );
       void fetch_sync_items_loop();
       void trigger_fetch_sync_items_loop();
 
@@ -615,12 +847,18 @@ namespace graphene { namespace net { namespace detail {
       void trigger_fetch_items_loop();
 
       void advertise_inventory_loop();
+      void wait_for_advertise_inventory_trigger(const fc::microseconds& timeout);
       void trigger_advertise_inventory_loop();
 
+      bool is_delegate_handoff_queue_full() const;
+      void queue_for_delegate(delegate_handoff_item&& item);
+      void process_delegate_handoff_queue_loop();
+      void trigger_delegate_handoff_loop();
+
       void terminate_inactive_connections_loop();
 
       void fetch_updated_peer_lists_loop();
-      void update_bandwidth_data(uint32_t bytes_read_this_second, uint32_t bytes_written_this_second);
+      void update_bandwidth_data(uint32_t bytes_read_this_second, uint32_t bytes_written_this_second, uint32_t bytes_saved_this_second);
       void bandwidth_monitor_loop();
       void dump_node_status_task();
 
@@ -666,6 +904,28 @@ namespace graphene { namespace net { namespace detail {
       void on_fetch_items_message( peer_connection* originating_peer,
                                    const fetch_items_message& fetch_items_message_received );
 
+      void on_fetch_block_range_message( peer_connection* originating_peer,
+                                         const fetch_block_range_message& fetch_block_range_message_received );
+
+      void on_block_range_message( peer_connection* originating_peer,
+                                   const block_range_message& block_range_message_received );
+
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+
+      void on_fetch_compact_block_transactions_message( peer_connection* originating_peer,
+                                                        const fetch_compact_block_transactions_message& fetch_transactions_message_received );
+
+      void on_compact_block_transactions_message( peer_connection* originating_peer,
+                                                  const compact_block_transactions_message& transactions_message_received );
+
+      void send_transaction_batches( peer_connection* originating_peer, const std::vector<item_hash_t>& transaction_ids );
+
+      void on_transaction_batch_message( peer_connection* originating_peer,
+                                         const transaction_batch_message& transaction_batch_message_received );
+
+      void process_rebuilt_compact_block( peer_connection* originating_peer, const item_hash_t& block_message_hash );
+
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
@@ -702,15 +962,20 @@ namespace graphene { namespace net { namespace detail {
       void process_backlog_of_sync_blocks();
       void trigger_process_backlog_of_sync_blocks();
       void process_block_during_sync(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
-      void process_block_during_normal_operation(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
+      void process_block_during_normal_operation(peer_connection* originating_peer, const graphene::net::block_message& block_message,
+                                                 const message_hash_type& message_hash, fc::time_point message_receive_time);
       void process_block_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
 
       void process_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
+      void handle_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash,
+                                   fc::time_point message_receive_time);
+      void handle_transaction_messages(size_t transaction_count);
 
       void start_synchronizing();
       void start_synchronizing_with_peer(const peer_connection_ptr& peer);
 
       void new_peer_just_added(const peer_connection_ptr& peer); /// called after a peer finishes handshaking, kicks off syncing
+      static void save_peer_performance(const peer_connection& peer, potential_peer_record& peer_record);
 
       void close();
 
@@ -770,7 +1035,8 @@ namespace graphene { namespace net { namespace detail {
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
       message                    get_message_for_item(const item_id& item) override;
-      message                    get_message_for_item_optimized(const item_id& item) override;
+      std::shared_ptr<const message> get_message_for_item_optimized(const item_id& item) override;
+      std::shared_ptr<const message> get_shared_compressed_message(const message& message_to_send) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
@@ -819,10 +1085,16 @@ namespace graphene { namespace net { namespace detail {
       _delegate(nullptr),
       _is_firewalled(firewalled_state::unknown),
       _potential_peer_database_updated(false),
+      _connection_candidate_shuffler(std::random_device()()),
       _sync_items_to_fetch_updated(false),
       _suspend_fetching_sync_blocks(false),
       _items_to_fetch_updated(false),
       _items_to_fetch_sequence_counter(0),
+      _delegate_handoff_dropped_messages(0),
+      _new_inventory_contains_block(false),
+      _collecting_new_inventory(false),
+      _inventory_advertisement_interval_ms(GRAPHENE_NET_INVENTORY_ADVERTISEMENT_INTERVAL_MS),
+      _inventory_advertisement_batch_size(GRAPHENE_NET_INVENTORY_ADVERTISEMENT_BATCH_SIZE),
       _recent_block_interval_in_seconds(GRAPHENE_MAX_BLOCK_INTERVAL),
       _user_agent_string(user_agent),
       _auth_file(auth_file),
@@ -844,6 +1116,9 @@ namespace graphene { namespace net { namespace detail {
       _average_network_write_speed_minutes(60),
       _average_network_read_speed_hours(72),
       _average_network_write_speed_hours(72),
+      _average_compression_savings_seconds(60),
+      _average_compression_savings_minutes(60),
+      _average_compression_savings_hours(72),
       _average_network_usage_second_counter(0),
       _average_network_usage_minute_counter(0),
       _node_is_shutting_down(false),
@@ -870,6 +1145,7 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            save_peer_performance(*active_peer, *updated_peer_record);
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -909,6 +1185,12 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    // peers in the same /16 are likely run by the same operator, we spread our connections over the groups
+    static uint32_t get_address_group(const fc::ip::address& address)
+    {
+      return (uint32_t)address >> 16;
+    }
+
     void node_impl::p2p_network_connect_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -945,9 +1227,8 @@ namespace graphene { namespace net { namespace detail {
             bool initiated_connection_this_pass = false;
             _potential_peer_database_updated = false;
 
-            for (peer_database::iterator iter = _potential_peer_db.begin();
-                 iter != _potential_peer_db.end() && is_wanting_new_connections();
-                 ++iter)
+            std::vector<potential_peer_record> connection_candidates;
+            for (peer_database::iterator iter = _potential_peer_db.begin(); iter != _potential_peer_db.end(); ++iter)
             {
               fc::microseconds delay_until_retry = fc::seconds((iter->number_of_failed_connection_attempts + 1) * _peer_connection_retry_timeout);
 
@@ -956,10 +1237,76 @@ namespace graphene { namespace net { namespace detail {
                     iter->last_connection_disposition != last_connection_rejected &&
                     iter->last_connection_disposition != last_connection_handshaking_failed) ||
                    (fc::time_point::now() - iter->last_connection_attempt_time) > delay_until_retry))
+                connection_candidates.push_back(*iter);
+            }
+
+            // the address groups we're already connected to, and how many of those connections we chose by latency
+            std::unordered_set<fc::ip::endpoint> connected_endpoints;
+            std::unordered_set<uint32_t> connected_address_groups;
+            for (const std::unordered_set<peer_connection_ptr>* connections : { &_active_connections, &_handshaking_connections })
+              for (const peer_connection_ptr& peer : *connections)
               {
-                connect_to_endpoint(iter->endpoint);
-                initiated_connection_this_pass = true;
+                fc::optional<fc::ip::endpoint> endpoint = peer->get_remote_endpoint();
+                if (endpoint)
+                {
+                  connected_endpoints.insert(*endpoint);
+                  connected_address_groups.insert(get_address_group(endpoint->get_address()));
+                }
               }
+            for (auto iter = _connections_chosen_by_latency.begin(); iter != _connections_chosen_by_latency.end();)
+              if (connected_endpoints.find(*iter) == connected_endpoints.end())
+                iter = _connections_chosen_by_latency.erase(iter);
+              else
+                ++iter;
+
+            // random order for the random share, the measured peers that delivered blocks the fastest on
+            // earlier connections first for the rest.  Unmeasured peers are only chosen at random
+            std::shuffle(connection_candidates.begin(), connection_candidates.end(), _connection_candidate_shuffler);
+            std::vector<const potential_peer_record*> candidates_by_latency;
+            for (const potential_peer_record& candidate : connection_candidates)
+              if (candidate.performance.is_measured())
+                candidates_by_latency.push_back(&candidate);
+            std::stable_sort(candidates_by_latency.begin(), candidates_by_latency.end(),
+                             [](const potential_peer_record* a, const potential_peer_record* b) {
+                               return a->performance.get_expected_block_delivery_time_ms() < b->performance.get_expected_block_delivery_time_ms();
+                             });
+            std::vector<const potential_peer_record*> random_candidates;
+            for (const potential_peer_record& candidate : connection_candidates)
+              random_candidates.push_back(&candidate);
+
+            std::unordered_set<fc::ip::endpoint> attempted_endpoints;
+            auto find_candidate = [&](const std::vector<const potential_peer_record*>& candidates, bool require_new_address_group) {
+              for (const potential_peer_record* candidate : candidates)
+                if (attempted_endpoints.find(candidate->endpoint) == attempted_endpoints.end() &&
+                    (!require_new_address_group ||
+                     connected_address_groups.find(get_address_group(candidate->endpoint.get_address())) == connected_address_groups.end()))
+                  return candidate;
+              return (const potential_peer_record*)nullptr;
+            };
+            while (is_wanting_new_connections())
+            {
+              bool choose_by_latency = _connections_chosen_by_latency.size() * 100 <
+                                       (get_number_of_connections() + 1) * GRAPHENE_NET_LATENCY_PREFERRED_CONNECTIONS_PERCENT;
+              const potential_peer_record* chosen_candidate = nullptr;
+              if (choose_by_latency)
+                chosen_candidate = find_candidate(candidates_by_latency, true);
+              if (!chosen_candidate)
+              {
+                choose_by_latency = false;
+                chosen_candidate = find_candidate(random_candidates, true);
+              }
+              // every address group is taken, any peer will do
+              if (!chosen_candidate)
+                chosen_candidate = find_candidate(random_candidates, false);
+              if (!chosen_candidate)
+                break;
+
+              attempted_endpoints.insert(chosen_candidate->endpoint);
+              connected_address_groups.insert(get_address_group(chosen_candidate->endpoint.get_address()));
+              if (choose_by_latency)
+                _connections_chosen_by_latency.insert(chosen_candidate->endpoint);
+              connect_to_endpoint(chosen_candidate->endpoint);
+              initiated_connection_this_pass = true;
             }
 
             if (!initiated_connection_this_pass && !_potential_peer_database_updated)
@@ -993,10 +1340,8 @@ namespace graphene { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
-             std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+      const auto& id_index = _received_sync_items.get<sync_item_block_id_index>();
+      return id_index.find(item_hash) != id_index.end();
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -1015,13 +1360,73 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting ${item_count} item(s) ${items_to_request} from peer ${endpoint}",
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
+      fc::time_point now = fc::time_point::now();
       for (const item_hash_t& item_to_request : items_to_request)
       {
-        _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
+        _active_sync_requests[item_to_request] = now;
         item_id item_id_to_request( graphene::net::block_message_type, item_to_request );
-        peer->sync_items_requested_from_peer.insert( peer_connection::item_to_time_map_type::value_type(item_id_to_request, fc::time_point::now() ) );
+        peer->sync_items_requested_from_peer.insert( peer_connection::item_to_time_map_type::value_type(item_id_to_request, now ) );
       }
-      peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
+      peer->sync_items_request_time = now;
+      peer->sync_items_request_bytes_received = peer->get_total_bytes_received();
+      peer->sync_items_received_in_batch = 0;
+      if (peer->supports_feature(block_range_sync_feature))
+        peer->send_message(fetch_block_range_message(items_to_request, std::min<uint32_t>(_block_size, GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE)));
+      else
+        peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
+    }
+
+    size_t node_impl::get_sync_chunk_size( const peer_connection_ptr& peer, size_t maximum_items_to_request ) const
+    {
+      // until we know how fast the peer is, ask for a regular batch
+      if (peer->sync_blocks_per_second <= 0)
+        return std::min<size_t>(maximum_items_to_request, _maximum_blocks_per_peer_during_syncing);
+
+      // a peer far away needs larger chunks to stay busy during the round trip
+      fc::microseconds chunk_duration = std::max(fc::milliseconds(GRAPHENE_NET_SYNC_CHUNK_DURATION_MS), fc::microseconds(peer->round_trip_delay.count() * 2));
+      size_t chunk_size = (size_t)(peer->sync_blocks_per_second * chunk_duration.count() / 1000000);
+      return std::min<size_t>(maximum_items_to_request, std::max<size_t>(chunk_size, GRAPHENE_NET_MIN_SYNC_CHUNK_SIZE));
+    }
+
+    void node_impl::record_sync_batch_finished( peer_connection* peer )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds elapsed = fc::time_point::now() - peer->sync_items_request_time;
+      if (elapsed.count() <= 0 || peer->sync_items_received_in_batch == 0)
+        return;
+      double blocks_per_second = peer->sync_items_received_in_batch * 1000000.0 / elapsed.count();
+      peer->sync_blocks_per_second = peer->sync_blocks_per_second > 0 ? (3 * peer->sync_blocks_per_second + blocks_per_second) / 4 : blocks_per_second;
+      peer_performance_record sample;
+      sample.download_bytes_per_second = (uint32_t)std::min<uint64_t>(std::numeric_limits<uint32_t>::max(),
+                                                                       (peer->get_total_bytes_received() - peer->sync_items_request_bytes_received) * 1000000 / elapsed.count());
+      peer->performance.update(sample);
+      dlog("peer ${endpoint} delivered ${count} sync blocks in ${elapsed} us, now estimated at ${rate} blocks per second",
+           ("endpoint", peer->get_remote_endpoint())("count", peer->sync_items_received_in_batch)
+           ("elapsed", elapsed.count())("rate", peer->sync_blocks_per_second));
+      peer->sync_items_received_in_batch = 0;
+    }
+
+    void node_impl::cancel_duplicate_sync_requests( peer_connection* receiving_peer, const item_hash_t& block_id )
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id sync_item(graphene::net::block_message_type, block_id);
+      bool peer_became_idle = false;
+      for (const peer_connection_ptr& peer : _active_connections)
+      {
+        auto request_iter = peer->sync_items_requested_from_peer.find(sync_item);
+        if (peer.get() != receiving_peer && request_iter != peer->sync_items_requested_from_peer.end())
+        {
+          peer->sync_items_requested_elsewhere[block_id] = request_iter->second;
+          peer->sync_items_requested_from_peer.erase(request_iter);
+          if (peer->idle())
+          {
+            record_sync_batch_finished(peer.get());
+            peer_became_idle = true;
+          }
+        }
+      }
+      if (peer_became_idle)
+        trigger_fetch_sync_items_loop();
     }
 
     void node_impl::fetch_sync_items_loop()
@@ -1040,33 +1445,74 @@ namespace graphene { namespace net { namespace detail {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
+            // the idle peers we're syncing with, fastest first so they get the blocks we need the soonest.
+            // peers we haven't measured during this sync go last, ordered by their expected block delivery time
+            std::vector<peer_connection_ptr> idle_sync_peers;
             for( const peer_connection_ptr& peer : _active_connections )
+              if( peer->we_need_sync_items_from_peer && !peer->inhibit_fetching_sync_blocks && peer->idle() )
+                idle_sync_peers.push_back(peer);
+            std::stable_sort(idle_sync_peers.begin(), idle_sync_peers.end(),
+                             [](const peer_connection_ptr& a, const peer_connection_ptr& b) {
+                               if (a->sync_blocks_per_second != b->sync_blocks_per_second)
+                                 return a->sync_blocks_per_second > b->sync_blocks_per_second;
+                               return a->performance.get_expected_block_delivery_time_ms() < b->performance.get_expected_block_delivery_time_ms();
+                             });
+
+            fc::time_point stalled_request_threshold = fc::time_point::now() - fc::milliseconds(GRAPHENE_NET_SYNC_STALLED_REQUEST_MS);
+            for( const peer_connection_ptr& peer : idle_sync_peers )
             {
-              if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+              size_t maximum_items_to_request = _maximum_blocks_per_peer_during_syncing;
+              if (peer->supports_feature(block_range_sync_feature))
+              {
+                // block ranges are streamed without waiting for us, so only ask for as many blocks
+                // as our backlog has room for
+                size_t sync_items_in_flight = _received_sync_items.size() + _active_sync_requests.size() + sync_items_to_request.size();
+                maximum_items_to_request = sync_items_in_flight < _maximum_number_of_sync_blocks_to_prefetch ?
+                                           std::min<size_t>(GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST,
+                                                            _maximum_number_of_sync_blocks_to_prefetch - sync_items_in_flight) : 0;
+              }
+              maximum_items_to_request = get_sync_chunk_size(peer, maximum_items_to_request);
+
+              std::vector<item_hash_t> items_to_request;
+              std::vector<item_hash_t> stalled_items;
+              // loop through the items it has that we don't yet have on our blockchain and take the next chunk
+              // nobody has been asked for.  note the stalled requests on the way in case there's nothing left
+              for( unsigned i = 0; i < peer->ids_of_items_to_get.size() && items_to_request.size() < maximum_items_to_request; ++i )
+              {
+                const item_hash_t& item_to_potentially_request = peer->ids_of_items_to_get[i];
+                if( have_already_received_sync_item(item_to_potentially_request) || // already got it, but for some reson it's still in our list of items to fetch
+                    sync_items_to_request.find(item_to_potentially_request) != sync_items_to_request.end() ) // we have already decided to request it from another peer during this iteration
+                  continue;
+
+                auto active_request_iter = _active_sync_requests.find(item_to_potentially_request);
+                if( active_request_iter == _active_sync_requests.end() )
+                {
+                  // then schedule a request from this peer
+                  items_to_request.push_back(item_to_potentially_request);
+                  sync_items_to_request.insert( item_to_potentially_request );
+                }
+                else if( stalled_items.size() < maximum_items_to_request &&
+                         active_request_iter->second < stalled_request_threshold &&
+                         _rerequested_sync_items.find(item_to_potentially_request) == _rerequested_sync_items.end() )
+                  stalled_items.push_back(item_to_potentially_request);
+              }
+
+              if( items_to_request.empty() && !stalled_items.empty() )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                // everything this peer has is requested already, ask it for the oldest stalled requests,
+                // they are the ones holding up the backlog.  whichever copy arrives first is used
+                dlog( "requesting ${count} stalled sync item(s) again from peer ${endpoint}",
+                      ("count", stalled_items.size())("endpoint", peer->get_remote_endpoint()) );
+                for( const item_hash_t& stalled_item : stalled_items )
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
-                  {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
-                  }
+                  _rerequested_sync_items.insert( stalled_item );
+                  sync_items_to_request.insert( stalled_item );
                 }
+                items_to_request = std::move(stalled_items);
               }
+
+              if( !items_to_request.empty() )
+                sync_item_requests_to_send[peer] = std::move(items_to_request);
             }
           } // end non-preemptable section
 
@@ -1082,7 +1528,18 @@ namespace graphene { namespace net { namespace detail {
         {
           dlog( "no sync items to fetch right now, going to sleep" );
           _retrigger_fetch_sync_items_loop_promise = fc::promise<void>::ptr( new fc::promise<void>("graphene::net::retrigger_fetch_sync_items_loop") );
-          _retrigger_fetch_sync_items_loop_promise->wait();
+          try
+          {
+            // while blocks are on their way, wake up now and then to look for stalled requests
+            if( _active_sync_requests.empty() )
+              _retrigger_fetch_sync_items_loop_promise->wait();
+            else
+              _retrigger_fetch_sync_items_loop_promise->wait( fc::milliseconds(GRAPHENE_NET_SYNC_STALLED_REQUEST_MS) );
+          }
+          catch( const fc::timeout_exception& )
+          {
+            dlog( "resuming fetch_sync_items_loop to check for stalled requests" );
+          }
           _retrigger_fetch_sync_items_loop_promise.reset();
         }
       } // while( !canceled )
@@ -1101,7 +1558,7 @@ namespace graphene { namespace net { namespace detail {
     {
       for( const peer_connection_ptr& peer : _active_connections )
       {
-        if (peer->inventory_peer_advertised_to_us.find(item) != peer->inventory_peer_advertised_to_us.end() )
+        if (peer->fetchable_inventory_peer_advertised_to_us.find(item) != peer->fetchable_inventory_peer_advertised_to_us.end() )
           return true;
       }
       return false;
@@ -1129,14 +1586,19 @@ namespace graphene { namespace net { namespace detail {
         {
           peer_connection_ptr peer;
           std::vector<item_id> item_ids;
-          peer_and_items_to_fetch(const peer_connection_ptr& peer) : peer(peer) {}
+          uint32_t expected_block_delivery_time_ms;
+          peer_and_items_to_fetch(const peer_connection_ptr& peer) :
+            peer(peer),
+            expected_block_delivery_time_ms(peer->performance.get_expected_block_delivery_time_ms())
+          {}
           bool operator<(const peer_and_items_to_fetch& rhs) const { return peer < rhs.peer; }
-          size_t number_of_items() const { return item_ids.size(); }
+          // among the peers with the fewest requests, the one we expect to deliver first
+          std::pair<size_t, uint32_t> get_load() const { return std::make_pair(item_ids.size(), expected_block_delivery_time_ms); }
         };
         typedef boost::multi_index_container<peer_and_items_to_fetch,
                                              boost::multi_index::indexed_by<boost::multi_index::ordered_unique<boost::multi_index::member<peer_and_items_to_fetch, peer_connection_ptr, &peer_and_items_to_fetch::peer> >,
                                                                             boost::multi_index::ordered_non_unique<boost::multi_index::tag<requested_item_count_index>,
-                                                                                                                   boost::multi_index::const_mem_fun<peer_and_items_to_fetch, size_t, &peer_and_items_to_fetch::number_of_items> > > > fetch_messages_to_send_set;
+                                                                                                                   boost::multi_index::const_mem_fun<peer_and_items_to_fetch, std::pair<size_t, uint32_t>, &peer_and_items_to_fetch::get_load> > > > fetch_messages_to_send_set;
         fetch_messages_to_send_set items_by_peer;
 
         // initialize the fetch_messages_to_send with an empty set of items for all idle peers
@@ -1155,6 +1617,11 @@ namespace graphene { namespace net { namespace detail {
             elog("Unable to fetch item ${item} before its likely expiration time, removing it from our list of items to fetch", ("item", item_iter->item));
             item_iter = _items_to_fetch.erase(item_iter);
           }
+          else if (item_iter->item.item_type == graphene::net::trx_message_type && is_delegate_handoff_queue_full())
+          {
+            // the delegate is behind, keep the transactions here until it catches up
+            ++item_iter;
+          }
           else
           {
             // find a peer that has it, we'll use the one who has the least requests going to it to load balance
@@ -1164,7 +1631,7 @@ namespace graphene { namespace net { namespace detail {
               const peer_connection_ptr& peer = peer_iter->peer;
               // if they have the item and we haven't already decided to ask them for too many other items
               if (peer_iter->item_ids.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
-                  peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end())
+                  peer->fetchable_inventory_peer_advertised_to_us.find(item_iter->item) != peer->fetchable_inventory_peer_advertised_to_us.end())
               {
                 if (item_iter->item.item_type == graphene::net::trx_message_type && peer->is_transaction_fetching_inhibited())
                   next_peer_unblocked_time = std::min(peer->transaction_fetching_inhibited_until, next_peer_unblocked_time);
@@ -1202,7 +1669,16 @@ namespace graphene { namespace net { namespace detail {
                  ("count", items_by_type.second.size())("type", (uint32_t)items_by_type.first)
                  ("endpoint", peer_and_items.peer->get_remote_endpoint())
                  ("hashes", items_by_type.second));
-            peer_and_items.peer->send_message(fetch_items_message(items_by_type.first,
+            // peers that can send compact blocks get asked for those, we likely have most of the transactions
+            uint32_t item_type_to_request = items_by_type.first;
+            if (item_type_to_request == graphene::net::block_message_type &&
+                peer_and_items.peer->supports_feature(compact_block_relay_feature))
+              item_type_to_request = graphene::net::compact_block_message_type;
+            // and peers that can batch transactions for those
+            else if (item_type_to_request == graphene::net::trx_message_type &&
+                     peer_and_items.peer->supports_feature(transaction_batch_feature))
+              item_type_to_request = graphene::net::transaction_batch_message_type;
+            peer_and_items.peer->send_message(fetch_items_message(item_type_to_request,
                                                                   items_by_type.second));
           }
         }
@@ -1239,15 +1715,39 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       while (!_advertise_inventory_loop_done.canceled())
       {
+        if (_new_inventory.empty())
+        {
+          wait_for_advertise_inventory_trigger(fc::microseconds::maximum());
+          continue;
+        }
+
+        // let more transactions arrive, so each peer gets them in one message instead of one message each
+        if (!_new_inventory_contains_block &&
+            _new_inventory.size() < _inventory_advertisement_batch_size &&
+            _inventory_advertisement_interval_ms)
+        {
+          _collecting_new_inventory = true;
+          wait_for_advertise_inventory_trigger(fc::milliseconds(_inventory_advertisement_interval_ms));
+          _collecting_new_inventory = false;
+          if (_advertise_inventory_loop_done.canceled())
+            break;
+        }
+
         dlog("beginning an iteration of advertise inventory");
         // swap inventory into local variable, clearing the node's copy
         std::unordered_set<item_id> inventory_to_advertise;
         inventory_to_advertise.swap(_new_inventory);
+        _new_inventory_contains_block = false;
+        // only items we can still serve are retried
+        for (const item_id& item_to_readvertise : _inventory_to_readvertise)
+          if (_message_cache.contains(item_to_readvertise.item_hash))
+            inventory_to_advertise.insert(item_to_readvertise);
+        _inventory_to_readvertise.clear();
 
         // process all inventory to advertise and construct the inventory messages we'll send
         // first, then send them all in a batch (to avoid any fiber interruption points while
         // we're computing the messages)
-        std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
+        std::list<std::pair<peer_connection_ptr, message> > inventory_messages_to_send;
 
         for (const peer_connection_ptr& peer : _active_connections)
         {
@@ -1256,26 +1756,42 @@ namespace graphene { namespace net { namespace detail {
           {
             std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
             // don't send the peer anything we've already advertised to it
-            // or anything it has advertised to us
+            // or anything it has advertised to us (a false positive of the filters only costs the
+            // peer one advertisement, it will hear about the item from its other peers)
             // group the items we need to send by type, because we'll need to send one inventory message per type
             unsigned total_items_to_send_to_this_peer = 0;
             for (const item_id& item_to_advertise : inventory_to_advertise)
+              if (!peer->inventory_advertised_to_peer.contains(item_to_advertise) &&
+                  !peer->inventory_peer_advertised_to_us.contains(item_to_advertise))
+                items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
+
+            // the items are only marked as advertised once their message fits into the peer's inventory
+            // queue, a message dropped there would keep them from ever being advertised to the peer
+            size_t inventory_bytes_to_queue = 0;
+            for (const auto& items_group : items_to_advertise_by_type)
             {
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) == peer->inventory_advertised_to_peer.end() &&
-                  peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
+              message inventory_message(item_ids_inventory_message(items_group.first, items_group.second));
+              if (!peer->can_queue_message(item_ids_inventory_message_type, inventory_bytes_to_queue + inventory_message.data.size()))
               {
-                items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
+                dlog("inventory send queue for peer ${endpoint} is full, advertising ${count} item(s) later",
+                     ("endpoint", peer->get_remote_endpoint())("count", items_group.second.size()));
+                for (const item_hash_t& item_hash : items_group.second)
+                  _inventory_to_readvertise.insert(item_id(items_group.first, item_hash));
+                continue;
+              }
+              inventory_bytes_to_queue += inventory_message.data.size();
+              for (const item_hash_t& item_hash : items_group.second)
+              {
+                peer->inventory_advertised_to_peer.insert(item_id(items_group.first, item_hash));
                 ++total_items_to_send_to_this_peer;
-                dlog("advertising item ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+                dlog("advertising item ${id} to peer ${endpoint}", ("id", item_hash)("endpoint", peer->get_remote_endpoint()));
               }
+              inventory_messages_to_send.push_back(std::make_pair(peer, std::move(inventory_message)));
             }
               dlog("advertising ${count} new item(s) of ${types} type(s) to peer ${endpoint}",
                    ("count", total_items_to_send_to_this_peer)
                    ("types", items_to_advertise_by_type.size())
                    ("endpoint", peer->get_remote_endpoint()));
-            for (auto items_group : items_to_advertise_by_type)
-              inventory_messages_to_send.push_back(std::make_pair(peer, item_ids_inventory_message(items_group.first, items_group.second)));
           }
           peer->clear_old_inventory();
         }
@@ -1283,21 +1799,136 @@ namespace graphene { namespace net { namespace detail {
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
         inventory_messages_to_send.clear();
+      } // while(!canceled)
+    }
 
-        if (_new_inventory.empty())
+    void node_impl::wait_for_advertise_inventory_trigger(const fc::microseconds& timeout)
+    {
+      // trigger_advertise_inventory_loop() clears the member before setting the promise, keep our own reference
+      fc::promise<void>::ptr retrigger_promise(new fc::promise<void>("graphene::net::retrigger_advertise_inventory_loop"));
+      _retrigger_advertise_inventory_loop_promise = retrigger_promise;
+      try
+      {
+        retrigger_promise->wait(timeout);
+      }
+      catch (const fc::timeout_exception&)
+      {
+      }
+      _retrigger_advertise_inventory_loop_promise.reset();
+    }
+
+    void node_impl::trigger_advertise_inventory_loop()
+    {
+      VERIFY_CORRECT_THREAD();
+      // while the loop collects inventory, only wake it for what can't wait for the interval to end
+      if (_retrigger_advertise_inventory_loop_promise &&
+          (!_collecting_new_inventory ||
+           _new_inventory_contains_block ||
+           _new_inventory.size() >= _inventory_advertisement_batch_size ||
+           _advertise_inventory_loop_done.canceled()))
+      {
+        fc::promise<void>::ptr retrigger_promise = _retrigger_advertise_inventory_loop_promise;
+        _retrigger_advertise_inventory_loop_promise.reset();
+        retrigger_promise->set_value();
+      }
+    }
+
+    bool node_impl::is_delegate_handoff_queue_full() const
+    {
+      return _delegate_handoff_queue.size() >= GRAPHENE_NET_MAX_DELEGATE_HANDOFF_QUEUE_SIZE;
+    }
+
+    void node_impl::queue_for_delegate(delegate_handoff_item&& item)
+    {
+      VERIFY_CORRECT_THREAD();
+      // we stop requesting transactions once the queue is full, this only catches the ones that were
+      // already on their way.  Blocks are never dropped
+      if (item.block)
+      {
+        _delegate_handoff_block_queue.push_back(std::move(item));
+        trigger_delegate_handoff_loop();
+        return;
+      }
+      if (_delegate_handoff_queue.size() >= 2 * GRAPHENE_NET_MAX_DELEGATE_HANDOFF_QUEUE_SIZE)
+      {
+        wlog("the delegate is ${count} messages behind, dropping message ${hash} from peer ${endpoint}",
+             ("count", _delegate_handoff_queue.size())("hash", item.message_hash)("endpoint", item.originating_peer->get_remote_endpoint()));
+        ++_delegate_handoff_dropped_messages;
+        return;
+      }
+      _delegate_handoff_queue.push_back(std::move(item));
+      trigger_delegate_handoff_loop();
+    }
+
+    void node_impl::process_delegate_handoff_queue_loop()
+    {
+      VERIFY_CORRECT_THREAD();
+      while (!_delegate_handoff_loop_done.canceled())
+      {
+        while (!_delegate_handoff_block_queue.empty() || !_delegate_handoff_queue.empty())
         {
-          _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_advertise_inventory_loop"));
-          _retrigger_advertise_inventory_loop_promise->wait();
-          _retrigger_advertise_inventory_loop_promise.reset();
+          // a block doesn't wait behind the transactions that arrived before it
+          std::deque<delegate_handoff_item>& queue = _delegate_handoff_block_queue.empty() ? _delegate_handoff_queue
+                                                                                           : _delegate_handoff_block_queue;
+          // the item stays at the front while the delegate works on it, items queued meanwhile
+          // are added at the back, which doesn't invalidate references into a deque
+          const delegate_handoff_item& item = queue.front();
+
+          // transactions waiting next to each other go to the delegate together, in one hop to its thread
+          size_t items_processed = 1;
+          if (!item.block && item.message_to_process.msg_type == trx_message_type)
+            while (items_processed < queue.size() &&
+                   items_processed < GRAPHENE_NET_MAX_TRANSACTIONS_PER_DELEGATE_CALL &&
+                   queue[items_processed].message_to_process.msg_type == trx_message_type)
+              ++items_processed;
+
+          fc::time_point processing_start_time = fc::time_point::now();
+          try
+          {
+            if (item.block)
+              process_block_during_normal_operation(item.originating_peer.get(), *item.block, item.message_hash, item.message_receive_time);
+            else if (item.message_to_process.msg_type == trx_message_type)
+              handle_transaction_messages(items_processed);
+            else
+              handle_ordinary_message(item.originating_peer.get(), item.message_to_process, item.message_hash, item.message_receive_time);
+          }
+          catch (const fc::canceled_exception&)
+          {
+            throw;
+          }
+          catch (const fc::exception& e)
+          {
+            elog("Exception while passing message ${hash} from peer ${endpoint} to the delegate: ${e}",
+                 ("hash", item.message_hash)("endpoint", item.originating_peer->get_remote_endpoint())("e", e));
+          }
+
+          // the time the delegate took counts for the peers that sent the items, in equal parts
+          fc::microseconds processing_time_per_item((fc::time_point::now() - processing_start_time).count() / items_processed);
+          for (size_t i = 0; i < items_processed; ++i)
+          {
+            const delegate_handoff_item& processed_item = queue[i];
+            uint32_t message_type = processed_item.block ? (uint32_t)block_message_type : processed_item.message_to_process.msg_type;
+            processed_item.originating_peer->get_traffic_statistics().add_processing_time(message_type, processing_time_per_item);
+          }
+
+          bool queue_was_full = is_delegate_handoff_queue_full();
+          queue.erase(queue.begin(), queue.begin() + items_processed);
+          // the delegate has caught up, request the transactions we held back
+          if (queue_was_full && !is_delegate_handoff_queue_full())
+            trigger_fetch_items_loop();
         }
+
+        _retrigger_delegate_handoff_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_delegate_handoff_loop"));
+        _retrigger_delegate_handoff_loop_promise->wait();
+        _retrigger_delegate_handoff_loop_promise.reset();
       } // while(!canceled)
     }
 
-    void node_impl::trigger_advertise_inventory_loop()
+    void node_impl::trigger_delegate_handoff_loop()
     {
       VERIFY_CORRECT_THREAD();
-      if( _retrigger_advertise_inventory_loop_promise )
-        _retrigger_advertise_inventory_loop_promise->set_value();
+      if( _retrigger_delegate_handoff_loop_promise )
+        _retrigger_delegate_handoff_loop_promise->set_value();
     }
 
     void node_impl::terminate_inactive_connections_loop()
@@ -1379,6 +2010,19 @@ namespace graphene { namespace net { namespace detail {
           }
           else
           {
+            // a peer which doesn't send a block we got elsewhere isn't disconnected for it, just stop waiting for it
+            for (auto iter = active_peer->sync_items_requested_elsewhere.begin(); iter != active_peer->sync_items_requested_elsewhere.end();)
+              if (iter->second < active_ignored_request_threshold)
+                iter = active_peer->sync_items_requested_elsewhere.erase(iter);
+              else
+                ++iter;
+            // a compact block whose transactions didn't arrive in time is dropped, the block request itself times out as usual
+            for (auto iter = active_peer->partial_compact_blocks.begin(); iter != active_peer->partial_compact_blocks.end();)
+              if (iter->second.time_received < active_ignored_request_threshold)
+                iter = active_peer->partial_compact_blocks.erase(iter);
+              else
+                ++iter;
+
             bool disconnect_due_to_request_timeout = false;
             for (const peer_connection::item_to_time_map_type::value_type& item_and_time : active_peer->sync_items_requested_from_peer)
               if (item_and_time.second < active_ignored_request_threshold)
@@ -1490,6 +2134,9 @@ namespace graphene { namespace net { namespace detail {
                            offsetof(current_time_request_message, request_sent_time));
       peers_to_send_keep_alive.clear();
 
+      // the journal entries written since the last flush reach the disk within one pass
+      _potential_peer_db.flush();
+
       if (!_node_is_shutting_down && !_terminate_inactive_connections_loop_done.canceled())
          _terminate_inactive_connections_loop_done = fc::schedule( [this](){ terminate_inactive_connections_loop(); },
                                                                    fc::time_point::now() + fc::seconds(GRAPHENE_NET_PEER_HANDSHAKE_INACTIVITY_TIMEOUT / 2),
@@ -1530,11 +2177,12 @@ namespace graphene { namespace net { namespace detail {
                                                              fc::time_point::now() + fc::minutes(15),
                                                              "fetch_updated_peer_lists_loop" );
     }
-    void node_impl::update_bandwidth_data(uint32_t bytes_read_this_second, uint32_t bytes_written_this_second)
+    void node_impl::update_bandwidth_data(uint32_t bytes_read_this_second, uint32_t bytes_written_this_second, uint32_t bytes_saved_this_second)
     {
       VERIFY_CORRECT_THREAD();
       _average_network_read_speed_seconds.push_back(bytes_read_this_second);
       _average_network_write_speed_seconds.push_back(bytes_written_this_second);
+      _average_compression_savings_seconds.push_back(bytes_saved_this_second);
       ++_average_network_usage_second_counter;
       if (_average_network_usage_second_counter >= 60)
       {
@@ -1544,6 +2192,8 @@ namespace graphene { namespace net { namespace detail {
         _average_network_read_speed_minutes.push_back(average_read_this_minute);
         uint32_t average_written_this_minute = (uint32_t)boost::accumulate(_average_network_write_speed_seconds, uint64_t(0)) / (uint32_t)_average_network_write_speed_seconds.size();
         _average_network_write_speed_minutes.push_back(average_written_this_minute);
+        uint32_t average_saved_this_minute = (uint32_t)boost::accumulate(_average_compression_savings_seconds, uint64_t(0)) / (uint32_t)_average_compression_savings_seconds.size();
+        _average_compression_savings_minutes.push_back(average_saved_this_minute);
         if (_average_network_usage_minute_counter >= 60)
         {
           _average_network_usage_minute_counter = 0;
@@ -1551,6 +2201,8 @@ namespace graphene { namespace net { namespace detail {
           _average_network_read_speed_hours.push_back(average_read_this_hour);
           uint32_t average_written_this_hour = (uint32_t)boost::accumulate(_average_network_write_speed_minutes, uint64_t(0)) / (uint32_t)_average_network_write_speed_minutes.size();
           _average_network_write_speed_hours.push_back(average_written_this_hour);
+          uint32_t average_saved_this_hour = (uint32_t)boost::accumulate(_average_compression_savings_minutes, uint64_t(0)) / (uint32_t)_average_compression_savings_minutes.size();
+          _average_compression_savings_hours.push_back(average_saved_this_hour);
         }
       }
     }
@@ -1566,9 +2218,32 @@ namespace graphene { namespace net { namespace detail {
       seconds_since_last_update = std::max(UINT32_C(1), seconds_since_last_update);
       uint32_t bytes_read_this_second = _rate_limiter.get_actual_download_rate();
       uint32_t bytes_written_this_second = _rate_limiter.get_actual_upload_rate();
+
+      // collect what compression saved and the traffic since the last update, what peers closed in the meantime did is lost
+      uint64_t bytes_saved_since_last_update = 0;
+      for (const std::unordered_set<peer_connection_ptr>* connections : { &_active_connections, &_handshaking_connections, &_closing_connections })
+        for (const peer_connection_ptr& peer : *connections)
+        {
+          uint64_t bytes_saved = peer->get_total_bytes_saved_by_compression();
+          bytes_saved_since_last_update += bytes_saved - peer->bytes_saved_by_compression_reported;
+          peer->bytes_saved_by_compression_reported = bytes_saved;
+
+          message_type_traffic total_traffic;
+          for (const auto& type_and_traffic : peer->get_traffic_statistics().get_total_traffic())
+            total_traffic.add(type_and_traffic.second);
+          MONITORING_COUNTER_VALUE(p2p_messages_received) += total_traffic.messages_received - peer->traffic_reported.messages_received;
+          MONITORING_COUNTER_VALUE(p2p_bytes_received) += total_traffic.bytes_received - peer->traffic_reported.bytes_received;
+          MONITORING_COUNTER_VALUE(p2p_messages_sent) += total_traffic.messages_sent - peer->traffic_reported.messages_sent;
+          MONITORING_COUNTER_VALUE(p2p_bytes_sent) += total_traffic.bytes_sent - peer->traffic_reported.bytes_sent;
+          MONITORING_COUNTER_VALUE(p2p_queueing_delay_us) += total_traffic.queueing_delay_us - peer->traffic_reported.queueing_delay_us;
+          MONITORING_COUNTER_VALUE(p2p_processing_time_us) += total_traffic.processing_time_us - peer->traffic_reported.processing_time_us;
+          peer->traffic_reported = total_traffic;
+        }
+      uint32_t bytes_saved_this_second = (uint32_t)(bytes_saved_since_last_update / seconds_since_last_update);
+
       for (uint32_t i = 0; i < seconds_since_last_update - 1; ++i)
-        update_bandwidth_data(0, 0);
-      update_bandwidth_data(bytes_read_this_second, bytes_written_this_second);
+        update_bandwidth_data(0, 0, bytes_saved_this_second);
+      update_bandwidth_data(bytes_read_this_second, bytes_written_this_second, bytes_saved_this_second);
       _bandwidth_monitor_last_update_time = current_time;
 
       if (!_node_is_shutting_down && !_bandwidth_monitor_loop_done.canceled())
@@ -1809,6 +2484,24 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::fetch_block_range_message_type:
+        on_fetch_block_range_message(originating_peer, received_message.as<fetch_block_range_message>());
+        break;
+      case core_message_type_enum::block_range_message_type:
+        on_block_range_message(originating_peer, received_message.as<block_range_message>());
+        break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_compact_block_transactions_message_type:
+        on_fetch_compact_block_transactions_message(originating_peer, received_message.as<fetch_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(originating_peer, received_message.as<compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::transaction_batch_message_type:
+        on_transaction_batch_message(originating_peer, received_message.as<transaction_batch_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1849,6 +2542,9 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["supported_features"] = uint32_t(block_range_sync_feature | compressed_messages_feature | compact_block_relay_feature |
+                                                 transaction_batch_feature | authenticated_encryption_feature);
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1863,6 +2559,11 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
+      if (user_data.contains("supported_features"))
+        originating_peer->supported_features = user_data["supported_features"].as<uint32_t>();
+      originating_peer->set_compression_enabled(originating_peer->supports_feature(compressed_messages_feature));
+      if (originating_peer->supports_feature(authenticated_encryption_feature))
+        originating_peer->enable_authenticated_encryption();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2140,6 +2841,7 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            save_peer_performance(*active_peer, *updated_peer_record);
             _potential_peer_db.update_entry(*updated_peer_record);
           }
 
@@ -2666,12 +3368,9 @@ namespace graphene { namespace net { namespace detail {
 
     message node_impl::get_message_for_item(const item_id& item)
     {
-      try
-      {
-        return _message_cache.get_message(item.item_hash);
-      }
-      catch (fc::key_not_found_exception&)
-      {}
+      std::shared_ptr<const message> message_from_cache = _message_cache.get_message(item.item_hash);
+      if (message_from_cache)
+        return *message_from_cache;
       try
       {
         return _delegate->get_item(item);
@@ -2681,21 +3380,27 @@ namespace graphene { namespace net { namespace detail {
       return item_not_available_message(item);
     }
 
-    message node_impl::get_message_for_item_optimized(const item_id& item)
+    std::shared_ptr<const message> node_impl::get_shared_compressed_message(const message& message_to_send)
     {
-       message* msg_ptr = (message*)_message_cache.get_message_ptr(item.item_hash);
-       if (msg_ptr) {
-          return *msg_ptr;
-       }
+      VERIFY_CORRECT_THREAD();
+      return _message_cache.get_compressed_message(message_to_send);
+    }
+
+    std::shared_ptr<const message> node_impl::get_message_for_item_optimized(const item_id& item)
+    {
+       // shares the buffer of the cached message instead of copying it
+       std::shared_ptr<const message> message_from_cache = _message_cache.get_message(item.item_hash);
+       if (message_from_cache)
+          return message_from_cache;
 
        try
        {
-         return _delegate->get_item(item);
+         return std::make_shared<const message>(_delegate->get_item(item));
        }
        catch (fc::key_not_found_exception&)
        {
        }
-       return item_not_available_message(item);
+       return std::make_shared<const message>(item_not_available_message(item));
     }
 
     void node_impl::on_fetch_items_message(peer_connection* originating_peer, const fetch_items_message& fetch_items_message_received)
@@ -2706,41 +3411,55 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      if (fetch_items_message_received.item_type == transaction_batch_message_type)
+      {
+        send_transaction_batches(originating_peer, fetch_items_message_received.items_to_fetch);
+        return;
+      }
+
+      std::shared_ptr<const message> last_block_message_sent;
 
-      std::list<message> reply_messages;
+      // compact blocks are requested with their own item type, but looked up like full blocks
+      const bool send_compact_blocks = fetch_items_message_received.item_type == compact_block_message_type;
+      const uint32_t item_type = send_compact_blocks ? (uint32_t)block_message_type : fetch_items_message_received.item_type;
+
+      // the replies share the buffers of the cached messages
+      std::list<std::shared_ptr<const message> > reply_messages;
+      auto add_reply = [&](const item_hash_t& item_hash, const std::shared_ptr<const message>& requested_message) {
+        if (item_type == block_message_type)
+          last_block_message_sent = requested_message;
+        if (send_compact_blocks)
+          reply_messages.push_back(std::make_shared<const message>(compact_block_message(item_hash, requested_message->as<graphene::net::block_message>())));
+        else
+          reply_messages.push_back(requested_message);
+      };
 
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
-        const message* requested_message_from_cache = _message_cache.get_message_ptr(item_hash);
+        std::shared_ptr<const message> requested_message_from_cache = _message_cache.get_message(item_hash);
         if (requested_message_from_cache) {
            dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
              ("endpoint", originating_peer->get_remote_endpoint())
-             ("id", requested_message_from_cache->id()));
+             ("id", item_hash));
 
-          reply_messages.push_back(*requested_message_from_cache);
-          if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = *requested_message_from_cache;
+          add_reply(item_hash, requested_message_from_cache);
           continue;
         }
 
-        item_id item_to_fetch(fetch_items_message_received.item_type, item_hash);
+        item_id item_to_fetch(item_type, item_hash);
         try
         {
-          message requested_message = _delegate->get_item(item_to_fetch);
+          std::shared_ptr<const message> requested_message = std::make_shared<const message>(_delegate->get_item(item_to_fetch));
           dlog("received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ("id", requested_message.id())
-               ("size", requested_message.size)
+               ("id", requested_message->id())
+               ("size", requested_message->size)
                ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
-          if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
-
+          add_reply(item_hash, requested_message);
           continue;
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(std::make_shared<const message>(item_not_available_message(item_to_fetch)));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2754,15 +3473,295 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const std::shared_ptr<const message>& reply : reply_messages)
       {
-        if (reply.msg_type == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply->msg_type == block_message_type)
+          originating_peer->send_item(item_id(block_message_type, reply->as<graphene::net::block_message>().block_id));
         else
           originating_peer->send_message(reply);
       }
     }
 
+    void node_impl::send_transaction_batches(peer_connection* originating_peer, const std::vector<item_hash_t>& transaction_ids)
+    {
+      VERIFY_CORRECT_THREAD();
+      // the varint length prefix of the batch's message vector
+      const size_t batch_overhead = 5;
+
+      std::vector<std::shared_ptr<const message>> batch;
+      size_t batch_size = batch_overhead;
+      auto send_batch = [&]() {
+        if (batch.empty())
+          return;
+        originating_peer->send_message(std::make_shared<message>(pack_message_vector<transaction_batch_message>(batch)));
+        batch.clear();
+        batch_size = batch_overhead;
+      };
+
+      for (const item_hash_t& transaction_id : transaction_ids)
+      {
+        item_id transaction_to_send(trx_message_type, transaction_id);
+        std::shared_ptr<const message> reply = get_message_for_item_optimized(transaction_to_send);
+        if (reply->msg_type != trx_message_type)
+        {
+          dlog("received transaction request from peer ${endpoint} but we don't have it",
+               ("endpoint", originating_peer->get_remote_endpoint()));
+          originating_peer->send_message(reply);
+          continue;
+        }
+
+        size_t reply_size = fc::raw::pack_size(*reply);
+        if (batch_overhead + reply_size > GRAPHENE_NET_MAX_TRANSACTION_BATCH_SIZE)
+        {
+          // the transaction doesn't fit into a batch on its own, send it the old way
+          send_batch();
+          originating_peer->send_message(reply);
+          continue;
+        }
+
+        if (batch_size + reply_size > GRAPHENE_NET_MAX_TRANSACTION_BATCH_SIZE)
+          send_batch();
+        batch.push_back(std::move(reply));
+        batch_size += reply_size;
+      }
+      send_batch();
+    }
+
+    void node_impl::on_fetch_block_range_message(peer_connection* originating_peer, const fetch_block_range_message& fetch_block_range_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received block range request for ${count} block(s) starting with ${first} from peer ${endpoint}",
+           ("count", fetch_block_range_message_received.block_ids.size())
+           ("first", fetch_block_range_message_received.block_ids.empty() ? item_hash_t() : fetch_block_range_message_received.block_ids.front())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      fc::optional<block_range_reply> reply;
+      try
+      {
+        reply = block_range_reply(fetch_block_range_message_received, _block_size);
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("peer ${endpoint} requested too many blocks, disconnecting from peer: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())("e", e.to_string()));
+        disconnect_from_peer(originating_peer, "You requested more blocks than I serve at a time", true, e);
+        return;
+      }
+
+      // every block is loaded once, the frames keep the loaded messages until they are sent
+      fc::optional<item_hash_t> last_block_sent;
+      for (const item_hash_t& block_id : fetch_block_range_message_received.block_ids)
+      {
+        std::shared_ptr<const message> block_reply = get_message_for_item_optimized(item_id(block_message_type, block_id));
+        if (block_reply->msg_type == block_message_type)
+          last_block_sent = block_id;
+        reply->add(std::move(block_reply));
+      }
+      originating_peer->send_block_range_reply(reply->finish());
+
+      // if we sent them a block, update our record of the last block they've seen accordingly
+      if (last_block_sent)
+      {
+        originating_peer->last_block_delegate_has_seen = *last_block_sent;
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(*last_block_sent);
+      }
+    }
+
+    void node_impl::on_block_range_message(peer_connection* originating_peer, const block_range_message& block_range_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received a block range frame with ${count} item(s) from peer ${endpoint}",
+           ("count", block_range_message_received.messages.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      for (const message& contained_message : block_range_message_received.messages)
+      {
+        if (contained_message.msg_type == block_message_type)
+          process_block_message(originating_peer, contained_message, contained_message.id());
+        else if (contained_message.msg_type == item_not_available_message_type)
+          on_item_not_available_message(originating_peer, contained_message.as<item_not_available_message>());
+        else
+        {
+          wlog("received a block range frame containing a message of type ${type} from peer ${endpoint}, disconnecting from peer",
+               ("type", contained_message.msg_type)("endpoint", originating_peer->get_remote_endpoint()));
+          fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a block range containing a message of type ${type}",
+                                                      ("type", contained_message.msg_type)));
+          disconnect_from_peer(originating_peer, "You sent me an invalid block range", true, detailed_error);
+        }
+
+        // stop processing the frame if one of its items made us disconnect
+        if (originating_peer->we_have_requested_close ||
+            originating_peer->negotiation_status == peer_connection::connection_negotiation_status::closing)
+          return;
+      }
+
+      // the peer is still streaming the range, so the remaining blocks haven't been ignored
+      fc::time_point now = fc::time_point::now();
+      for (auto& item_and_time : originating_peer->sync_items_requested_from_peer)
+        item_and_time.second = now;
+    }
+
+    void node_impl::on_compact_block_message(peer_connection* originating_peer, const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = compact_block_message_received.block_message_hash;
+      if (originating_peer->items_requested_from_peer.find(item_id(block_message_type, block_message_hash)) == originating_peer->items_requested_from_peer.end() ||
+          originating_peer->partial_compact_blocks.find(block_message_hash) != originating_peer->partial_compact_blocks.end())
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      // rebuild the block from the transactions we've relayed recently, the operation results come with the compact block
+      peer_connection::partial_compact_block partial_block;
+      partial_block.time_received = fc::time_point::now();
+      static_cast<graphene::chain::signed_block_header&>(partial_block.block) = compact_block_message_received.header;
+      partial_block.block.transactions.reserve(compact_block_message_received.transactions.size());
+      for (uint32_t i = 0; i < compact_block_message_received.transactions.size(); ++i)
+      {
+        const compact_block_transaction& compact_transaction = compact_block_message_received.transactions[i];
+        const message* cached_transaction = _message_cache.get_transaction_message_by_short_id(compact_block_message_received.block_id,
+                                                                                               compact_transaction.short_id);
+        if (cached_transaction)
+          partial_block.block.transactions.emplace_back(cached_transaction->as<trx_message>().trx);
+        else
+        {
+          partial_block.block.transactions.emplace_back();
+          partial_block.missing_transaction_indexes.push_back(i);
+        }
+        partial_block.block.transactions.back().operation_results = compact_transaction.operation_results;
+      }
+
+      dlog("received compact block ${block_id} with ${count} transaction(s) from peer ${endpoint}, ${missing} of them missing",
+           ("block_id", compact_block_message_received.block_id)
+           ("count", partial_block.block.transactions.size())
+           ("missing", partial_block.missing_transaction_indexes.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      std::vector<uint32_t> missing_transaction_indexes = partial_block.missing_transaction_indexes;
+      originating_peer->partial_compact_blocks[block_message_hash] = std::move(partial_block);
+      if (missing_transaction_indexes.empty())
+        process_rebuilt_compact_block(originating_peer, block_message_hash);
+      else
+        originating_peer->send_message(fetch_compact_block_transactions_message(block_message_hash, std::move(missing_transaction_indexes)));
+    }
+
+    void node_impl::on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                                const fetch_compact_block_transactions_message& fetch_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id block_item(block_message_type, fetch_transactions_message_received.block_message_hash);
+      graphene::net::block_message full_block;
+      try
+      {
+        std::shared_ptr<const message> block_message_from_cache = _message_cache.get_message(block_item.item_hash);
+        full_block = block_message_from_cache ? block_message_from_cache->as<graphene::net::block_message>()
+                                              : _delegate->get_item(block_item).as<graphene::net::block_message>();
+      }
+      catch (fc::key_not_found_exception&)
+      {
+        dlog("peer ${endpoint} requested transactions of compact block ${hash} which we no longer have",
+             ("endpoint", originating_peer->get_remote_endpoint())("hash", block_item.item_hash));
+        originating_peer->send_message(item_not_available_message(block_item));
+        return;
+      }
+
+      std::vector<signed_transaction> transactions;
+      transactions.reserve(fetch_transactions_message_received.transaction_indexes.size());
+      for (uint32_t index : fetch_transactions_message_received.transaction_indexes)
+      {
+        if (index >= full_block.block.transactions.size())
+        {
+          fc::exception detailed_error(FC_LOG_MESSAGE(error, "You requested transaction ${index} of block ${block_id} with ${count} transactions",
+                                                      ("index", index)("block_id", full_block.block_id)("count", full_block.block.transactions.size())));
+          disconnect_from_peer(originating_peer, "You requested a transaction outside of the compact block", true, detailed_error);
+          return;
+        }
+        transactions.push_back(full_block.block.transactions[index]);
+      }
+      originating_peer->send_message(compact_block_transactions_message(block_item.item_hash, std::move(transactions)));
+    }
+
+    void node_impl::on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                          const compact_block_transactions_message& transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto partial_iter = originating_peer->partial_compact_blocks.find(transactions_message_received.block_message_hash);
+      if (partial_iter == originating_peer->partial_compact_blocks.end())
+      {
+        dlog("ignoring transactions of compact block ${hash} from peer ${endpoint}, we're not rebuilding it",
+             ("hash", transactions_message_received.block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+
+      peer_connection::partial_compact_block& partial_block = partial_iter->second;
+      if (transactions_message_received.transactions.size() != partial_block.missing_transaction_indexes.size())
+      {
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me ${count} transactions of a compact block when I asked for ${requested}",
+                                                    ("count", transactions_message_received.transactions.size())
+                                                    ("requested", partial_block.missing_transaction_indexes.size())));
+        disconnect_from_peer(originating_peer, "You sent me the wrong number of compact block transactions", true, detailed_error);
+        return;
+      }
+
+      for (size_t i = 0; i < partial_block.missing_transaction_indexes.size(); ++i)
+      {
+        graphene::chain::processed_transaction& transaction = partial_block.block.transactions[partial_block.missing_transaction_indexes[i]];
+        static_cast<signed_transaction&>(transaction) = transactions_message_received.transactions[i];
+      }
+      partial_block.missing_transaction_indexes.clear();
+      process_rebuilt_compact_block(originating_peer, transactions_message_received.block_message_hash);
+    }
+
+    void node_impl::on_transaction_batch_message(peer_connection* originating_peer,
+                                                 const transaction_batch_message& transaction_batch_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received a batch of ${count} transaction(s) from peer ${endpoint}",
+           ("count", transaction_batch_message_received.transactions.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      for (const message& contained_message : transaction_batch_message_received.transactions)
+      {
+        if (contained_message.msg_type != trx_message_type)
+        {
+          wlog("received a transaction batch containing a message of type ${type} from peer ${endpoint}, disconnecting from peer",
+               ("type", contained_message.msg_type)("endpoint", originating_peer->get_remote_endpoint()));
+          fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a transaction batch containing a message of type ${type}",
+                                                      ("type", contained_message.msg_type)));
+          disconnect_from_peer(originating_peer, "You sent me an invalid transaction batch", true, detailed_error);
+          return;
+        }
+        // each transaction is handled as if it had arrived on its own
+        process_ordinary_message(originating_peer, contained_message, contained_message.id());
+        if (originating_peer->we_have_requested_close)
+          return;
+      }
+    }
+
+    void node_impl::process_rebuilt_compact_block(peer_connection* originating_peer, const item_hash_t& block_message_hash)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto partial_iter = originating_peer->partial_compact_blocks.find(block_message_hash);
+      message rebuilt_message(graphene::net::block_message(partial_iter->second.block));
+      originating_peer->partial_compact_blocks.erase(partial_iter);
+
+      // the hash covers the whole block, a short id that matched the wrong transaction can't slip through
+      if (rebuilt_message.id() != block_message_hash)
+      {
+        wlog("rebuilt compact block ${hash} from peer ${endpoint} doesn't match its hash, fetching the full block",
+             ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+        originating_peer->send_message(fetch_items_message(block_message_type, std::vector<item_hash_t>{block_message_hash}));
+        return;
+      }
+      process_block_message(originating_peer, rebuilt_message, block_message_hash);
+    }
+
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
     {
       VERIFY_CORRECT_THREAD();
@@ -2771,7 +3770,8 @@ namespace graphene { namespace net { namespace detail {
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
-        originating_peer->inventory_peer_advertised_to_us.erase( requested_item );
+        originating_peer->partial_compact_blocks.erase( requested_item.item_hash );
+        originating_peer->fetchable_inventory_peer_advertised_to_us.erase( requested_item );
         if (is_item_in_any_peers_inventory(requested_item))
           _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_sequence_counter++));
         wlog("Peer doesn't have the requested item.");
@@ -2795,6 +3795,10 @@ namespace graphene { namespace net { namespace detail {
         return;
       }
 
+      // the block was received from another peer, there is nothing more to wait for
+      if (originating_peer->sync_items_requested_elsewhere.erase(requested_item.item_hash))
+        return;
+
       dlog("Peer doesn't have an item we're looking for, which is fine because we weren't looking for it");
     }
 
@@ -2810,11 +3814,14 @@ namespace graphene { namespace net { namespace detail {
       for( const item_hash_t& item_hash : item_ids_inventory_message_received.item_hashes_available )
       {
         item_id advertised_item_id(item_ids_inventory_message_received.item_type, item_hash);
+        originating_peer->inventory_peer_advertised_to_us.insert(advertised_item_id);
         bool we_advertised_this_item_to_a_peer = false;
         bool we_requested_this_item_from_a_peer = false;
         for (const peer_connection_ptr peer : _active_connections)
         {
-          if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
+          // the filter can be wrong about items we never advertised, make sure we really have it
+          if (peer->inventory_advertised_to_peer.contains(advertised_item_id) &&
+              _message_cache.contains(item_hash))
           {
             we_advertised_this_item_to_a_peer = true;
             break;
@@ -2835,7 +3842,7 @@ namespace graphene { namespace net { namespace detail {
               elog("List of inventory advertised to us is full.");
               break;
            }
-          originating_peer->inventory_peer_advertised_to_us.insert(peer_connection::timestamped_item_id(advertised_item_id, fc::time_point::now()));
+          originating_peer->fetchable_inventory_peer_advertised_to_us.insert(peer_connection::timestamped_item_id(advertised_item_id, fc::time_point::now()));
           if (!we_requested_this_item_from_a_peer)
           {
             if (_recently_failed_items.find(item_id(item_ids_inventory_message_received.item_type, item_hash)) != _recently_failed_items.end())
@@ -2934,6 +3941,7 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            save_peer_performance(*originating_peer_ptr, *updated_peer_record);
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -2968,12 +3976,28 @@ namespace graphene { namespace net { namespace detail {
         }
       }
 
+      // the blocks we got elsewhere won't arrive from this peer any more
+      originating_peer->sync_items_requested_elsewhere.clear();
+      originating_peer->partial_compact_blocks.clear();
+
       // if we had requested any sync or regular items from this peer that we haven't
       // received yet, reschedule them to be fetched from another peer
       if (!originating_peer->sync_items_requested_from_peer.empty())
       {
         for (auto sync_item_and_time : originating_peer->sync_items_requested_from_peer)
-          _active_sync_requests.erase(sync_item_and_time.first.item_hash);
+        {
+          // a stalled request may also have been sent to another peer, it is still active then
+          bool requested_from_another_peer = false;
+          if (_rerequested_sync_items.erase(sync_item_and_time.first.item_hash))
+            for (const peer_connection_ptr& peer : _active_connections)
+              if (peer.get() != originating_peer && peer->sync_items_requested_from_peer.count(sync_item_and_time.first))
+              {
+                requested_from_another_peer = true;
+                break;
+              }
+          if (!requested_from_another_peer)
+            _active_sync_requests.erase(sync_item_and_time.first.item_hash);
+        }
         trigger_fetch_sync_items_loop();
       }
 
@@ -3202,67 +4226,74 @@ namespace graphene { namespace net { namespace detail {
       //fc::time_point start_time = fc::time_point::now();
       //fc::time_point when_we_should_yield = start_time + fc::seconds(1);
 
-      bool block_processed_this_iteration;
       unsigned blocks_processed = 0;
 
-      std::set<peer_connection_ptr> peers_with_newly_empty_item_lists;
-      std::set<peer_connection_ptr> peers_we_need_to_sync_to;
-      std::map<peer_connection_ptr, fc::optional<fc::exception>> peers_with_rejected_block;
+      // the blocks the peers expect us to process next, each of them is looked up in the backlog once
+      // and the expectations are updated only for the peers whose block was handed over
+      std::unordered_map<item_hash_t, std::vector<peer_connection_ptr>> peers_by_next_expected_block;
+      std::deque<item_hash_t> next_expected_blocks;
+      for (const peer_connection_ptr& peer : _active_connections)
+      {
+        ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+        if (!peer->ids_of_items_to_get.empty())
+        {
+          std::vector<peer_connection_ptr>& peers = peers_by_next_expected_block[peer->ids_of_items_to_get.front()];
+          if (peers.empty())
+            next_expected_blocks.push_back(peer->ids_of_items_to_get.front());
+          peers.push_back(peer);
+        }
+      }
+      dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
 
-      do
+      auto& id_index = _received_sync_items.get<sync_item_block_id_index>();
+      while (!next_expected_blocks.empty())
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
-        dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
+        item_hash_t block_id = next_expected_blocks.front();
+        next_expected_blocks.pop_front();
 
-        block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
-        {
+        auto received_block_iter = id_index.find(block_id);
+        auto expecting_peers_iter = peers_by_next_expected_block.find(block_id);
+        if (received_block_iter == id_index.end() || expecting_peers_iter == peers_by_next_expected_block.end())
+          continue;
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
-          for (const peer_connection_ptr& peer : _active_connections)
+        // this block is the next block on the active chain or one of the forks, remove it from all sync peers lists
+        std::vector<peer_connection_ptr> expecting_peers = std::move(expecting_peers_iter->second);
+        peers_by_next_expected_block.erase(expecting_peers_iter);
+        for (const peer_connection_ptr& peer : expecting_peers)
+        {
+          peer->ids_of_items_to_get.pop_front();
+          peer->ids_of_items_being_processed.insert(block_id);
+          if (!peer->ids_of_items_to_get.empty())
           {
-            ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
-            if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
-            {
-              potential_first_block = true;
-              peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
-            }
+            std::vector<peer_connection_ptr>& peers = peers_by_next_expected_block[peer->ids_of_items_to_get.front()];
+            if (peers.empty())
+              next_expected_blocks.push_back(peer->ids_of_items_to_get.front());
+            peers.push_back(peer);
           }
+        }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
-          {
-            // we can get into an interesting situation near the end of synchronization.  We can be in
-            // sync with one peer who is sending us the last block on the chain via a regular inventory
-            // message, while at the same time still be synchronizing with a peer who is sending us the
-            // block through the sync mechanism.  Further, we must request both blocks because
-            // we don't know they're the same (for the peer in normal operation, it has only told us the
-            // message id, for the peer in the sync case we only known the block_id).
-            if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
-            {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
-              _received_sync_items.erase(received_block_iter);
-              _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
-                send_sync_block_to_node_delegate(block_message_to_process);
-              }, "send_sync_block_to_node_delegate"));
-              ++blocks_processed;
-              block_processed_this_iteration = true;
-            }
-            else
-              dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+        graphene::net::block_message block_message_to_process = received_block_iter->message;
+        fc::time_point received_time = received_block_iter->received_time;
+        id_index.erase(received_block_iter);
 
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+        // we can get into an interesting situation near the end of synchronization.  We can be in
+        // sync with one peer who is sending us the last block on the chain via a regular inventory
+        // message, while at the same time still be synchronizing with a peer who is sending us the
+        // block through the sync mechanism.  Further, we must request both blocks because
+        // we don't know they're the same (for the peer in normal operation, it has only told us the
+        // message id, for the peer in the sync case we only known the block_id).
+        if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
+                      block_id) == _most_recent_blocks_accepted.end())
+        {
+          _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
+            send_sync_block_to_node_delegate(block_message_to_process);
+          }, "send_sync_block_to_node_delegate"));
+          ++blocks_processed;
+          MONITORING_COUNTER_VALUE(sync_blocks_handed_off)++;
+          MONITORING_COUNTER_VALUE(sync_handoff_latency_us) += (fc::time_point::now() - received_time).count();
+        }
+        else
+          dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
 
         if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
         {
@@ -3274,7 +4305,8 @@ namespace graphene { namespace net { namespace detail {
             _suspend_fetching_sync_blocks = true;
           break;
         }
-      } while (block_processed_this_iteration);
+      }
+      MONITORING_COUNTER_VALUE(sync_backlog_size) = _received_sync_items.size();
 
       dlog("leaving process_backlog_of_sync_blocks, ${count} processed", ("count", blocks_processed));
 
@@ -3295,17 +4327,20 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
+      // add it to _received_sync_items, then process _received_sync_items to try to
       // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      _received_sync_items.insert( received_sync_item( block_message_to_process ) );
+      MONITORING_COUNTER_VALUE(sync_backlog_size) = _received_sync_items.size();
+      if (MONITORING_COUNTER_VALUE(sync_backlog_size_max) < MONITORING_COUNTER_VALUE(sync_backlog_size))
+        MONITORING_COUNTER_VALUE(sync_backlog_size_max) = MONITORING_COUNTER_VALUE(sync_backlog_size);
       trigger_process_backlog_of_sync_blocks();
     }
 
     void node_impl::process_block_during_normal_operation( peer_connection* originating_peer,
                                                            const graphene::net::block_message& block_message_to_process,
-                                                           const message_hash_type& message_hash )
+                                                           const message_hash_type& message_hash,
+                                                           fc::time_point message_receive_time )
     {
-      fc::time_point message_receive_time = fc::time_point::now();
 
       dlog( "received a block from peer ${endpoint}, passing it to client", ("endpoint", originating_peer->get_remote_endpoint() ) );
       std::set<peer_connection_ptr> peers_to_disconnect;
@@ -3364,11 +4399,11 @@ namespace graphene { namespace net { namespace detail {
         {
           ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
 
-          auto iter = peer->inventory_peer_advertised_to_us.find(block_message_item_id);
-          if (iter != peer->inventory_peer_advertised_to_us.end())
+          auto iter = peer->fetchable_inventory_peer_advertised_to_us.find(block_message_item_id);
+          if (iter != peer->fetchable_inventory_peer_advertised_to_us.end())
           {
             // this peer offered us the item.  It will eventually expire from the peer's
-            // inventory_peer_advertised_to_us list after some time has passed (currently 2 minutes).
+            // inventory_peer_advertised_to_us filter after some time has passed (currently 2 minutes).
             // For now, it will remain there, which will prevent us from offering the peer this
             // block back when we rebroadcast the block below
             peer->last_block_delegate_has_seen = block_message_to_process.block_id;
@@ -3458,8 +4493,12 @@ namespace graphene { namespace net { namespace detail {
       auto item_iter = originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, message_hash));
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
+        peer_performance_record sample;
+        sample.block_delivery_latency_ms = std::max<uint32_t>(1, (uint32_t)((fc::time_point::now() - item_iter->second).count() / 1000));
+        originating_peer->performance.update(sample);
         originating_peer->items_requested_from_peer.erase(item_iter);
-        process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
+        queue_for_delegate(delegate_handoff_item{originating_peer->shared_from_this(), message(), message_hash,
+                                                 fc::time_point::now(), block_message_to_process});
         if (originating_peer->idle())
           trigger_fetch_items_loop();
         return;
@@ -3473,9 +4512,13 @@ namespace graphene { namespace net { namespace detail {
         {
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
           _active_sync_requests.erase(block_message_to_process.block_id);
+          if (_rerequested_sync_items.erase(block_message_to_process.block_id))
+            cancel_duplicate_sync_requests(originating_peer, block_message_to_process.block_id);
+          ++originating_peer->sync_items_received_in_batch;
           process_block_during_sync(originating_peer, block_message_to_process, message_hash);
           if (originating_peer->idle())
           {
+            record_sync_batch_finished(originating_peer);
             // we have finished fetching a batch of items, so we either need to grab another batch of items
             // or we need to get another list of item ids.
             if (originating_peer->number_of_unfetched_item_ids > 0 &&
@@ -3486,6 +4529,16 @@ namespace graphene { namespace net { namespace detail {
           }
           return;
         }
+
+        // we asked this peer for a stalled sync item, but another peer was faster
+        auto requested_elsewhere_iter = originating_peer->sync_items_requested_elsewhere.find(block_message_to_process.block_id);
+        if (requested_elsewhere_iter != originating_peer->sync_items_requested_elsewhere.end())
+        {
+          dlog("ignoring sync block ${block_id} from peer ${endpoint}, we've already received it from another peer",
+               ("block_id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+          originating_peer->sync_items_requested_elsewhere.erase(requested_elsewhere_iter);
+          return;
+        }
       }
 
       // if we get here, we didn't request the message, we must have a misbehaving peer
@@ -3516,6 +4569,12 @@ namespace graphene { namespace net { namespace detail {
                                                          (current_time_reply_message_received.reply_transmitted_time - reply_received_time)).count() / 2);
       originating_peer->round_trip_delay = (reply_received_time - current_time_reply_message_received.request_sent_time) -
                                            (current_time_reply_message_received.reply_transmitted_time - current_time_reply_message_received.request_received_time);
+      if (originating_peer->round_trip_delay.count() > 0)
+      {
+        peer_performance_record sample;
+        sample.round_trip_delay_ms = std::max<uint32_t>(1, (uint32_t)(originating_peer->round_trip_delay.count() / 1000));
+        originating_peer->performance.update(sample);
+      }
     }
 
     void node_impl::forward_firewall_check_to_next_available_peer(firewall_check_state_data* firewall_check_state)
@@ -3774,36 +4833,104 @@ namespace graphene { namespace net { namespace detail {
         if (originating_peer->idle())
           trigger_fetch_items_loop();
 
-        // Next: have the delegate process the message
-        fc::time_point message_validated_time;
-        try
+        // Next: have the delegate process the message, once it has processed what we queued before
+        queue_for_delegate(delegate_handoff_item{originating_peer->shared_from_this(), message_to_process, message_hash,
+                                                 message_receive_time, fc::optional<graphene::net::block_message>()});
+      }
+    }
+
+    void node_impl::handle_ordinary_message( peer_connection* originating_peer,
+                                             const message& message_to_process, const message_hash_type& message_hash,
+                                             fc::time_point message_receive_time )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point message_validated_time;
+      try
+      {
+        if (message_to_process.msg_type == trx_message_type)
         {
-          if (message_to_process.msg_type == trx_message_type)
-          {
-            trx_message transaction_message_to_process = message_to_process.as<trx_message>();
-            dlog("passing message containing transaction ${trx} to client", ("trx", transaction_message_to_process.trx.id()));
-            _delegate->handle_transaction(transaction_message_to_process);
-            MONITORING_COUNTER_VALUE(transactions_received)++;
-          }
-          else
-            _delegate->handle_message( message_to_process );
-          message_validated_time = fc::time_point::now();
+          trx_message transaction_message_to_process = message_to_process.as<trx_message>();
+          dlog("passing message containing transaction ${trx} to client", ("trx", transaction_message_to_process.trx.id()));
+          _delegate->handle_transaction(transaction_message_to_process);
+          MONITORING_COUNTER_VALUE(transactions_received)++;
         }
-        catch ( const fc::canceled_exception& )
+        else
+          _delegate->handle_message( message_to_process );
+        message_validated_time = fc::time_point::now();
+      }
+      catch ( const fc::canceled_exception& )
+      {
+        throw;
+      }
+      catch ( const fc::exception& e )
+      {
+        wlog( "client rejected message sent by peer ${peer}, ${e}", ("peer", originating_peer->get_remote_endpoint() )("e", e) );
+        // record it so we don't try to fetch this item again
+        _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(message_to_process.msg_type, message_hash ), fc::time_point::now()));
+        return;
+      }
+
+      // finally, if the delegate validated the message, broadcast it to our other peers
+      message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
+      broadcast( message_to_process, propagation_data );
+    }
+
+    // passes the transactions at the front of the delegate handoff queue to the delegate in one call,
+    // then does the same bookkeeping handle_ordinary_message does for each of them
+    void node_impl::handle_transaction_messages( size_t transaction_count )
+    {
+      VERIFY_CORRECT_THREAD();
+      std::vector<fc::optional<fc::exception>> errors(transaction_count);
+      std::vector<trx_message> transactions;
+      std::vector<size_t> transaction_indexes;
+      transactions.reserve(transaction_count);
+      for (size_t i = 0; i < transaction_count; ++i)
+      {
+        try
         {
-          throw;
+          transactions.push_back(_delegate_handoff_queue[i].message_to_process.as<trx_message>());
+          transaction_indexes.push_back(i);
         }
         catch ( const fc::exception& e )
         {
-          wlog( "client rejected message sent by peer ${peer}, ${e}", ("peer", originating_peer->get_remote_endpoint() )("e", e) );
+          errors[i] = e;
+        }
+      }
+
+      dlog("passing ${count} transactions to client", ("count", transactions.size()));
+      try
+      {
+        std::vector<fc::optional<fc::exception>> delegate_errors = _delegate->handle_transactions(transactions);
+        FC_ASSERT(delegate_errors.size() == transactions.size(), "the delegate returned ${results} results for ${count} transactions",
+                  ("results", delegate_errors.size())("count", transactions.size()));
+        for (size_t i = 0; i < transaction_indexes.size(); ++i)
+          errors[transaction_indexes[i]] = std::move(delegate_errors[i]);
+      }
+      catch ( const fc::canceled_exception& )
+      {
+        throw;
+      }
+      catch ( const fc::exception& e )
+      {
+        for (size_t index : transaction_indexes)
+          errors[index] = e;
+      }
+      fc::time_point message_validated_time = fc::time_point::now();
+
+      for (size_t i = 0; i < transaction_count; ++i)
+      {
+        const delegate_handoff_item& item = _delegate_handoff_queue[i];
+        if (errors[i])
+        {
+          wlog( "client rejected message sent by peer ${peer}, ${e}", ("peer", item.originating_peer->get_remote_endpoint() )("e", *errors[i]) );
           // record it so we don't try to fetch this item again
-          _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(message_to_process.msg_type, message_hash ), fc::time_point::now()));
-          return;
+          _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(trx_message_type, item.message_hash), fc::time_point::now()));
+          continue;
         }
 
-        // finally, if the delegate validated the message, broadcast it to our other peers
-        message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
-        broadcast( message_to_process, propagation_data );
+        MONITORING_COUNTER_VALUE(transactions_received)++;
+        message_propagation_data propagation_data{item.message_receive_time, message_validated_time, item.originating_peer->node_id};
+        broadcast( item.message_to_process, propagation_data );
       }
     }
 
@@ -3825,9 +4952,29 @@ namespace graphene { namespace net { namespace detail {
         start_synchronizing_with_peer( peer );
     }
 
+    void node_impl::save_peer_performance( const peer_connection& peer, potential_peer_record& peer_record )
+    {
+      // peer.performance started from the record's values, so it replaces them
+      if (peer.performance.is_measured())
+        peer_record.performance = peer.performance;
+    }
+
     void node_impl::new_peer_just_added( const peer_connection_ptr& peer )
     {
       VERIFY_CORRECT_THREAD();
+      // continue from what we measured on earlier connections to the peer
+      fc::optional<fc::ip::endpoint> endpoint_for_connecting = peer->get_endpoint_for_connecting();
+      if (endpoint_for_connecting)
+      {
+        fc::optional<potential_peer_record> peer_record = _potential_peer_db.lookup_entry_for_endpoint(*endpoint_for_connecting);
+        if (peer_record)
+        {
+          peer_performance_record measured_on_this_connection = peer->performance;
+          peer->performance = peer_record->performance;
+          peer->performance.update(measured_on_this_connection);
+        }
+      }
+
       peer->send_message(current_time_request_message(),
                          offsetof(current_time_request_message, request_sent_time));
       start_synchronizing_with_peer( peer );
@@ -4018,6 +5165,29 @@ namespace graphene { namespace net { namespace detail {
         wlog( "Exception thrown while terminating Advertise inventory loop, ignoring" );
       }
 
+      try
+      {
+        _delegate_handoff_loop_done.cancel("node_impl::close()");
+        // cancel() is currently broken, so we need to wake up the task to allow it to finish
+        trigger_delegate_handoff_loop();
+        _delegate_handoff_loop_done.wait();
+        dlog("Delegate handoff loop terminated");
+      }
+      catch ( const fc::canceled_exception& )
+      {
+        dlog("Delegate handoff loop terminated");
+      }
+      catch ( const fc::exception& e )
+      {
+        wlog( "Exception thrown while terminating Delegate handoff loop, ignoring: ${e}", ("e", e) );
+      }
+      catch (...)
+      {
+        wlog( "Exception thrown while terminating Delegate handoff loop, ignoring" );
+      }
+      _delegate_handoff_queue.clear();
+      _delegate_handoff_block_queue.clear();
+
       // Next, terminate our existing connections.  First, close all of the connections nicely.
       // This will close the sockets and may result in calls to our "on_connection_closing"
       // method to inform us that the connection really closed (or may not if we manage to cancel
@@ -4520,6 +5690,7 @@ namespace graphene { namespace net { namespace detail {
              !_fetch_sync_items_loop_done.valid() &&
              !_fetch_item_loop_done.valid() &&
              !_advertise_inventory_loop_done.valid() &&
+             !_delegate_handoff_loop_done.valid() &&
              !_terminate_inactive_connections_loop_done.valid() &&
              !_fetch_updated_peer_lists_loop_done.valid() &&
              !_bandwidth_monitor_loop_done.valid() &&
@@ -4530,6 +5701,7 @@ namespace graphene { namespace net { namespace detail {
       _fetch_sync_items_loop_done = fc::async( [=]() { fetch_sync_items_loop(); }, "fetch_sync_items_loop" );
       _fetch_item_loop_done = fc::async( [=]() { fetch_items_loop(); }, "fetch_items_loop" );
       _advertise_inventory_loop_done = fc::async( [=]() { advertise_inventory_loop(); }, "advertise_inventory_loop" );
+      _delegate_handoff_loop_done = fc::async( [=]() { process_delegate_handoff_queue_loop(); }, "delegate_handoff_loop" );
       _terminate_inactive_connections_loop_done = fc::async( [=]() { terminate_inactive_connections_loop(); }, "terminate_inactive_connections_loop" );
       _fetch_updated_peer_lists_loop_done = fc::async([=](){ fetch_updated_peer_lists_loop(); }, "fetch_updated_peer_lists_loop");
       _bandwidth_monitor_loop_done = fc::async([=](){ bandwidth_monitor_loop(); }, "bandwidth_monitor_loop");
@@ -4671,6 +5843,8 @@ namespace graphene { namespace net { namespace detail {
           ilog( "              above peer has ${count} sync items we might need", ("count", peer->ids_of_items_to_get.size() ) );
         if (peer->inhibit_fetching_sync_blocks)
           ilog( "              we are not fetching sync blocks from the above peer (inhibit_fetching_sync_blocks == true)" );
+        if (peer->sync_blocks_per_second > 0)
+          ilog( "              above peer delivered sync blocks at ${rate} blocks per second", ("rate", peer->sync_blocks_per_second) );
       }
       for( const peer_connection_ptr& peer : _handshaking_connections )
       {
@@ -4680,17 +5854,29 @@ namespace graphene { namespace net { namespace detail {
 
       ilog( "--------- MEMORY USAGE ------------" );
       ilog( "node._active_sync_requests size: ${size}", ("size", _active_sync_requests.size() ) );
+      ilog( "node._rerequested_sync_items size: ${size}", ("size", _rerequested_sync_items.size() ) );
       ilog( "node._received_sync_items size: ${size}", ("size", _received_sync_items.size() ) );
-      ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
+      if( !_received_sync_items.empty() )
+      {
+        const auto& number_index = _received_sync_items.get<sync_item_block_number_index>();
+        ilog( "node._received_sync_items blocks: ${first} - ${last}",
+              ("first", number_index.begin()->block_number)("last", number_index.rbegin()->block_number) );
+      }
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
-      ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
+      ilog( "node._delegate_handoff_queue size: ${size}", ("size", _delegate_handoff_queue.size() ) );
+      ilog( "node._delegate_handoff_block_queue size: ${size}", ("size", _delegate_handoff_block_queue.size() ) );
+      ilog( "node._message_cache size: ${size} (${bytes} bytes, hit rate ${hit_rate})",
+            ("size", _message_cache.size() )("bytes", _message_cache.size_in_bytes() )("hit_rate", _message_cache.get_hit_rate() ) );
       for( const peer_connection_ptr& peer : _active_connections )
       {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
         ilog( "    peer.ids_of_items_to_get size: ${size}", ("size", peer->ids_of_items_to_get.size() ) );
-        ilog( "    peer.inventory_peer_advertised_to_us size: ${size}", ("size", peer->inventory_peer_advertised_to_us.size() ) );
-        ilog( "    peer.inventory_advertised_to_peer size: ${size}", ("size", peer->inventory_advertised_to_peer.size() ) );
+        ilog( "    peer.inventory_peer_advertised_to_us size: ${size} (${bytes} bytes)",
+              ("size", peer->inventory_peer_advertised_to_us.size() )("bytes", peer->inventory_peer_advertised_to_us.memory_usage() ) );
+        ilog( "    peer.inventory_advertised_to_peer size: ${size} (${bytes} bytes)",
+              ("size", peer->inventory_advertised_to_peer.size() )("bytes", peer->inventory_advertised_to_peer.memory_usage() ) );
+        ilog( "    peer.fetchable_inventory_peer_advertised_to_us size: ${size}", ("size", peer->fetchable_inventory_peer_advertised_to_us.size() ) );
         ilog( "    peer.items_requested_from_peer size: ${size}", ("size", peer->items_requested_from_peer.size() ) );
         ilog( "    peer.sync_items_requested_from_peer size: ${size}", ("size", peer->sync_items_requested_from_peer.size() ) );
       }
@@ -4720,6 +5906,7 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            save_peer_performance(*peer_to_disconnect, *updated_peer_record);
             if (error)
               updated_peer_record->last_error = error;
             else
@@ -4820,6 +6007,10 @@ namespace graphene { namespace net { namespace detail {
         peer_details.current_head_block = peer->last_block_delegate_has_seen;
         peer_details.current_head_block_number = _delegate->get_block_number(peer->last_block_delegate_has_seen);
         peer_details.current_head_block_time = peer->last_block_time_delegate_has_seen;
+        peer_details.send_queues = peer->get_send_queue_status();
+        peer_details.performance = peer->performance;
+        peer_details.expected_block_delivery_time_ms = peer->performance.get_expected_block_delivery_time_ms();
+        peer_details.traffic = peer->get_traffic_statistics().get_recent_traffic();
 
         this_peer_status.info = peer_details;
         statuses.push_back(this_peer_status);
@@ -4856,6 +6047,8 @@ namespace graphene { namespace net { namespace detail {
 
       _message_cache.cache_message( item_to_broadcast, hash_of_item_to_broadcast, propagation_data, hash_of_message_contents );
       _new_inventory.insert( item_id(item_to_broadcast.msg_type, hash_of_item_to_broadcast ) );
+      if( item_to_broadcast.msg_type == graphene::net::block_message_type )
+        _new_inventory_contains_block = true;
       trigger_advertise_inventory_loop();
     }
 
@@ -4907,6 +6100,12 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("message_cache_size_in_bytes"))
+        _message_cache.set_max_size_in_bytes(params["message_cache_size_in_bytes"].as<uint64_t>());
+      if (params.contains("inventory_advertisement_interval_ms"))
+        _inventory_advertisement_interval_ms = params["inventory_advertisement_interval_ms"].as<uint32_t>();
+      if (params.contains("inventory_advertisement_batch_size"))
+        _inventory_advertisement_batch_size = params["inventory_advertisement_batch_size"].as<uint32_t>();
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4926,6 +6125,9 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["message_cache_size_in_bytes"] = (uint64_t)_message_cache.get_max_size_in_bytes();
+      result["inventory_advertisement_interval_ms"] = _inventory_advertisement_interval_ms;
+      result["inventory_advertisement_batch_size"] = _inventory_advertisement_batch_size;
       return result;
     }
 
@@ -4994,6 +6196,28 @@ namespace graphene { namespace net { namespace detail {
       info["node_public_key"] = _node_public_key;
       info["node_id"] = _node_id;
       info["firewalled"] = _is_firewalled;
+      info["message_cache_items"] = (uint64_t)_message_cache.size();
+      info["message_cache_bytes"] = (uint64_t)_message_cache.size_in_bytes();
+      info["message_cache_evictions"] = _message_cache.get_evictions();
+      info["message_cache_hit_rate"] = _message_cache.get_hit_rate();
+      info["delegate_handoff_queue_size"] = (uint64_t)_delegate_handoff_queue.size();
+      info["delegate_handoff_block_queue_size"] = (uint64_t)_delegate_handoff_block_queue.size();
+      info["delegate_handoff_dropped_messages"] = _delegate_handoff_dropped_messages;
+
+      // the traffic of all connected peers by message type, over the traffic statistics window
+      std::map<uint32_t, message_type_traffic> traffic_by_type;
+      for (const std::unordered_set<peer_connection_ptr>* connections : { &_active_connections, &_handshaking_connections, &_closing_connections })
+        for (const peer_connection_ptr& peer : *connections)
+          for (const message_type_traffic& peer_traffic : peer->get_traffic_statistics().get_recent_traffic())
+          {
+            message_type_traffic& traffic = traffic_by_type[peer_traffic.message_type];
+            traffic.message_type = peer_traffic.message_type;
+            traffic.add(peer_traffic);
+          }
+      std::vector<message_type_traffic> traffic;
+      for (const auto& type_and_traffic : traffic_by_type)
+        traffic.push_back(type_and_traffic.second);
+      info["traffic"] = traffic;
       return info;
     }
     fc::variant_object node_impl::network_get_usage_stats() const
@@ -5024,6 +6248,9 @@ namespace graphene { namespace net { namespace detail {
       result["usage_by_second"] = network_usage_by_second;
       result["usage_by_minute"] = network_usage_by_minute;
       result["usage_by_hour"] = network_usage_by_hour;
+      result["compression_savings_by_second"] = std::vector<uint32_t>(_average_compression_savings_seconds.begin(), _average_compression_savings_seconds.end());
+      result["compression_savings_by_minute"] = std::vector<uint32_t>(_average_compression_savings_minutes.begin(), _average_compression_savings_minutes.end());
+      result["compression_savings_by_hour"] = std::vector<uint32_t>(_average_compression_savings_hours.begin(), _average_compression_savings_hours.end());
       return result;
     }
 
@@ -5207,6 +6434,29 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(close);
   }
 
+  std::vector<fc::optional<fc::exception>> node_delegate::handle_transactions( const std::vector<graphene::net::trx_message>& trx_msgs )
+  {
+    std::vector<fc::optional<fc::exception>> errors;
+    errors.reserve(trx_msgs.size());
+    for (const graphene::net::trx_message& trx_msg : trx_msgs)
+    {
+      try
+      {
+        handle_transaction(trx_msg);
+        errors.emplace_back();
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        errors.emplace_back(e);
+      }
+    }
+    return errors;
+  }
+
   namespace detail
   {
 #define ROLLING_WINDOW_SIZE 1000
@@ -5333,6 +6583,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message);
     }
 
+    std::vector<fc::optional<fc::exception>> statistics_gathering_node_delegate_wrapper::handle_transactions( const std::vector<graphene::net::trx_message>& transaction_messages )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(handle_transactions, transaction_messages);
+    }
+
     std::vector<item_hash_t> statistics_gathering_node_delegate_wrapper::get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                                                                        uint32_t& remaining_item_count,
                                                                                        uint32_t limit /* = 2000 */)
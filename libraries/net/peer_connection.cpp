@@ -29,6 +29,9 @@
 
 #include <fc/thread/thread.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -42,7 +45,16 @@
 
 namespace graphene { namespace net
   {
-    message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
+    // bucket 0 counts the value 0, bucket n counts values from 4^(n-1) to 4^n - 1, the last bucket is open ended
+    static size_t get_histogram_bucket(uint64_t value)
+    {
+      size_t bucket = 0;
+      for (; value && bucket < GRAPHENE_NET_SEND_QUEUE_HISTOGRAM_BUCKETS - 1; value >>= 2)
+        ++bucket;
+      return bucket;
+    }
+
+    const message& peer_connection::real_queued_message::get_message(peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
@@ -55,13 +67,37 @@ namespace graphene { namespace net
       }
       return message_to_send;
     }
+    uint32_t peer_connection::real_queued_message::get_message_type() const
+    {
+      return message_to_send.msg_type;
+    }
     size_t peer_connection::real_queued_message::get_size_in_queue()
     {
       return message_to_send.data.size();
     }
-    message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    const message& peer_connection::shared_queued_message::get_message(peer_connection_delegate*)
+    {
+      return *message_to_send;
+    }
+    uint32_t peer_connection::shared_queued_message::get_message_type() const
+    {
+      return message_to_send->msg_type;
+    }
+    size_t peer_connection::shared_queued_message::get_size_in_queue()
     {
-      return node->get_message_for_item_optimized(item_to_send);
+      return message_to_send->data.size();
+    }
+
+    const message& peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    {
+      if (!generated_message)
+        generated_message = node->get_message_for_item_optimized(item_to_send);
+      return *generated_message;
+    }
+
+    uint32_t peer_connection::virtual_queued_message::get_message_type() const
+    {
+      return item_to_send.item_type;
     }
 
     size_t peer_connection::virtual_queued_message::get_size_in_queue()
@@ -69,10 +105,39 @@ namespace graphene { namespace net
       return sizeof(item_id);
     }
 
+    peer_connection::block_range_queued_message::block_range_queued_message(std::vector<std::shared_ptr<const message>> messages) :
+      messages(std::move(messages)),
+      size_in_queue(0)
+    {
+      for (const std::shared_ptr<const message>& block_message : this->messages)
+        size_in_queue += block_message->data.size();
+    }
+
+    const message& peer_connection::block_range_queued_message::get_message(peer_connection_delegate* node)
+    {
+      if (!generated_message)
+      {
+        generated_message.reset(new message(pack_message_vector<block_range_message>(messages)));
+        messages.clear();
+      }
+      return *generated_message;
+    }
+
+    uint32_t peer_connection::block_range_queued_message::get_message_type() const
+    {
+      return block_range_message_type;
+    }
+
+    size_t peer_connection::block_range_queued_message::get_size_in_queue()
+    {
+      return size_in_queue;
+    }
+
     peer_connection::peer_connection(peer_connection_delegate* delegate, const std::string& cert_file) :
       _node(delegate),
       _message_connection(this, cert_file),
       _total_queued_messages_size(0),
+      _total_queued_messages_count(0),
       direction(peer_connection_direction::unknown),
       is_firewalled(firewalled_state::unknown),
       our_state(our_connection_state::disconnected),
@@ -80,10 +145,15 @@ namespace graphene { namespace net
       their_state(their_connection_state::disconnected),
       we_have_requested_close(false),
       negotiation_status(connection_negotiation_status::disconnected),
+      supported_features(0),
+      bytes_saved_by_compression_reported(0),
       number_of_unfetched_item_ids(0),
       peer_needs_sync_items_from_us(true),
       we_need_sync_items_from_peer(true),
       inhibit_fetching_sync_blocks(false),
+      sync_items_received_in_batch(0),
+      sync_blocks_per_second(0),
+      sync_items_request_bytes_received(0),
       transaction_fetching_inhibited_until(fc::time_point::min()),
       last_known_fork_block_number(0),
       firewall_check_state(nullptr)
@@ -99,6 +169,7 @@ namespace graphene { namespace net
       _node(delegate),
       _message_connection(this, cert_file, key_file, key_password),
       _total_queued_messages_size(0),
+      _total_queued_messages_count(0),
       direction(peer_connection_direction::unknown),
       is_firewalled(firewalled_state::unknown),
       our_state(our_connection_state::disconnected),
@@ -106,10 +177,15 @@ namespace graphene { namespace net
       their_state(their_connection_state::disconnected),
       we_have_requested_close(false),
       negotiation_status(connection_negotiation_status::disconnected),
+      supported_features(0),
+      bytes_saved_by_compression_reported(0),
       number_of_unfetched_item_ids(0),
       peer_needs_sync_items_from_us(true),
       we_need_sync_items_from_peer(true),
       inhibit_fetching_sync_blocks(false),
+      sync_items_received_in_batch(0),
+      sync_blocks_per_second(0),
+      sync_items_request_bytes_received(0),
       transaction_fetching_inhibited_until(fc::time_point::min()),
       last_known_fork_block_number(0),
       firewall_check_state(nullptr)
@@ -310,9 +386,16 @@ namespace graphene { namespace net
     {
       VERIFY_CORRECT_THREAD();
       negotiation_status = connection_negotiation_status::closed;
+      _pending_block_range_frames.clear();
       _node->on_connection_closed( this );
     }
 
+    std::shared_ptr<const message> peer_connection::get_shared_compressed_message( const message& message_to_send )
+    {
+      VERIFY_CORRECT_THREAD();
+      return _node->get_shared_compressed_message( message_to_send );
+    }
+
     void peer_connection::send_queued_messages_task()
     {
       VERIFY_CORRECT_THREAD();
@@ -323,22 +406,47 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      while (_total_queued_messages_count)
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        send_queue* queue = std::find_if(std::begin(_send_queues), std::end(_send_queues),
+                                         [](const send_queue& q) { return !q.messages.empty(); });
+
+        // small messages queued behind the first one go out in the same write
+        std::vector<const message*> messages_to_send;
+        size_t bytes_to_send = 0;
+        auto batch_end = queue->messages.begin();
+        do
+        {
+          (*batch_end)->transmission_start_time = fc::time_point::now();
+          const message& message_to_send = (*batch_end)->get_message(_node);
+          bool is_small_message = message_to_send.size <= GRAPHENE_NET_MAXIMUM_COALESCED_MESSAGE_SIZE;
+          if (!messages_to_send.empty() &&
+              (!is_small_message ||
+               bytes_to_send + sizeof(message_header) + message_to_send.size > GRAPHENE_NET_MAXIMUM_COALESCED_WRITE_SIZE))
+            break;
+          messages_to_send.push_back(&message_to_send);
+          bytes_to_send += sizeof(message_header) + message_to_send.size;
+          ++batch_end;
+          if (!is_small_message)
+            break;
+        }
+        while (batch_end != queue->messages.end());
+
         try
         {
-          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
-          //     "to send message of type ${type} for peer ${endpoint}",
-          //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
-          //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
+          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_messages() "
+          //     "to send ${count} messages for peer ${endpoint}",
+          //     ("count", messages_to_send.size())("endpoint", get_remote_endpoint()));
+          _message_connection.send_messages(messages_to_send);
+          // more messages may have been queued while we were writing, flush only once the queue drains
+          if (_total_queued_messages_count == messages_to_send.size())
+            _message_connection.flush();
+          //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_messages() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
         catch (const fc::canceled_exception&)
         {
-          dlog("message_oriented_connection::send_message() was canceled, rethrowing canceled_exception");
+          dlog("message_oriented_connection::send_messages() was canceled, rethrowing canceled_exception");
           throw;
         }
         catch (const fc::exception& send_error)
@@ -356,28 +464,125 @@ namespace graphene { namespace net
         }
         catch (const std::exception& e)
         {
-          elog("message_oriented_exception::send_message() threw a std::exception(): ${what}", ("what", e.what()));
+          elog("message_oriented_exception::send_messages() threw a std::exception(): ${what}", ("what", e.what()));
         }
         catch (...)
         {
-          elog("message_oriented_exception::send_message() threw an unhandled exception");
+          elog("message_oriented_exception::send_messages() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        fc::time_point transmission_finish_time = fc::time_point::now();
+        for (size_t i = 0; i < messages_to_send.size(); ++i)
+        {
+          queued_message& sent_message = *queue->messages.front();
+          sent_message.transmission_finish_time = transmission_finish_time;
+          fc::microseconds queueing_delay = sent_message.transmission_start_time - sent_message.enqueue_time;
+          ++queue->queueing_delay_histogram[get_histogram_bucket(queueing_delay.count() / 1000)];
+          _message_connection.get_traffic_statistics().add_queueing_delay(sent_message.get_message_type(), queueing_delay);
+          size_t size_in_queue = sent_message.get_size_in_queue();
+          queue->queued_bytes -= size_in_queue;
+          _total_queued_messages_size -= size_in_queue;
+          --_total_queued_messages_count;
+          queue->messages.pop_front();
+        }
+        queue_pending_block_range_frames();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
+    peer_connection::send_queue_class peer_connection::get_send_queue_class(uint32_t message_type)
+    {
+      switch (message_type)
+      {
+      case block_message_type:
+      case block_range_message_type:
+      case compact_block_message_type:
+      case compact_block_transactions_message_type:
+      case blockchain_item_ids_inventory_message_type:
+      case fetch_blockchain_item_ids_message_type:
+      case fetch_items_message_type:
+      case fetch_block_range_message_type:
+      case fetch_compact_block_transactions_message_type:
+      case item_not_available_message_type:
+      // negotiation must not be overtaken by the requests that follow it
+      case hello_message_type:
+      case connection_accepted_message_type:
+      case connection_rejected_message_type:
+      case closing_connection_message_type:
+        return block_send_queue;
+      case item_ids_inventory_message_type:
+        return inventory_send_queue;
+      case trx_message_type:
+      case transaction_batch_message_type:
+        return transaction_send_queue;
+      default:
+        return housekeeping_send_queue;
+      }
+    }
+
+    size_t peer_connection::get_maximum_queued_bytes(send_queue_class queue_class)
+    {
+      static const size_t maximum_queued_bytes[send_queue_class_count] = { GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES,
+                                                                           GRAPHENE_NET_MAXIMUM_QUEUED_INVENTORY_IN_BYTES,
+                                                                           GRAPHENE_NET_MAXIMUM_QUEUED_TRANSACTIONS_IN_BYTES,
+                                                                           GRAPHENE_NET_MAXIMUM_QUEUED_HOUSEKEEPING_IN_BYTES };
+      return maximum_queued_bytes[queue_class];
+    }
+
+    bool peer_connection::can_queue_message(uint32_t message_type, size_t size_in_queue) const
+    {
+      send_queue_class queue_class = get_send_queue_class(message_type);
+      return _send_queues[queue_class].queued_bytes + size_in_queue <= get_maximum_queued_bytes(queue_class);
+    }
+
     void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
-      _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
-      if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
+      send_queue_class queue_class = get_send_queue_class(message_to_send->get_message_type());
+      send_queue& queue = _send_queues[queue_class];
+      size_t size_in_queue = message_to_send->get_size_in_queue();
+      size_t maximum_queued_bytes = get_maximum_queued_bytes(queue_class);
+
+      if (queue.queued_bytes + size_in_queue > maximum_queued_bytes)
+      {
+        if (queue_class == inventory_send_queue)
+        {
+          // the items already count as advertised to this peer, so they won't be advertised to it again.
+          // advertise_inventory_loop() checks can_queue_message() before marking them, so this is a last resort
+          ++queue.dropped_messages;
+          dlog("inventory send queue for peer ${endpoint} is full, dropping an inventory message", ("endpoint", get_remote_endpoint()));
+          return;
+        }
+        if (queue_class == transaction_send_queue)
+        {
+          // tell them we don't have the transactions, so they fetch them from another peer instead of waiting for them
+          ++queue.dropped_messages;
+          message dropped_message = message_to_send->get_message(_node);
+          std::vector<message_hash_type> dropped_transaction_ids;
+          if (dropped_message.msg_type == transaction_batch_message_type)
+            for (const message& transaction : dropped_message.as<transaction_batch_message>().transactions)
+              dropped_transaction_ids.push_back(transaction.id());
+          else
+            dropped_transaction_ids.push_back(dropped_message.id());
+          for (const message_hash_type& transaction_id : dropped_transaction_ids)
+          {
+            dlog("transaction send queue for peer ${endpoint} is full, replying item_not_available for ${id}",
+                 ("endpoint", get_remote_endpoint())("id", transaction_id));
+            send_message(item_not_available_message(item_id(trx_message_type, transaction_id)));
+          }
+          return;
+        }
+      }
+
+      ++queue.queue_depth_histogram[get_histogram_bucket(queue.messages.size())];
+      queue.queued_bytes += size_in_queue;
+      _total_queued_messages_size += size_in_queue;
+      ++_total_queued_messages_count;
+      queue.messages.emplace_back(std::move(message_to_send));
+      // a single message larger than the limit still goes out on its own
+      if (queue.queued_bytes > maximum_queued_bytes && queue.messages.size() > 1)
       {
         elog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
-             ("max", GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)("current", _total_queued_messages_size));
+             ("max", maximum_queued_bytes)("current", queue.queued_bytes));
         try
         {
           close_connection();
@@ -410,6 +615,13 @@ namespace graphene { namespace net
       send_queueable_message(std::move(message_to_enqueue));
     }
 
+    void peer_connection::send_message(std::shared_ptr<const message> message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::unique_ptr<queued_message> message_to_enqueue(new shared_queued_message(std::move(message_to_send)));
+      send_queueable_message(std::move(message_to_enqueue));
+    }
+
     void peer_connection::send_item(const item_id& item_to_send)
     {
       VERIFY_CORRECT_THREAD();
@@ -419,12 +631,43 @@ namespace graphene { namespace net
       send_queueable_message(std::move(message_to_enqueue));
     }
 
+    void peer_connection::send_block_range_reply(std::vector<block_range_reply::frame> frames)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::move(frames.begin(), frames.end(), std::back_inserter(_pending_block_range_frames));
+      queue_pending_block_range_frames();
+    }
+
+    void peer_connection::queue_pending_block_range_frames()
+    {
+      VERIFY_CORRECT_THREAD();
+      // a whole reply can be far larger than the block send queue, so its frames only go in while they fit.
+      // A frame always goes into an empty queue, however large its block is
+      while (!_pending_block_range_frames.empty() &&
+             negotiation_status != connection_negotiation_status::closing &&
+             negotiation_status != connection_negotiation_status::closed)
+      {
+        block_range_reply::frame& frame = _pending_block_range_frames.front();
+        if (!_send_queues[block_send_queue].messages.empty() &&
+            !can_queue_message(block_range_message_type, frame.get_size_in_queue()))
+          break;
+        std::unique_ptr<queued_message> message_to_enqueue;
+        if (frame.is_block_range)
+          message_to_enqueue.reset(new block_range_queued_message(std::move(frame.messages)));
+        else
+          message_to_enqueue.reset(new shared_queued_message(std::move(frame.messages.front())));
+        _pending_block_range_frames.pop_front();
+        send_queueable_message(std::move(message_to_enqueue));
+      }
+    }
+
     void peer_connection::close_connection()
     {
       VERIFY_CORRECT_THREAD();
       negotiation_status = connection_negotiation_status::closing;
       if (connection_terminated_time != fc::time_point::min())
         connection_terminated_time = fc::time_point::now();
+      _pending_block_range_frames.clear();
       _message_connection.close_connection();
     }
 
@@ -447,6 +690,36 @@ namespace graphene { namespace net
       return _message_connection.get_total_bytes_received();
     }
 
+    uint64_t peer_connection::get_total_bytes_saved_by_compression() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_total_bytes_saved_by_compression();
+    }
+
+    traffic_statistics& peer_connection::get_traffic_statistics()
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_traffic_statistics();
+    }
+
+    const traffic_statistics& peer_connection::get_traffic_statistics() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_traffic_statistics();
+    }
+
+    void peer_connection::set_compression_enabled(bool enabled)
+    {
+      VERIFY_CORRECT_THREAD();
+      _message_connection.set_compression_enabled(enabled);
+    }
+
+    void peer_connection::enable_authenticated_encryption()
+    {
+      VERIFY_CORRECT_THREAD();
+      _message_connection.enable_authenticated_encryption();
+    }
+
     fc::time_point peer_connection::get_last_message_sent_time() const
     {
       VERIFY_CORRECT_THREAD();
@@ -488,6 +761,12 @@ namespace graphene { namespace net
       return !busy();
     }
 
+    bool peer_connection::supports_feature(core_protocol_feature feature) const
+    {
+      VERIFY_CORRECT_THREAD();
+      return (supported_features & feature) != 0;
+    }
+
     bool peer_connection::is_transaction_fetching_inhibited() const
     {
       VERIFY_CORRECT_THREAD();
@@ -505,28 +784,25 @@ namespace graphene { namespace net
       VERIFY_CORRECT_THREAD();
       fc::time_point_sec oldest_inventory_to_keep(fc::time_point::now() - fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
 
-      // expire old items from inventory_advertised_to_peer
-      auto oldest_inventory_to_keep_iter = inventory_advertised_to_peer.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      auto begin_iter = inventory_advertised_to_peer.get<timestamp_index>().begin();
-      uint64_t number_of_elements_advertised_to_peer_to_discard = static_cast<uint64_t>(std::distance(begin_iter, oldest_inventory_to_keep_iter));
-      inventory_advertised_to_peer.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
+      // the filters retire their own generations, only the exact list has to be pruned item by item
+      inventory_advertised_to_peer.expire();
+      inventory_peer_advertised_to_us.expire();
 
-      // also expire items from inventory_peer_advertised_to_us
-      oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
+      auto oldest_inventory_to_keep_iter = fetchable_inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
+      auto begin_iter = fetchable_inventory_peer_advertised_to_us.get<timestamp_index>().begin();
       uint64_t number_of_elements_peer_advertised_to_discard = static_cast<uint64_t>(std::distance(begin_iter, oldest_inventory_to_keep_iter));
-      inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
-      dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
+      fetchable_inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
+      dlog("Expiring old inventory for peer ${peer}: ${to_peer} items advertised to peer, ${from_peer} advertised to us, removing ${to_us} fetchable items (${remain_to_us} left)",
            ("peer", get_remote_endpoint())
-           ("to_peer", number_of_elements_advertised_to_peer_to_discard)("remain_to_peer", inventory_advertised_to_peer.size())
-           ("to_us", number_of_elements_peer_advertised_to_discard)("remain_to_us", inventory_peer_advertised_to_us.size()));
+           ("to_peer", inventory_advertised_to_peer.size())("from_peer", inventory_peer_advertised_to_us.size())
+           ("to_us", number_of_elements_peer_advertised_to_discard)("remain_to_us", fetchable_inventory_peer_advertised_to_us.size()));
     }
 
     // we have a higher limit for blocks than transactions so we will still fetch blocks even when transactions are throttled
     bool peer_connection::is_inventory_advertised_to_us_list_full_for_transactions() const
     {
       VERIFY_CORRECT_THREAD();
-      return inventory_peer_advertised_to_us.size() > GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * GRAPHENE_NET_MAX_TRX_PER_SECOND * 60;
+      return fetchable_inventory_peer_advertised_to_us.size() > GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * GRAPHENE_NET_MAX_TRX_PER_SECOND * 60;
     }
 
     bool peer_connection::is_inventory_advertised_to_us_list_full() const
@@ -535,7 +811,7 @@ namespace graphene { namespace net
       // allow the total inventory size to be the maximum number of transactions we'll store in the inventory (above)
       // plus the maximum number of blocks that would be generated in GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES (plus one,
       // to give us some wiggle room)
-      return inventory_peer_advertised_to_us.size() >
+      return fetchable_inventory_peer_advertised_to_us.size() >
         GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * GRAPHENE_NET_MAX_TRX_PER_SECOND * 60 +
         (GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES + 1) * 60 / GRAPHENE_MIN_BLOCK_INTERVAL;
     }
@@ -552,4 +828,21 @@ namespace graphene { namespace net
       return fc::optional<fc::ip::endpoint>();
     }
 
+    std::vector<peer_send_queue_status> peer_connection::get_send_queue_status() const
+    {
+      VERIFY_CORRECT_THREAD();
+      static const char* const queue_class_names[send_queue_class_count] = { "blocks", "inventory", "transactions", "housekeeping" };
+      std::vector<peer_send_queue_status> statuses(send_queue_class_count);
+      for (size_t i = 0; i < send_queue_class_count; ++i)
+      {
+        statuses[i].queue_class = queue_class_names[i];
+        statuses[i].queued_messages = (uint32_t)_send_queues[i].messages.size();
+        statuses[i].queued_bytes = _send_queues[i].queued_bytes;
+        statuses[i].dropped_messages = _send_queues[i].dropped_messages;
+        statuses[i].queue_depth_histogram.assign(_send_queues[i].queue_depth_histogram.begin(), _send_queues[i].queue_depth_histogram.end());
+        statuses[i].queueing_delay_histogram.assign(_send_queues[i].queueing_delay_histogram.begin(), _send_queues[i].queueing_delay_histogram.end());
+      }
+      return statuses;
+    }
+
 } } // end namespace graphene::net
@@ -32,17 +32,84 @@
 #include <fc/io/raw_variant.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
+#include <fc/io/datastream.hpp>
+#include <fc/crypto/city.hpp>
 
 #include <graphene/net/peer_database.hpp>
+#include <graphene/net/config.hpp>
 
 #include <boost/filesystem.hpp>
 #include <fc/filesystem.hpp>
 
+#include <fstream>
+#include <iterator>
+
 namespace graphene { namespace net {
+
+  bool peer_performance_record::is_measured() const
+  {
+    return round_trip_delay_ms || block_delivery_latency_ms || download_bytes_per_second;
+  }
+
+  void peer_performance_record::update(const peer_performance_record& sample)
+  {
+    auto update_average = [](uint32_t& average, uint32_t sample_value) {
+      if (sample_value)
+        average = average ? (uint32_t)((3 * (uint64_t)average + sample_value) / 4) : sample_value;
+    };
+    update_average(round_trip_delay_ms, sample.round_trip_delay_ms);
+    update_average(block_delivery_latency_ms, sample.block_delivery_latency_ms);
+    update_average(download_bytes_per_second, sample.download_bytes_per_second);
+  }
+
+  uint32_t peer_performance_record::get_expected_block_delivery_time_ms() const
+  {
+    uint64_t round_trip_delay = round_trip_delay_ms ? round_trip_delay_ms : GRAPHENE_NET_PEER_DEFAULT_ROUND_TRIP_DELAY_MS;
+    uint64_t bytes_per_second = download_bytes_per_second ? download_bytes_per_second : GRAPHENE_NET_PEER_DEFAULT_DOWNLOAD_BYTES_PER_SECOND;
+    uint64_t modeled_delivery_time = round_trip_delay + (uint64_t)GRAPHENE_NET_PEER_SCORE_BLOCK_SIZE * 1000 / bytes_per_second;
+    // what we observed directly counts as much as what the round trip delay and bandwidth predict
+    if (block_delivery_latency_ms)
+      return (uint32_t)((modeled_delivery_time + block_delivery_latency_ms) / 2);
+    return (uint32_t)modeled_delivery_time;
+  }
+
   namespace detail
   {
     using namespace boost::multi_index;
 
+    namespace
+    {
+      /**
+       * The database file holds a snapshot of all records:
+       *   magic, version, payload size, payload checksum, payload (the raw packed records)
+       * and the journal next to it the changes made since, each one as:
+       *   operation, payload size, payload checksum, payload (the record or the erased endpoint)
+       * A journal entry is written on every change.  The journal is flushed at most once per
+       * GRAPHENE_NET_PEER_DATABASE_JOURNAL_FLUSH_INTERVAL_MS and when the owner calls flush(),
+       * so a crash loses the changes since the last flush.  Replay stops at the first incomplete entry.
+       */
+      const uint32_t peer_database_magic = 0x42445050; // "PPDB"
+      const uint32_t peer_database_version = 1;
+
+      enum peer_database_journal_operation : uint8_t
+      {
+        journal_update_entry = 1,
+        journal_erase_entry = 2
+      };
+
+      uint64_t checksum(const std::vector<char>& payload)
+      {
+        return payload.empty() ? 0 : fc::city_hash64(payload.data(), payload.size());
+      }
+
+      std::vector<char> read_file(const boost::filesystem::path& filename)
+      {
+        std::ifstream file(filename.string(), std::ios::in | std::ios::binary);
+        FC_ASSERT(file, "unable to open ${filename}", ("filename", filename));
+        return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      }
+    }
+
     class peer_database_impl
     {
     public:
@@ -62,11 +129,29 @@ namespace graphene { namespace net {
     private:
       potential_peer_set     _potential_peer_set;
       boost::filesystem::path _peer_database_filename;
+      boost::filesystem::path _journal_filename;
+      std::ofstream          _journal;
+      uint32_t               _journal_entry_count = 0;
+      bool                   _journal_has_unflushed_entries = false;
+      fc::time_point         _journal_flush_time;
+
+      void load_snapshot();
+      void import_json_database(const boost::filesystem::path& json_filename);
+      void replay_journal();
+      void append_to_journal(peer_database_journal_operation operation, const std::vector<char>& payload);
+      void flush_journal();
+      /** writes all records to a new snapshot and starts an empty journal */
+      void compact();
+      void apply_update(const potential_peer_record& updatedRecord);
+      void apply_erase(const fc::ip::endpoint& endpointToErase);
+      /** drops the peers we have not seen for the longest time until the database fits its size limit */
+      void enforce_size_limit(const fc::ip::endpoint& endpoint_to_keep = fc::ip::endpoint());
 
     public:
       void open(const boost::filesystem::path& databaseFilename);
       void close();
       void clear();
+      void flush();
       void erase(const fc::ip::endpoint& endpointToErase);
       void update_entry(const potential_peer_record& updatedRecord);
       potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
@@ -92,63 +177,240 @@ namespace graphene { namespace net {
     void peer_database_impl::open(const boost::filesystem::path& peer_database_filename)
     {
       _peer_database_filename = peer_database_filename;
+      _journal_filename = peer_database_filename.string() + ".journal";
+      _potential_peer_set.clear();
+
+      boost::filesystem::path peer_database_filename_dir = _peer_database_filename.parent_path();
+      if (!peer_database_filename_dir.empty() && !exists(peer_database_filename_dir))
+        create_directories(peer_database_filename_dir);
+
       if (exists(_peer_database_filename))
+        load_snapshot();
+      else
       {
-        try
-        {
-          std::vector<potential_peer_record> peer_records = fc::json::from_file(_peer_database_filename).as<std::vector<potential_peer_record> >();
-          std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
-#define MAXIMUM_PEERDB_SIZE 1000
-          if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
-          {
-            // prune database to a reasonable size
-            auto iter = _potential_peer_set.begin();
-            std::advance(iter, MAXIMUM_PEERDB_SIZE);
-            _potential_peer_set.erase(iter, _potential_peer_set.end());
-          }
-        }
-        catch (const fc::exception&)
+        // databases written by older versions were saved as json at close
+        boost::filesystem::path json_filename = boost::filesystem::path(_peer_database_filename).replace_extension(".json");
+        if (json_filename != _peer_database_filename && exists(json_filename))
+          import_json_database(json_filename);
+      }
+      if (exists(_journal_filename))
+        replay_journal();
+      enforce_size_limit();
+
+      // start from a fresh snapshot, this also drops an incomplete entry at the end of the journal
+      compact();
+    }
+
+    void peer_database_impl::load_snapshot()
+    {
+      try
+      {
+        std::vector<char> file_contents = read_file(_peer_database_filename);
+        fc::datastream<const char*> ds(file_contents.data(), file_contents.size());
+        uint32_t magic = 0, version = 0, payload_size = 0;
+        uint64_t payload_checksum = 0;
+        fc::raw::unpack(ds, magic);
+        fc::raw::unpack(ds, version);
+        FC_ASSERT(magic == peer_database_magic && version == peer_database_version,
+                  "not a peer database of a supported version", ("version", version));
+        fc::raw::unpack(ds, payload_size);
+        fc::raw::unpack(ds, payload_checksum);
+        FC_ASSERT(payload_size <= ds.remaining(), "truncated peer database");
+        std::vector<char> payload(file_contents.data() + ds.tellp(), file_contents.data() + ds.tellp() + payload_size);
+        FC_ASSERT(checksum(payload) == payload_checksum, "peer database checksum mismatch");
+
+        std::vector<potential_peer_record> peer_records = fc::raw::unpack<std::vector<potential_peer_record> >(payload);
+        for (const potential_peer_record& record : peer_records)
+          apply_update(record);
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error opening peer database file ${peer_database_filename}, starting with a clean database: ${e}", 
+             ("peer_database_filename", _peer_database_filename)("e", e.to_detail_string()));
+        _potential_peer_set.clear();
+      }
+    }
+
+    void peer_database_impl::import_json_database(const boost::filesystem::path& json_filename)
+    {
+      try
+      {
+        std::vector<potential_peer_record> peer_records = fc::json::from_file(json_filename).as<std::vector<potential_peer_record> >();
+        for (const potential_peer_record& record : peer_records)
+          apply_update(record);
+        ilog("imported ${count} peers from ${json_filename}", ("count", _potential_peer_set.size())("json_filename", json_filename));
+      }
+      catch (const fc::exception&)
+      {
+        elog("error importing peer database file ${json_filename}, starting with a clean database", 
+             ("json_filename", json_filename));
+        _potential_peer_set.clear();
+      }
+    }
+
+    void peer_database_impl::replay_journal()
+    {
+      uint32_t entries_replayed = 0;
+      try
+      {
+        std::vector<char> file_contents = read_file(_journal_filename);
+        fc::datastream<const char*> ds(file_contents.data(), file_contents.size());
+        const size_t entry_header_size = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t);
+        while (ds.remaining() >= entry_header_size)
         {
-          elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
-               ("peer_database_filename", _peer_database_filename));
+          uint8_t operation = 0;
+          uint32_t payload_size = 0;
+          uint64_t payload_checksum = 0;
+          fc::raw::unpack(ds, operation);
+          fc::raw::unpack(ds, payload_size);
+          fc::raw::unpack(ds, payload_checksum);
+          if (payload_size > ds.remaining())
+            break;
+          std::vector<char> payload(file_contents.data() + ds.tellp(), file_contents.data() + ds.tellp() + payload_size);
+          ds.skip(payload_size);
+          if (checksum(payload) != payload_checksum)
+            break;
+
+          if (operation == journal_update_entry)
+            apply_update(fc::raw::unpack<potential_peer_record>(payload));
+          else if (operation == journal_erase_entry)
+            apply_erase(fc::raw::unpack<fc::ip::endpoint>(payload));
+          else
+            break;
+          ++entries_replayed;
         }
+        if (ds.remaining())
+          wlog("ignoring ${bytes} bytes of incomplete entries at the end of peer database journal ${journal_filename}",
+               ("bytes", ds.remaining())("journal_filename", _journal_filename));
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error replaying peer database journal ${journal_filename} after ${entries} entries: ${e}",
+             ("journal_filename", _journal_filename)("entries", entries_replayed)("e", e.to_detail_string()));
       }
+      dlog("replayed ${entries} peer database journal entries", ("entries", entries_replayed));
     }
 
-    void peer_database_impl::close()
+    void peer_database_impl::append_to_journal(peer_database_journal_operation operation, const std::vector<char>& payload)
     {
-      std::vector<potential_peer_record> peer_records;
-      peer_records.reserve(_potential_peer_set.size());
-      std::copy(_potential_peer_set.begin(), _potential_peer_set.end(), std::back_inserter(peer_records));
+      if (!_journal.is_open())
+        return;
+      if (_journal_entry_count >= GRAPHENE_NET_PEER_DATABASE_MAXIMUM_JOURNAL_ENTRIES)
+      {
+        // the change is already applied in memory, so the new snapshot contains it
+        compact();
+        return;
+      }
 
+      std::vector<char> entry(sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t));
+      fc::datastream<char*> ds(entry.data(), entry.size());
+      fc::raw::pack(ds, (uint8_t)operation);
+      fc::raw::pack(ds, (uint32_t)payload.size());
+      fc::raw::pack(ds, checksum(payload));
+      entry.insert(entry.end(), payload.begin(), payload.end());
+
+      _journal.write(entry.data(), entry.size());
+      ++_journal_entry_count;
+      _journal_has_unflushed_entries = true;
+      // peers are updated on every connection event, one flush covers all the entries written since the last one.
+      // A failed write is reported right away
+      if (!_journal || fc::time_point::now() - _journal_flush_time >= fc::milliseconds(GRAPHENE_NET_PEER_DATABASE_JOURNAL_FLUSH_INTERVAL_MS))
+        flush_journal();
+    }
+
+    void peer_database_impl::flush_journal()
+    {
+      if (!_journal.is_open())
+        return;
+      _journal.flush();
+      _journal_has_unflushed_entries = false;
+      _journal_flush_time = fc::time_point::now();
+      if (!_journal)
+      {
+        elog("error writing to peer database journal ${journal_filename}, further changes will be saved at close",
+             ("journal_filename", _journal_filename));
+        _journal.close();
+      }
+    }
+
+    void peer_database_impl::flush()
+    {
+      if (_journal_has_unflushed_entries)
+        flush_journal();
+    }
+
+    void peer_database_impl::compact()
+    {
+      if (_peer_database_filename.empty())
+        return;
       try
       {
-        boost::filesystem::path peer_database_filename_dir = _peer_database_filename.parent_path();
-        if (!exists(peer_database_filename_dir))
-          create_directories(peer_database_filename_dir);
-        fc::json::save_to_file(peer_records, _peer_database_filename);
+        std::vector<potential_peer_record> peer_records(_potential_peer_set.begin(), _potential_peer_set.end());
+        std::vector<char> payload = fc::raw::pack(peer_records);
+
+        boost::filesystem::path temporary_filename = _peer_database_filename.string() + ".tmp";
+        {
+          std::ofstream snapshot(temporary_filename.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+          FC_ASSERT(snapshot, "unable to create ${filename}", ("filename", temporary_filename));
+          std::vector<char> header(2 * sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t));
+          fc::datastream<char*> ds(header.data(), header.size());
+          fc::raw::pack(ds, peer_database_magic);
+          fc::raw::pack(ds, peer_database_version);
+          fc::raw::pack(ds, (uint32_t)payload.size());
+          fc::raw::pack(ds, checksum(payload));
+          snapshot.write(header.data(), header.size());
+          if (!payload.empty())
+            snapshot.write(payload.data(), payload.size());
+          snapshot.flush();
+          FC_ASSERT(snapshot, "error writing ${filename}", ("filename", temporary_filename));
+        }
+        // the rename replaces the old snapshot atomically, a crash leaves either the old snapshot and its journal or the new one
+        boost::filesystem::rename(temporary_filename, _peer_database_filename);
+
+        _journal.close();
+        _journal.clear();
+        _journal.open(_journal_filename.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!_journal)
+          elog("unable to open peer database journal ${journal_filename}, changes will be saved at close",
+               ("journal_filename", _journal_filename));
+        _journal_entry_count = 0;
+        _journal_has_unflushed_entries = false;
+        _journal_flush_time = fc::time_point::now();
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error saving peer database to file ${peer_database_filename}: ${e}", 
+             ("peer_database_filename", _peer_database_filename)("e", e.to_detail_string()));
       }
-      catch (const fc::exception&)
+      catch (const boost::filesystem::filesystem_error& e)
       {
-        elog("error saving peer database to file ${peer_database_filename}", 
-             ("peer_database_filename", _peer_database_filename));
+        elog("error saving peer database to file ${peer_database_filename}: ${e}", 
+             ("peer_database_filename", _peer_database_filename)("e", e.what()));
       }
+    }
+
+    void peer_database_impl::close()
+    {
+      compact();
+      _journal.close();
+      _journal.clear();
       _potential_peer_set.clear();
     }
 
     void peer_database_impl::clear()
     {
       _potential_peer_set.clear();
+      compact();
     }
 
-    void peer_database_impl::erase(const fc::ip::endpoint& endpointToErase)
+    void peer_database_impl::apply_erase(const fc::ip::endpoint& endpointToErase)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToErase);
       if (iter != _potential_peer_set.get<endpoint_index>().end())
         _potential_peer_set.get<endpoint_index>().erase(iter);
     }
 
-    void peer_database_impl::update_entry(const potential_peer_record& updatedRecord)
+    void peer_database_impl::apply_update(const potential_peer_record& updatedRecord)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(updatedRecord.endpoint);
       if (iter != _potential_peer_set.get<endpoint_index>().end())
@@ -157,6 +419,41 @@ namespace graphene { namespace net {
         _potential_peer_set.get<endpoint_index>().insert(updatedRecord);
     }
 
+    void peer_database_impl::enforce_size_limit(const fc::ip::endpoint& endpoint_to_keep)
+    {
+      auto& last_seen_index = _potential_peer_set.get<last_seen_time_index>();
+      auto iter = last_seen_index.begin();
+      while (_potential_peer_set.size() > GRAPHENE_NET_MAXIMUM_PEER_DATABASE_SIZE && iter != last_seen_index.end())
+      {
+        if (iter->endpoint == endpoint_to_keep)
+        {
+          ++iter;
+          continue;
+        }
+        fc::ip::endpoint evicted_endpoint = iter->endpoint;
+        iter = last_seen_index.erase(iter);
+        append_to_journal(journal_erase_entry, fc::raw::pack(evicted_endpoint));
+      }
+    }
+
+    void peer_database_impl::erase(const fc::ip::endpoint& endpointToErase)
+    {
+      auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToErase);
+      if (iter == _potential_peer_set.get<endpoint_index>().end())
+        return;
+      _potential_peer_set.get<endpoint_index>().erase(iter);
+      append_to_journal(journal_erase_entry, fc::raw::pack(endpointToErase));
+    }
+
+    void peer_database_impl::update_entry(const potential_peer_record& updatedRecord)
+    {
+      bool is_new_entry = _potential_peer_set.get<endpoint_index>().find(updatedRecord.endpoint) == _potential_peer_set.get<endpoint_index>().end();
+      apply_update(updatedRecord);
+      append_to_journal(journal_update_entry, fc::raw::pack(updatedRecord));
+      if (is_new_entry)
+        enforce_size_limit(updatedRecord.endpoint);
+    }
+
     potential_peer_record peer_database_impl::lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToLookup);
@@ -241,6 +538,11 @@ namespace graphene { namespace net {
     my->clear();
   }
 
+  void peer_database::flush()
+  {
+    my->flush();
+  }
+
   void peer_database::erase(const fc::ip::endpoint& endpointToErase)
   {
     my->erase(endpointToErase);
@@ -0,0 +1,142 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/net/rolling_inventory_filter.hpp>
+
+#include <fc/crypto/rand.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net {
+
+  namespace
+  {
+    const uint64_t filter_size_in_bits = (uint64_t(GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION) *
+                                          GRAPHENE_NET_INVENTORY_FILTER_BITS_PER_ITEM + 63) / 64 * 64;
+
+    // a generation is retired after half the window, so every item stays
+    // in the filter for at least the full window before its generation is cleared
+    fc::microseconds generation_duration()
+    {
+      return fc::seconds(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * 60 / 2);
+    }
+
+    uint64_t mix(uint64_t x)
+    {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      return x;
+    }
+  }
+
+  rolling_inventory_filter::rolling_inventory_filter() :
+    _current_generation(0)
+  {
+    fc::rand_pseudo_bytes((char*)_salt, sizeof(_salt));
+    _generations[_current_generation].start_time = fc::time_point::now();
+  }
+
+  void rolling_inventory_filter::get_hashes(const item_id& item, uint64_t& h1, uint64_t& h2) const
+  {
+    const uint32_t* words = item.item_hash._hash;
+    h1 = mix(((uint64_t(words[0]) << 32) | words[1]) ^ _salt[0]);
+    h2 = mix(((uint64_t(words[2]) << 32) | words[3]) ^ ((uint64_t(words[4]) << 32) | item.item_type) ^ _salt[1]) | 1;
+  }
+
+  void rolling_inventory_filter::insert(const item_id& item)
+  {
+    generation* current = &_generations[_current_generation];
+    if (current->item_count >= GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION)
+    {
+      start_new_generation(fc::time_point::now());
+      current = &_generations[_current_generation];
+    }
+    if (current->bits.empty())
+      current->bits.resize(filter_size_in_bits / 64);
+
+    uint64_t h1, h2;
+    get_hashes(item, h1, h2);
+    for (unsigned i = 0; i < GRAPHENE_NET_INVENTORY_FILTER_HASH_FUNCTIONS; ++i)
+    {
+      uint64_t bit = (h1 + i * h2) % filter_size_in_bits;
+      current->bits[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    ++current->item_count;
+  }
+
+  bool rolling_inventory_filter::contains(const item_id& item) const
+  {
+    uint64_t h1, h2;
+    get_hashes(item, h1, h2);
+    for (const generation& gen : _generations)
+    {
+      if (!gen.item_count)
+        continue;
+      unsigned i = 0;
+      for (; i < GRAPHENE_NET_INVENTORY_FILTER_HASH_FUNCTIONS; ++i)
+      {
+        uint64_t bit = (h1 + i * h2) % filter_size_in_bits;
+        if (!(gen.bits[bit / 64] & (uint64_t(1) << (bit % 64))))
+          break;
+      }
+      if (i == GRAPHENE_NET_INVENTORY_FILTER_HASH_FUNCTIONS)
+        return true;
+    }
+    return false;
+  }
+
+  void rolling_inventory_filter::expire()
+  {
+    fc::time_point now = fc::time_point::now();
+    if (_generations[_current_generation].start_time + generation_duration() <= now)
+      start_new_generation(now);
+
+    // after an idle period the older generations can be past the window without having been reused yet
+    for (unsigned i = 0; i < generation_count; ++i)
+    {
+      generation& gen = _generations[i];
+      if (i != _current_generation && gen.item_count && gen.start_time + fc::microseconds(generation_duration().count() * 3) <= now)
+      {
+        std::fill(gen.bits.begin(), gen.bits.end(), 0);
+        gen.item_count = 0;
+      }
+    }
+  }
+
+  void rolling_inventory_filter::start_new_generation(const fc::time_point& now)
+  {
+    _current_generation = (_current_generation + 1) % generation_count;
+    generation& gen = _generations[_current_generation];
+    std::fill(gen.bits.begin(), gen.bits.end(), 0);
+    gen.item_count = 0;
+    gen.start_time = now;
+  }
+
+  void rolling_inventory_filter::clear()
+  {
+    for (generation& gen : _generations)
+    {
+      std::fill(gen.bits.begin(), gen.bits.end(), 0);
+      gen.item_count = 0;
+    }
+    _generations[_current_generation].start_time = fc::time_point::now();
+  }
+
+  size_t rolling_inventory_filter::size() const
+  {
+    size_t total = 0;
+    for (const generation& gen : _generations)
+      total += gen.item_count;
+    return total;
+  }
+
+  size_t rolling_inventory_filter::memory_usage() const
+  {
+    size_t total = sizeof(*this);
+    for (const generation& gen : _generations)
+      total += gen.bits.capacity() * sizeof(uint64_t);
+    return total;
+  }
+
+} } // graphene::net
@@ -28,8 +28,107 @@
 
 #include <graphene/net/stcp_socket.hpp>
 
+#include <openssl/evp.h>
+
 namespace graphene { namespace net {
 
+namespace
+{
+  // must be multiples of 16, the layer above pads everything it writes to 16 bytes
+  const size_t read_buffer_length = 64 * 1024;
+  const size_t max_record_size = 64 * 1024;
+  // the plaintext size as 4 little endian bytes, the rest is zero.  A whole aes block, so the
+  // records keep the stream aligned to 16 bytes like everything else on the wire
+  const size_t record_header_size = 16;
+
+  void write_record_header( char* header, uint32_t record_size )
+  {
+    memset(header, 0, record_header_size);
+    for (size_t i = 0; i < sizeof(record_size); ++i)
+      header[i] = (char)(record_size >> (8 * i));
+  }
+
+  uint32_t read_record_header( const char* header )
+  {
+    uint32_t record_size = 0;
+    for (size_t i = 0; i < sizeof(record_size); ++i)
+      record_size |= (uint32_t)(unsigned char)header[i] << (8 * i);
+    FC_ASSERT( std::all_of(header + sizeof(record_size), header + record_header_size, [](char c) { return c == 0; }),
+               "received a record header with reserved bytes set" );
+    return record_size;
+  }
+}
+
+namespace detail
+{
+  /**
+   *  AES-256-GCM for one direction of the connection.  Each record is encrypted under the
+   *  next value of a counter as nonce, so a record can't be replayed or reordered, and its
+   *  header is authenticated along with it.  OpenSSL picks the AES-NI code where available
+   */
+  class authenticated_cipher
+  {
+  public:
+    static const size_t tag_size = 16;
+
+    authenticated_cipher( const fc::sha256& key, bool encrypt ) :
+      _ctx(EVP_CIPHER_CTX_new())
+    {
+      FC_ASSERT( _ctx, "unable to allocate a cipher context" );
+      FC_ASSERT( EVP_CipherInit_ex(_ctx, EVP_aes_256_gcm(), nullptr, (const unsigned char*)key.data(), nullptr, encrypt ? 1 : 0) == 1,
+                 "unable to initialize aes-256-gcm" );
+    }
+    ~authenticated_cipher()
+    {
+      EVP_CIPHER_CTX_free(_ctx);
+    }
+
+    void begin_record( const char* header, size_t header_size )
+    {
+      unsigned char nonce[12] = {};
+      for (size_t i = 0; i < sizeof(_record_counter); ++i)
+        nonce[4 + i] = (unsigned char)(_record_counter >> (8 * i));
+      ++_record_counter;
+
+      int length = 0;
+      FC_ASSERT( EVP_CipherInit_ex(_ctx, nullptr, nullptr, nullptr, nonce, -1) == 1 &&
+                 EVP_CipherUpdate(_ctx, nullptr, &length, (const unsigned char*)header, (int)header_size) == 1,
+                 "unable to start a record" );
+    }
+
+    void update( const char* input, size_t size, char* output )
+    {
+      int length = 0;
+      FC_ASSERT( EVP_CipherUpdate(_ctx, (unsigned char*)output, &length, (const unsigned char*)input, (int)size) == 1 &&
+                 (size_t)length == size, "unable to encrypt or decrypt a record" );
+    }
+
+    /** for the sending direction, writes the tag of the record */
+    void finish_record( char* tag )
+    {
+      unsigned char no_output[16];
+      int length = 0;
+      FC_ASSERT( EVP_CipherFinal_ex(_ctx, no_output, &length) == 1 &&
+                 EVP_CIPHER_CTX_ctrl(_ctx, EVP_CTRL_GCM_GET_TAG, (int)tag_size, tag) == 1,
+                 "unable to finish a record" );
+    }
+
+    /** for the receiving direction, throws if the record isn't what the peer sent */
+    void verify_record( const char* tag )
+    {
+      unsigned char no_output[16];
+      int length = 0;
+      FC_ASSERT( EVP_CIPHER_CTX_ctrl(_ctx, EVP_CTRL_GCM_SET_TAG, (int)tag_size, const_cast<char*>(tag)) == 1 &&
+                 EVP_CipherFinal_ex(_ctx, no_output, &length) == 1,
+                 "received a record that failed authentication" );
+    }
+
+  private:
+    EVP_CIPHER_CTX* _ctx;
+    uint64_t        _record_counter = 0;
+  };
+}
+
 stcp_socket::stcp_socket(const std::string& cert_file)
    : _sock(cert_file)
 {
@@ -51,6 +150,8 @@ void stcp_socket::do_key_exchange()
   _sock.writesome( s.data, sizeof(fc::ecc::public_key_data) );
   fc::ecc::public_key_data rpub;
   _sock.readsome( rpub.data, sizeof(fc::ecc::public_key_data) );
+  _local_public_key = s;
+  _remote_public_key = rpub;
   _shared_secret = _priv_key.get_shared_secret( rpub );
   _send_aes.init( fc::sha256::hash( (char*)&_shared_secret, sizeof(_shared_secret) ),
                   fc::city_hash_crc_128((char*)&_shared_secret,sizeof(_shared_secret) ) );
@@ -69,26 +170,117 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
   _sock.bind(local_endpoint);
 }
 
+// each direction gets its own key, so the two record counters never use the same nonce under one key
+fc::sha256 stcp_socket::get_authenticated_key( const fc::ecc::public_key_data& sender_public_key ) const
+{
+  fc::sha256::encoder enc;
+  enc.write( (const char*)&_shared_secret, sizeof(_shared_secret) );
+  enc.write( sender_public_key.data, sizeof(sender_public_key.data) );
+  return enc.result();
+}
+
+void stcp_socket::start_authenticated_send()
+{
+  FC_ASSERT( !_sock.uses_ssl(), "ssl connections are not encrypted by stcp_socket" );
+  FC_ASSERT( !_send_cipher, "the sending direction is already authenticated" );
+  _send_cipher.reset(new detail::authenticated_cipher(get_authenticated_key(_local_public_key), true));
+}
+
+void stcp_socket::start_authenticated_receive( size_t bytes_to_reread )
+{
+  FC_ASSERT( !_sock.uses_ssl(), "ssl connections are not encrypted by stcp_socket" );
+  FC_ASSERT( !_recv_cipher, "the receiving direction is already authenticated" );
+  FC_ASSERT( bytes_to_reread <= _last_read_length, "only bytes of the last read can be read again" );
+  // the aes stream decrypted these 1:1, the raw bytes are still at the end of the read buffer
+  if (bytes_to_reread)
+    _reread_buffer.assign(_read_buffer.get() + _last_read_length - bytes_to_reread, _read_buffer.get() + _last_read_length);
+  _reread_begin = 0;
+  _recv_cipher.reset(new detail::authenticated_cipher(get_authenticated_key(_remote_public_key), false));
+}
+
+void stcp_socket::read_raw( char* buffer, size_t len )
+{
+  size_t buffered = std::min(len, _reread_buffer.size() - _reread_begin);
+  if (buffered)
+  {
+    memcpy(buffer, _reread_buffer.data() + _reread_begin, buffered);
+    _reread_begin += buffered;
+    if (_reread_begin == _reread_buffer.size())
+    {
+      _reread_buffer.clear();
+      _reread_begin = 0;
+    }
+  }
+  if (len > buffered)
+    _sock.read(buffer + buffered, len - buffered);
+}
+
+/**
+ *   Records are a 16 byte header holding the plaintext size, the ciphertext and the tag,
+ *   all multiples of 16 bytes.  A record is decrypted straight into the caller's buffer
+ *   when it fits, what doesn't is handed out by the next calls.
+ */
+size_t stcp_socket::read_authenticated( char* buffer, size_t len )
+{
+  if (_record_begin == _record_end)
+  {
+    char header[record_header_size];
+    read_raw(header, record_header_size);
+    uint32_t record_size = read_record_header(header);
+    FC_ASSERT( record_size > 0 && record_size <= max_record_size && (record_size % 16) == 0,
+               "received a record of invalid size ${size}", ("size", record_size) );
+
+    read_raw(_read_buffer.get(), record_size + detail::authenticated_cipher::tag_size);
+    _recv_cipher->begin_record(header, record_header_size);
+    if (record_size <= len)
+    {
+      _recv_cipher->update(_read_buffer.get(), record_size, buffer);
+      _recv_cipher->verify_record(_read_buffer.get() + record_size);
+      return record_size;
+    }
+
+    if (!_record_read_buffer)
+      _record_read_buffer.reset(new char[max_record_size]);
+    _recv_cipher->update(_read_buffer.get(), record_size, _record_read_buffer.get());
+    _recv_cipher->verify_record(_read_buffer.get() + record_size);
+    _record_begin = 0;
+    _record_end = record_size;
+  }
+
+  size_t bytes_to_copy = std::min(len, _record_end - _record_begin);
+  memcpy(buffer, _record_read_buffer.get() + _record_begin, bytes_to_copy);
+  _record_begin += bytes_to_copy;
+  return bytes_to_copy;
+}
+
 /**
  *   This method must read at least 16 bytes at a time from
  *   the underlying TCP socket so that it can decrypt them. It
  *   will buffer any left-over.
+ *
+ *   Up to 64 KiB are read and decrypted per call, callers that
+ *   buffer their input should ask for that much at once.
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
     assert( len > 0 && (len % 16) == 0 );
 
-    const size_t read_buffer_length = 4096;
     if (!_read_buffer)
-      _read_buffer.reset(new char[read_buffer_length]);
+      _read_buffer.reset(new char[std::max(read_buffer_length, max_record_size + detail::authenticated_cipher::tag_size)]);
+
+    if (_recv_cipher)
+      return read_authenticated(buffer, len);
 
     len = std::min(read_buffer_length, len);
     size_t s = _sock.readsome(_read_buffer.get(), len);
+    // this may read into the records following a switch to authenticated records, they are
+    // multiples of 16 bytes too, so the rest of the block is on its way
     if( s % 16 )
     {
       _sock.read(_read_buffer.get() + s, 16 - (s%16));
       s += 16-(s%16);
     }
+    _last_read_length = s;
 
     if (_sock.uses_ssl())
       memcpy(buffer, _read_buffer.get(), std::min(s, len));
@@ -111,18 +303,115 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
       return len;
     }
 
-    const std::size_t write_buffer_length = 4096;
+    if (_send_cipher)
+    {
+      len = std::min(max_record_size, len);
+      write_authenticated({{buffer, len}});
+      return len;
+    }
+
+    const std::size_t write_buffer_length = 64 * 1024;
     if (!_write_buffer)
       _write_buffer.reset(new char[write_buffer_length]);
 
     len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
     uint32_t ciphertext_len = _send_aes.encode(buffer, static_cast<uint32_t>(len), _write_buffer.get());
     assert(ciphertext_len == len);
     _sock.write(_write_buffer.get(), ciphertext_len);
     return ciphertext_len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
+void stcp_socket::write_gather( const std::vector<gather_buffer>& buffers )
+{ try {
+    if (_sock.uses_ssl())
+    {
+      for (const gather_buffer& buffer : buffers)
+        if (buffer.size)
+          _sock.write(buffer.data, buffer.size);
+      return;
+    }
+
+    if (_send_cipher)
+    {
+      write_authenticated(buffers);
+      return;
+    }
+
+    // must be a multiple of 16 so that every chunk but the last one is a whole number of aes blocks
+    const size_t gather_chunk_length = 64 * 1024;
+    if (!_gather_plaintext_buffer)
+    {
+      _gather_plaintext_buffer.reset(new char[gather_chunk_length]);
+      _gather_ciphertext_buffer.reset(new char[gather_chunk_length]);
+    }
+
+    size_t chunk_length = 0;
+    auto encrypt_and_write_chunk = [&]() {
+      uint32_t ciphertext_len = _send_aes.encode(_gather_plaintext_buffer.get(), static_cast<uint32_t>(chunk_length),
+                                                 _gather_ciphertext_buffer.get());
+      assert(ciphertext_len == chunk_length);
+      _sock.write(_gather_ciphertext_buffer.get(), ciphertext_len);
+      chunk_length = 0;
+    };
+
+    for (const gather_buffer& buffer : buffers)
+      for (size_t offset = 0; offset < buffer.size;)
+      {
+        size_t bytes_to_copy = std::min(buffer.size - offset, gather_chunk_length - chunk_length);
+        memcpy(_gather_plaintext_buffer.get() + chunk_length, buffer.data + offset, bytes_to_copy);
+        chunk_length += bytes_to_copy;
+        offset += bytes_to_copy;
+        if (chunk_length == gather_chunk_length)
+          encrypt_and_write_chunk();
+      }
+
+    assert((chunk_length % 16) == 0);
+    if (chunk_length)
+      encrypt_and_write_chunk();
+} FC_RETHROW_EXCEPTIONS( warn, "", ("buffers",buffers.size()) ) }
+
+// the buffers are encrypted straight into the record, without joining them first
+void stcp_socket::write_authenticated( const std::vector<gather_buffer>& buffers )
+{
+  const size_t record_buffer_length = record_header_size + max_record_size + detail::authenticated_cipher::tag_size;
+  if (!_record_write_buffer)
+    _record_write_buffer.reset(new char[record_buffer_length]);
+  char* record = _record_write_buffer.get();
+
+  size_t bytes_left = 0;
+  for (const gather_buffer& buffer : buffers)
+    bytes_left += buffer.size;
+  assert((bytes_left % 16) == 0);
+
+  auto buffer_iter = buffers.begin();
+  size_t buffer_offset = 0;
+  while (bytes_left)
+  {
+    uint32_t record_size = static_cast<uint32_t>(std::min(bytes_left, max_record_size));
+    write_record_header(record, record_size);
+    _send_cipher->begin_record(record, record_header_size);
+
+    size_t record_end = record_header_size;
+    while (record_end < record_header_size + record_size)
+    {
+      size_t bytes_to_encrypt = std::min(buffer_iter->size - buffer_offset, record_header_size + record_size - record_end);
+      if (bytes_to_encrypt)
+        _send_cipher->update(buffer_iter->data + buffer_offset, bytes_to_encrypt, record + record_end);
+      record_end += bytes_to_encrypt;
+      buffer_offset += bytes_to_encrypt;
+      if (buffer_offset == buffer_iter->size)
+      {
+        ++buffer_iter;
+        buffer_offset = 0;
+      }
+    }
+
+    _send_cipher->finish_record(record + record_end);
+    _sock.write(record, record_end + detail::authenticated_cipher::tag_size);
+    bytes_left -= record_size;
+  }
+}
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -0,0 +1,91 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/net/traffic_statistics.hpp>
+
+namespace graphene { namespace net {
+
+  namespace
+  {
+    uint64_t current_bucket_number()
+    {
+      return fc::time_point::now().sec_since_epoch() / GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKET_SECONDS;
+    }
+  }
+
+  void message_type_traffic::add(const message_type_traffic& other)
+  {
+    messages_received += other.messages_received;
+    bytes_received += other.bytes_received;
+    messages_sent += other.messages_sent;
+    bytes_sent += other.bytes_sent;
+    queueing_delay_us += other.queueing_delay_us;
+    processing_time_us += other.processing_time_us;
+  }
+
+  template<typename Update>
+  void traffic_statistics::update(uint32_t message_type, Update update_traffic)
+  {
+    uint64_t bucket_number = current_bucket_number();
+    if (_buckets.empty() || _buckets.back().number != bucket_number)
+      _buckets.push_back(bucket{bucket_number, {}});
+    while (_buckets.front().number + GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKETS <= bucket_number)
+      _buckets.pop_front();
+
+    for (std::map<uint32_t, message_type_traffic>* traffic_by_type : { &_buckets.back().traffic, &_total_traffic })
+    {
+      message_type_traffic& traffic = (*traffic_by_type)[message_type];
+      traffic.message_type = message_type;
+      update_traffic(traffic);
+    }
+  }
+
+  void traffic_statistics::message_received(uint32_t message_type, size_t bytes)
+  {
+    update(message_type, [bytes](message_type_traffic& traffic) {
+      ++traffic.messages_received;
+      traffic.bytes_received += bytes;
+    });
+  }
+
+  void traffic_statistics::message_sent(uint32_t message_type, size_t bytes)
+  {
+    update(message_type, [bytes](message_type_traffic& traffic) {
+      ++traffic.messages_sent;
+      traffic.bytes_sent += bytes;
+    });
+  }
+
+  void traffic_statistics::add_queueing_delay(uint32_t message_type, const fc::microseconds& delay)
+  {
+    update(message_type, [&delay](message_type_traffic& traffic) {
+      traffic.queueing_delay_us += delay.count();
+    });
+  }
+
+  void traffic_statistics::add_processing_time(uint32_t message_type, const fc::microseconds& processing_time)
+  {
+    update(message_type, [&processing_time](message_type_traffic& traffic) {
+      traffic.processing_time_us += processing_time.count();
+    });
+  }
+
+  std::vector<message_type_traffic> traffic_statistics::get_recent_traffic() const
+  {
+    uint64_t bucket_number = current_bucket_number();
+    std::map<uint32_t, message_type_traffic> recent_traffic;
+    for (const bucket& b : _buckets)
+      if (b.number + GRAPHENE_NET_TRAFFIC_STATISTICS_BUCKETS > bucket_number)
+        for (const auto& type_and_traffic : b.traffic)
+        {
+          message_type_traffic& traffic = recent_traffic[type_and_traffic.first];
+          traffic.message_type = type_and_traffic.first;
+          traffic.add(type_and_traffic.second);
+        }
+
+    std::vector<message_type_traffic> result;
+    result.reserve(recent_traffic.size());
+    for (const auto& type_and_traffic : recent_traffic)
+      result.push_back(type_and_traffic.second);
+    return result;
+  }
+
+} } // graphene::net
@@ -237,6 +237,11 @@ int main_internal(int argc, char** argv, bool run_as_daemon = false)
 #else
          ("daemon", "Run DECENT as daemon")
 #endif
+         ("replay-timing", "Keep execution times of block phases and operations for the whole replay (up to 1M samples each) instead of the sliding window only")
+         ("export-snapshot", bpo::value<boost::filesystem::path>(), "Export the state at the last irreversible block to a snapshot file and exit")
+         ("import-snapshot", bpo::value<boost::filesystem::path>(), "Initialize an empty database from a state snapshot file instead of the genesis state, the file is needed again to replay the blockchain")
+         ("prevalidation-threads", bpo::value<uint32_t>(), "Number of threads pre-validating block transactions besides the database thread, 0 to use the database thread only (default: number of cores - 1)")
+         ("trusted-block", bpo::value<std::string>(), "Id of a trusted block in the local block database, the blocks leading to it are replayed with the trusted replay profile skipping most of the checks")
       ;
 
       bpo::parsed_options optparsed = bpo::command_line_parser(argc, argv).options(app_options).allow_unregistered().run();
@@ -375,7 +380,25 @@ int main_internal(int argc, char** argv, bool run_as_daemon = false)
       node->initialize(data_dir, options);
       node->initialize_plugins( options );
 
+      if( options.count("replay-timing") )
+         node->chain_database()->get_apply_timing().set_record_replay(true);
+      if( options.count("prevalidation-threads") )
+         node->chain_database()->set_prevalidation_threads(options["prevalidation-threads"].as<uint32_t>());
+      if( options.count("trusted-block") )
+         node->chain_database()->node_properties().trusted_block_id = graphene::chain::block_id_type(options["trusted-block"].as<std::string>());
+      if( options.count("import-snapshot") )
+         node->chain_database()->set_state_snapshot_to_import(options["import-snapshot"].as<boost::filesystem::path>());
+
       node->startup();
+
+      if( options.count("export-snapshot") )
+      {
+         node->chain_database()->export_state_snapshot(options["export-snapshot"].as<boost::filesystem::path>());
+         monitoring::monitoring_counters_base::stop_monitoring_thread();
+         node->shutdown();
+         delete node;
+         return EXIT_SUCCESS;
+      }
       node->startup_plugins();
 
 #if defined(_MSC_VER)
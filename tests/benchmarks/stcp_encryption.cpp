@@ -0,0 +1,93 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/log/logger.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <cstring>
+
+using namespace graphene::net;
+
+namespace {
+
+#ifdef NDEBUG
+   const size_t bytes_per_run = 1024 * 1024 * 1024;
+#else
+   const size_t bytes_per_run = 64 * 1024 * 1024;
+#endif
+   // what message_oriented_connection hands to the socket at most per read and gathered write
+   const size_t chunk_size = 64 * 1024;
+
+   // sends bytes_per_run bytes from sender to receiver over loopback, returns MiB/s
+   double measure_throughput( stcp_socket& sender, stcp_socket& receiver )
+   {
+      std::vector<char> send_buffer( chunk_size );
+      for( size_t i = 0; i < send_buffer.size(); ++i )
+         send_buffer[i] = char( i % 251 );
+
+      size_t mismatches = 0;
+      fc::future<void> receiving = fc::async( [&]() {
+         std::vector<char> receive_buffer( chunk_size );
+         size_t received = 0;
+         while( received < bytes_per_run )
+         {
+            size_t bytes_read = receiver.readsome( receive_buffer.data(), receive_buffer.size() );
+            // the stream repeats send_buffer, compare up to where it wraps around and from its start after that
+            size_t offset = received % chunk_size;
+            size_t first_part = std::min( bytes_read, chunk_size - offset );
+            if( memcmp( receive_buffer.data(), send_buffer.data() + offset, first_part ) ||
+                memcmp( receive_buffer.data() + first_part, send_buffer.data(), bytes_read - first_part ) )
+               ++mismatches;
+            received += bytes_read;
+         }
+      }, "stcp_encryption_bench receive" );
+
+      fc::time_point start_time = fc::time_point::now();
+      for( size_t sent = 0; sent < bytes_per_run; sent += chunk_size )
+         sender.write_gather( { { send_buffer.data(), send_buffer.size() } } );
+      sender.flush();
+      receiving.wait();
+      fc::microseconds duration = fc::time_point::now() - start_time;
+
+      BOOST_CHECK_EQUAL( mismatches, 0u );
+      return double( bytes_per_run ) / ( 1024 * 1024 ) / ( double( duration.count() ) / 1000000 );
+   }
+
+}
+
+BOOST_AUTO_TEST_CASE( stcp_encryption_bench )
+{
+   try {
+      fc::tcp_server listener;
+      listener.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+
+      stcp_socket client( "" );
+      stcp_socket server( "" );
+      fc::future<void> accepted = fc::async( [&]() {
+         listener.accept( server.get_socket() );
+         server.accept();
+      }, "stcp_encryption_bench accept" );
+      client.connect_to( listener.get_local_endpoint() );
+      accepted.wait();
+
+      // the aes stream set up by the key exchange
+      double stream_throughput = measure_throughput( client, server );
+
+      // everything sent before was read, so nothing has to be read again
+      client.start_authenticated_send();
+      server.start_authenticated_receive( 0 );
+      double gcm_throughput = measure_throughput( client, server );
+
+      ilog( "${n} MiB over one loopback connection: aes stream ${s} MiB/s, aes-256-gcm records ${g} MiB/s",
+            ("n", bytes_per_run / ( 1024 * 1024 ))("s", uint64_t( stream_throughput ))("g", uint64_t( gcm_throughput )) );
+
+      client.close();
+      server.close();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
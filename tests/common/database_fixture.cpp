@@ -79,18 +79,7 @@ database_fixture::database_fixture()
 
      boost::program_options::variables_map options;
 
-     genesis_state.initial_timestamp = fc::time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
-
-     genesis_state.initial_active_miners = 10;
-     for( int i = 0; i < (int)genesis_state.initial_active_miners; ++i )
-     {
-        auto name = "init"+fc::to_string(i);
-        genesis_state.initial_accounts.emplace_back(name,
-                                                    init_account_priv_key.get_public_key(),
-                                                    init_account_priv_key.get_public_key());
-        genesis_state.initial_miner_candidates.push_back({name, init_account_priv_key.get_public_key()});
-     }
-     genesis_state.initial_parameters.current_fees->zero_all_fees();
+     genesis_state = test::make_test_genesis();
      open_database();
      // app.initialize();
      ahplugin->plugin_initialize(options);
@@ -874,6 +863,32 @@ void set_expiration( const database& db, transaction& tx )
    return;
 }
 
+genesis_state_type make_test_genesis()
+{
+   genesis_state_type genesis_state;
+
+   genesis_state.initial_timestamp = fc::time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+
+   auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("null_key")));
+   genesis_state.initial_active_miners = 10;
+   for( int i = 0; i < (int)genesis_state.initial_active_miners; ++i )
+   {
+      auto name = "init"+fc::to_string(i);
+      genesis_state.initial_accounts.emplace_back(name,
+                                                  init_account_priv_key.get_public_key(),
+                                                  init_account_priv_key.get_public_key());
+      genesis_state.initial_miner_candidates.push_back({name, init_account_priv_key.get_public_key()});
+   }
+   genesis_state.initial_parameters.current_fees->zero_all_fees();
+   return genesis_state;
+}
+
+signed_block generate_block( database& db )
+{
+   static const fc::ecc::private_key init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("null_key")));
+   return db.generate_block( db.get_slot_time(1), db.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing );
+}
+
 bool _push_block( database& db, const signed_block& b, uint32_t skip_flags /* = 0 */ )
 {
    return db.push_block( b, skip_flags);
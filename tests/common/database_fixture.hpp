@@ -307,6 +307,11 @@ namespace test {
 /// set a reasonable expiration time for the transaction
 void set_expiration( const database& db, transaction& tx );
 
+/// the genesis of the test chain, ten miners init0 to init9 with the null_key and zero fees
+genesis_state_type make_test_genesis();
+/// generates the next block of a database opened with make_test_genesis()
+signed_block generate_block( database& db );
+
 bool _push_block( database& db, const signed_block& b, uint32_t skip_flags = 0 );
 processed_transaction _push_transaction( database& db, const signed_transaction& tx, uint32_t skip_flags = 0 );
 }
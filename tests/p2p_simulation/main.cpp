@@ -0,0 +1,523 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+/**
+ *  Runs a network of graphene::net::node instances in one process and measures how fast
+ *  blocks and transactions propagate through it.
+ *
+ *  Every node gets a simulated_chain as its delegate.  The nodes connect to each other
+ *  through shaped_links, which add latency, limit bandwidth and simulate lost segments.
+ *  The run has two phases:
+ *    - sync: the first node starts with a chain of --sync-blocks blocks, the others sync it
+ *    - relay: random nodes produce --blocks blocks every --block-interval-ms and inject
+ *      --transactions-per-second transactions
+ *  followed by a report of the propagation delays, the bandwidth used by every node and
+ *  the cpu time used per item delivered.
+ */
+#include "simulated_chain.hpp"
+#include "shaped_link.hpp"
+
+#include <graphene/net/node.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+
+using namespace graphene::net;
+using namespace graphene::net::simulation;
+
+namespace bpo = boost::program_options;
+
+namespace {
+
+   struct simulation_options
+   {
+      uint32_t   node_count;
+      uint32_t   connections_per_node;
+      link_shape shape;
+      uint32_t   sync_block_count;
+      uint32_t   block_count;
+      uint32_t   block_interval_ms;
+      uint32_t   transactions_per_second;
+      uint32_t   transaction_size;
+      uint32_t   max_transactions_per_block;
+      uint32_t   settle_time_ms;
+      uint32_t   sync_timeout_seconds;
+      uint32_t   random_seed;
+   };
+
+   struct simulated_node
+   {
+      std::unique_ptr<fc::temp_directory> data_directory;
+      std::unique_ptr<simulated_chain>    chain;
+      node_ptr                            p2p_node;
+      fc::ip::endpoint                    listening_endpoint;
+      uint32_t                            incoming_link_count = 0;
+      uint32_t                            outgoing_link_count = 0;
+      fc::optional<fc::time_point>        sync_finished_time;
+      uint64_t                            items_received = 0;
+   };
+
+   struct simulated_link
+   {
+      uint32_t                     from_node;
+      uint32_t                     to_node;
+      std::unique_ptr<shaped_link> link;
+   };
+
+   /** when an injected item was created and how long each other node took to receive it */
+   struct propagation_record
+   {
+      fc::time_point       injected_time;
+      uint32_t             origin_node;
+      std::vector<int64_t> delays_us;
+   };
+
+   struct propagation_summary
+   {
+      uint64_t items = 0;
+      uint64_t deliveries = 0;
+      uint64_t expected_deliveries = 0;
+      std::vector<int64_t> delays_us;
+
+      void add(const propagation_record& record, uint32_t node_count)
+      {
+         ++items;
+         deliveries += record.delays_us.size();
+         expected_deliveries += node_count - 1;
+         delays_us.insert(delays_us.end(), record.delays_us.begin(), record.delays_us.end());
+      }
+
+      double percentile_ms(unsigned percent) const
+      {
+         if (delays_us.empty())
+            return 0;
+         size_t index = std::min(delays_us.size() - 1, delays_us.size() * percent / 100);
+         return delays_us[index] / 1000.0;
+      }
+
+      fc::variant_object to_variant() const
+      {
+         fc::mutable_variant_object result;
+         result["items"] = items;
+         result["coverage"] = expected_deliveries ? (double)deliveries / expected_deliveries : 1.0;
+         result["p50_ms"] = percentile_ms(50);
+         result["p90_ms"] = percentile_ms(90);
+         result["p99_ms"] = percentile_ms(99);
+         result["max_ms"] = delays_us.empty() ? 0.0 : delays_us.back() / 1000.0;
+         return result;
+      }
+   };
+
+   class network_simulation
+   {
+   public:
+      explicit network_simulation(const simulation_options& options);
+      ~network_simulation();
+
+      void start();
+      void run_sync_phase();
+      void run_relay_phase();
+      fc::variant_object report();
+      void stop();
+
+   private:
+      void create_topology();
+      void on_item_received(uint32_t node_index, const item_id& item, const fc::time_point& receive_time);
+      void inject_transaction();
+      void produce_block();
+
+      simulation_options                         _options;
+      std::mt19937                               _random_generator;
+      fc::thread                                 _link_thread;
+      std::vector<simulated_node>                _nodes;
+      std::vector<simulated_link>                _links;
+      std::map<item_hash_t, propagation_record>  _block_propagation;
+      std::map<item_hash_t, propagation_record>  _transaction_propagation;
+      uint32_t                                   _transactions_injected = 0;
+      fc::time_point                             _start_time;
+      fc::time_point                             _sync_start_time;
+      std::clock_t                               _start_cpu_time = 0;
+   };
+
+   network_simulation::network_simulation(const simulation_options& options) :
+      _options(options),
+      _random_generator(options.random_seed),
+      _link_thread("link_shaper")
+   {
+      _nodes.resize(_options.node_count);
+   }
+
+   network_simulation::~network_simulation()
+   {
+      stop();
+   }
+
+   void network_simulation::create_topology()
+   {
+      // a ring keeps the network connected, random links are added until every node
+      // has opened connections_per_node links (or linked to everyone)
+      std::set<std::pair<uint32_t, uint32_t>> linked_nodes;
+      auto add_link = [&](uint32_t from_node, uint32_t to_node) {
+         if (from_node == to_node ||
+             linked_nodes.count(std::make_pair(std::min(from_node, to_node), std::max(from_node, to_node))))
+            return false;
+         linked_nodes.insert(std::make_pair(std::min(from_node, to_node), std::max(from_node, to_node)));
+         _links.push_back(simulated_link{from_node, to_node, nullptr});
+         ++_nodes[from_node].outgoing_link_count;
+         ++_nodes[to_node].incoming_link_count;
+         return true;
+      };
+
+      uint32_t node_count = _options.node_count;
+      if (node_count > 1)
+         for (uint32_t i = 0; i < node_count; ++i)
+            add_link(i, (i + 1) % node_count);
+
+      std::uniform_int_distribution<uint32_t> random_node(0, node_count - 1);
+      for (uint32_t i = 0; i < node_count; ++i)
+         for (uint32_t attempt = 0; _nodes[i].outgoing_link_count < _options.connections_per_node && attempt < 10 * node_count; ++attempt)
+            add_link(i, random_node(_random_generator));
+   }
+
+   void network_simulation::start()
+   {
+      chain_id_type chain_id = fc::sha256::hash(std::string("p2p_simulation"));
+      uint8_t block_interval_in_seconds = (uint8_t)std::max<uint32_t>(1, _options.block_interval_ms / 1000);
+      fc::time_point_sec now = fc::time_point::now();
+      fc::time_point_sec genesis_time = now - _options.sync_block_count * block_interval_in_seconds - 1;
+
+      for (uint32_t i = 0; i < _options.node_count; ++i)
+      {
+         simulated_node& n = _nodes[i];
+         n.data_directory.reset(new fc::temp_directory());
+         n.chain.reset(new simulated_chain(chain_id, genesis_time, block_interval_in_seconds, 2 * 1024 * 1024));
+         n.chain->on_item_received = [this, i](const item_id& item, const fc::time_point& receive_time) {
+            on_item_received(i, item, receive_time);
+         };
+      }
+
+      for (uint32_t block_num = 1; block_num <= _options.sync_block_count; ++block_num)
+         _nodes[0].chain->produce_block(genesis_time + block_num * block_interval_in_seconds, 0);
+
+      create_topology();
+
+      for (simulated_node& n : _nodes)
+      {
+         n.p2p_node = std::make_shared<node>("p2p_simulation", "", "", "", "");
+         n.p2p_node->load_configuration(n.data_directory->path());
+         n.p2p_node->set_node_delegate(n.chain.get(), 2 * 1024 * 1024);
+         n.p2p_node->disable_peer_advertising();
+
+         // the node would stop opening its links once enough peers connected to it
+         fc::mutable_variant_object params;
+         params["desired_number_of_connections"] = n.incoming_link_count + n.outgoing_link_count;
+         params["maximum_number_of_connections"] = n.incoming_link_count + n.outgoing_link_count + 8;
+         n.p2p_node->set_advanced_node_parameters(params);
+
+         n.p2p_node->listen_on_endpoint(fc::ip::endpoint(fc::ip::address("127.0.0.1"), 0), false);
+         n.p2p_node->accept_incoming_connections(true);
+         n.p2p_node->listen_to_p2p_network();
+         n.listening_endpoint = n.p2p_node->get_actual_listening_endpoint();
+      }
+
+      uint32_t link_seed = _options.random_seed;
+      for (simulated_link& l : _links)
+      {
+         fc::ip::endpoint target_endpoint = _nodes[l.to_node].listening_endpoint;
+         uint32_t seed = ++link_seed;
+         l.link.reset(_link_thread.async([&]() {
+            return new shaped_link(target_endpoint, _options.shape, seed);
+         }, "create shaped_link").wait());
+      }
+
+      _start_time = fc::time_point::now();
+      _start_cpu_time = std::clock();
+
+      for (simulated_node& n : _nodes)
+         n.p2p_node->connect_to_p2p_network();
+      for (simulated_link& l : _links)
+      {
+         fc::ip::endpoint link_endpoint = _link_thread.async([&]() { return l.link->get_listening_endpoint(); }).wait();
+         _nodes[l.from_node].p2p_node->add_node(link_endpoint);
+         _nodes[l.from_node].p2p_node->connect_to_endpoint(link_endpoint);
+      }
+   }
+
+   void network_simulation::on_item_received(uint32_t node_index, const item_id& item, const fc::time_point& receive_time)
+   {
+      simulated_node& n = _nodes[node_index];
+      ++n.items_received;
+
+      std::map<item_hash_t, propagation_record>& propagation = item.item_type == block_message_type ? _block_propagation
+                                                                                                   : _transaction_propagation;
+      auto itr = propagation.find(item.item_hash);
+      if (itr != propagation.end() && itr->second.origin_node != node_index)
+         itr->second.delays_us.push_back((receive_time - itr->second.injected_time).count());
+
+      if (!n.sync_finished_time && n.chain->head_block_num() >= _options.sync_block_count)
+         n.sync_finished_time = receive_time;
+   }
+
+   void network_simulation::run_sync_phase()
+   {
+      _sync_start_time = fc::time_point::now();
+      _nodes[0].sync_finished_time = _sync_start_time;
+      for (simulated_node& n : _nodes)
+         n.p2p_node->sync_from(item_id(block_message_type, n.chain->get_head_block_id()), std::vector<uint32_t>());
+
+      fc::time_point deadline = _sync_start_time + fc::seconds(_options.sync_timeout_seconds);
+      while (fc::time_point::now() < deadline &&
+             std::any_of(_nodes.begin(), _nodes.end(), [](const simulated_node& n) { return !n.sync_finished_time; }))
+         fc::usleep(fc::milliseconds(100));
+   }
+
+   void network_simulation::inject_transaction()
+   {
+      uint32_t origin_node = std::uniform_int_distribution<uint32_t>(0, _options.node_count - 1)(_random_generator);
+
+      signed_transaction trx;
+      trx.ref_block_num = (uint16_t)origin_node;
+      trx.ref_block_prefix = ++_transactions_injected;
+      trx.expiration = fc::time_point_sec(fc::time_point::now()) + 3600;
+      // random signatures pad the transaction to the requested size without making it compressible
+      trx.signatures.resize(std::max<uint32_t>(1, _options.transaction_size / sizeof(graphene::chain::signature_type)));
+      std::uniform_int_distribution<uint32_t> random_byte(0, 255);
+      for (graphene::chain::signature_type& signature : trx.signatures)
+         for (unsigned char& byte : signature.data)
+            byte = (unsigned char)random_byte(_random_generator);
+
+      trx_message transaction_to_broadcast = _nodes[origin_node].chain->add_local_transaction(trx);
+      propagation_record& record = _transaction_propagation[message(transaction_to_broadcast).id()];
+      record.injected_time = fc::time_point::now();
+      record.origin_node = origin_node;
+      _nodes[origin_node].p2p_node->broadcast(transaction_to_broadcast);
+   }
+
+   void network_simulation::produce_block()
+   {
+      // only nodes on the longest chain produce, the simulated chains can't switch forks
+      uint32_t head_block_num = 0;
+      for (const simulated_node& n : _nodes)
+         head_block_num = std::max(head_block_num, n.chain->head_block_num());
+      std::vector<uint32_t> producers;
+      for (uint32_t i = 0; i < _options.node_count; ++i)
+         if (_nodes[i].chain->head_block_num() == head_block_num)
+            producers.push_back(i);
+      uint32_t producer = producers[std::uniform_int_distribution<size_t>(0, producers.size() - 1)(_random_generator)];
+
+      block_message block_to_broadcast = _nodes[producer].chain->produce_block(fc::time_point::now(), _options.max_transactions_per_block);
+      propagation_record& record = _block_propagation[block_to_broadcast.block_id];
+      record.injected_time = fc::time_point::now();
+      record.origin_node = producer;
+      _nodes[producer].p2p_node->broadcast(block_to_broadcast);
+   }
+
+   void network_simulation::run_relay_phase()
+   {
+      fc::time_point relay_start_time = fc::time_point::now();
+      fc::time_point next_block_time = relay_start_time + fc::milliseconds(_options.block_interval_ms);
+      uint32_t blocks_produced = 0;
+      while (blocks_produced < _options.block_count)
+      {
+         fc::usleep(fc::milliseconds(10));
+         fc::time_point now = fc::time_point::now();
+
+         uint64_t elapsed_us = (now - relay_start_time).count();
+         uint64_t transactions_due = elapsed_us * _options.transactions_per_second / 1000000;
+         while (_transactions_injected < transactions_due)
+            inject_transaction();
+
+         if (now >= next_block_time)
+         {
+            produce_block();
+            ++blocks_produced;
+            next_block_time += fc::milliseconds(_options.block_interval_ms);
+         }
+      }
+
+      // let the last items reach everyone
+      fc::usleep(fc::milliseconds(_options.settle_time_ms));
+   }
+
+   fc::variant_object network_simulation::report()
+   {
+      double elapsed_seconds = (fc::time_point::now() - _start_time).count() / 1000000.0;
+      double cpu_seconds = double(std::clock() - _start_cpu_time) / CLOCKS_PER_SEC;
+
+      std::cout << std::fixed << std::setprecision(1);
+      std::cout << "nodes: " << _options.node_count << ", links: " << _links.size()
+                << ", latency: " << _options.shape.latency_ms << " ms"
+                << ", bandwidth: " << (_options.shape.bytes_per_second ? std::to_string(_options.shape.bytes_per_second / 1024) + " KiB/s" : std::string("unlimited"))
+                << ", loss: " << _options.shape.loss_rate * 100 << "%\n\n";
+
+      fc::mutable_variant_object result;
+
+      std::vector<int64_t> sync_times_us;
+      for (const simulated_node& n : _nodes)
+         if (n.sync_finished_time)
+            sync_times_us.push_back((*n.sync_finished_time - _sync_start_time).count());
+      std::sort(sync_times_us.begin(), sync_times_us.end());
+      double slowest_sync_seconds = sync_times_us.empty() ? 0 : sync_times_us.back() / 1000000.0;
+      std::cout << "sync of " << _options.sync_block_count << " blocks: " << sync_times_us.size() << "/" << _options.node_count
+                << " nodes synced, slowest after " << slowest_sync_seconds << " s";
+      if (slowest_sync_seconds > 0)
+         std::cout << " (" << _options.sync_block_count / slowest_sync_seconds << " blocks/s)";
+      std::cout << "\n";
+      fc::mutable_variant_object sync_result;
+      sync_result["blocks"] = _options.sync_block_count;
+      sync_result["nodes_synced"] = sync_times_us.size();
+      sync_result["slowest_seconds"] = slowest_sync_seconds;
+      result["sync"] = sync_result;
+
+      auto report_propagation = [&](const char* name, const std::map<item_hash_t, propagation_record>& propagation) {
+         propagation_summary summary;
+         for (const auto& item_and_record : propagation)
+            summary.add(item_and_record.second, _options.node_count);
+         std::sort(summary.delays_us.begin(), summary.delays_us.end());
+         fc::variant_object summary_variant = summary.to_variant();
+         std::cout << name << " propagation: " << summary.items << " items, "
+                   << summary_variant["coverage"].as<double>() * 100 << "% delivered, "
+                   << "p50 " << summary.percentile_ms(50) << " ms, p90 " << summary.percentile_ms(90)
+                   << " ms, p99 " << summary.percentile_ms(99) << " ms, max " << summary_variant["max_ms"].as<double>() << " ms\n";
+         result[name] = summary_variant;
+      };
+      report_propagation("block", _block_propagation);
+      report_propagation("transaction", _transaction_propagation);
+
+      std::vector<uint64_t> bytes_sent(_options.node_count), bytes_received(_options.node_count);
+      for (const simulated_link& l : _links)
+      {
+         uint64_t bytes_to_target = _link_thread.async([&]() { return l.link->get_bytes_to_target(); }).wait();
+         uint64_t bytes_from_target = _link_thread.async([&]() { return l.link->get_bytes_from_target(); }).wait();
+         bytes_sent[l.from_node] += bytes_to_target;
+         bytes_received[l.to_node] += bytes_to_target;
+         bytes_sent[l.to_node] += bytes_from_target;
+         bytes_received[l.from_node] += bytes_from_target;
+      }
+
+      std::cout << "\nnode  links  sent KiB/s  received KiB/s  items received\n";
+      fc::variants node_results;
+      uint64_t total_items_received = 0;
+      for (uint32_t i = 0; i < _options.node_count; ++i)
+      {
+         double sent_rate = bytes_sent[i] / 1024.0 / elapsed_seconds;
+         double received_rate = bytes_received[i] / 1024.0 / elapsed_seconds;
+         std::cout << std::setw(4) << i << std::setw(7) << _nodes[i].incoming_link_count + _nodes[i].outgoing_link_count
+                   << std::setw(12) << sent_rate << std::setw(16) << received_rate
+                   << std::setw(16) << _nodes[i].items_received << "\n";
+         total_items_received += _nodes[i].items_received;
+
+         fc::mutable_variant_object node_result;
+         node_result["connections"] = _nodes[i].p2p_node->get_connection_count();
+         node_result["bytes_sent"] = bytes_sent[i];
+         node_result["bytes_received"] = bytes_received[i];
+         node_result["items_received"] = _nodes[i].items_received;
+         node_results.push_back(fc::variant(node_result));
+      }
+      result["nodes"] = node_results;
+
+      double cpu_us_per_item = total_items_received ? cpu_seconds * 1000000 / total_items_received : 0;
+      std::cout << "\ncpu: " << cpu_seconds << " s in " << elapsed_seconds << " s, "
+                << cpu_us_per_item << " us per item received\n";
+      result["elapsed_seconds"] = elapsed_seconds;
+      result["cpu_seconds"] = cpu_seconds;
+      result["cpu_us_per_item_received"] = cpu_us_per_item;
+      return result;
+   }
+
+   void network_simulation::stop()
+   {
+      for (simulated_node& n : _nodes)
+         if (n.p2p_node)
+         {
+            try
+            {
+               n.p2p_node->close();
+            }
+            catch (const fc::exception& e)
+            {
+               wlog("error closing node: ${e}", ("e", e.to_detail_string()));
+            }
+            n.p2p_node.reset();
+         }
+      for (simulated_link& l : _links)
+         if (l.link)
+            _link_thread.async([&]() { l.link.reset(); }, "destroy shaped_link").wait();
+   }
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      simulation_options options;
+      double loss_percent = 0;
+      uint64_t bandwidth_kib = 0;
+      std::string json_report_filename;
+
+      bpo::options_description description("Simulates a network of p2p nodes in one process and measures block and transaction propagation");
+      description.add_options()
+         ("help,h", "Print this help message and exit")
+         ("nodes", bpo::value<uint32_t>(&options.node_count)->default_value(10), "Number of nodes")
+         ("connections-per-node", bpo::value<uint32_t>(&options.connections_per_node)->default_value(3), "Number of links each node opens to random other nodes")
+         ("latency-ms", bpo::value<uint32_t>(&options.shape.latency_ms)->default_value(50), "One way latency of every link")
+         ("bandwidth-kib", bpo::value<uint64_t>(&bandwidth_kib)->default_value(0), "Bandwidth of every link in each direction in KiB/s, 0 for unlimited")
+         ("loss-percent", bpo::value<double>(&loss_percent)->default_value(0), "Chance that a tcp segment has to be retransmitted")
+         ("sync-blocks", bpo::value<uint32_t>(&options.sync_block_count)->default_value(1000), "Blocks the first node has before the others start syncing")
+         ("blocks", bpo::value<uint32_t>(&options.block_count)->default_value(20), "Blocks produced after the sync")
+         ("block-interval-ms", bpo::value<uint32_t>(&options.block_interval_ms)->default_value(1000), "Time between blocks")
+         ("transactions-per-second", bpo::value<uint32_t>(&options.transactions_per_second)->default_value(100), "Transactions injected per second while blocks are produced")
+         ("transaction-size", bpo::value<uint32_t>(&options.transaction_size)->default_value(260), "Approximate size of the transactions in bytes")
+         ("max-transactions-per-block", bpo::value<uint32_t>(&options.max_transactions_per_block)->default_value(1000), "Pending transactions included in a block at most")
+         ("settle-time-ms", bpo::value<uint32_t>(&options.settle_time_ms)->default_value(3000), "Time to wait for the last items to propagate")
+         ("sync-timeout", bpo::value<uint32_t>(&options.sync_timeout_seconds)->default_value(300), "Seconds to wait for all nodes to sync")
+         ("seed", bpo::value<uint32_t>(&options.random_seed)->default_value(1), "Seed of the topology, workload and loss simulation")
+         ("json-report", bpo::value<std::string>(&json_report_filename), "Also write the results to this file as json");
+
+      bpo::variables_map vm;
+      bpo::store(bpo::parse_command_line(argc, argv, description), vm);
+      bpo::notify(vm);
+      if (vm.count("help"))
+      {
+         std::cout << description << "\n";
+         return 0;
+      }
+
+      FC_ASSERT(options.node_count >= 2, "at least two nodes are needed");
+      options.shape.bytes_per_second = bandwidth_kib * 1024;
+      options.shape.loss_rate = loss_percent / 100;
+
+      network_simulation simulation(options);
+      simulation.start();
+      simulation.run_sync_phase();
+      simulation.run_relay_phase();
+      fc::variant_object result = simulation.report();
+      simulation.stop();
+
+      if (!json_report_filename.empty())
+         fc::json::save_to_file(result, boost::filesystem::path(json_report_filename));
+      return 0;
+   }
+   catch (const fc::exception& e)
+   {
+      std::cerr << e.to_detail_string() << "\n";
+   }
+   catch (const std::exception& e)
+   {
+      std::cerr << e.what() << "\n";
+   }
+   return 1;
+}
@@ -0,0 +1,303 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include "shaped_link.hpp"
+
+#include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+namespace graphene { namespace net { namespace simulation {
+
+   namespace
+   {
+      const size_t   read_chunk_size = 16 * 1024;
+      // the reading side stops once this much is in flight in one direction, like a sender with a full tcp window
+      const size_t   maximum_bytes_in_flight = 256 * 1024;
+      const size_t   tcp_segment_size = 1448;
+      const uint32_t minimum_retransmission_timeout_ms = 200;
+
+      void wait_for(fc::promise<void>::ptr& waiter, const char* description)
+      {
+         fc::promise<void>::ptr promise(new fc::promise<void>(description));
+         waiter = promise;
+         promise->wait();
+      }
+
+      void wake(fc::promise<void>::ptr& waiter)
+      {
+         if (waiter)
+         {
+            fc::promise<void>::ptr promise = waiter;
+            waiter.reset();
+            promise->set_value();
+         }
+      }
+   }
+
+   /** one direction of a forwarded connection */
+   struct shaped_link::pipe
+   {
+      struct chunk
+      {
+         std::vector<char> data;
+         fc::time_point    delivery_time;
+      };
+
+      pipe(fc::tcp_socket& from, fc::tcp_socket& to, uint64_t& bytes_forwarded) :
+         from(from),
+         to(to),
+         bytes_forwarded(bytes_forwarded)
+      {}
+
+      fc::tcp_socket&        from;
+      fc::tcp_socket&        to;
+      uint64_t&              bytes_forwarded;
+
+      std::deque<chunk>      chunks;
+      size_t                 bytes_in_flight = 0;
+      fc::time_point         link_free_time;      ///< when the link finishes sending what is in flight
+      fc::time_point         last_delivery_time;
+      bool                   reader_done = false;
+      bool                   writer_done = false;
+      fc::promise<void>::ptr data_available;      ///< set while the writer waits for data
+      fc::promise<void>::ptr space_available;     ///< set while the reader waits for data to be delivered
+
+      fc::future<void>       read_loop_done;
+      fc::future<void>       write_loop_done;
+   };
+
+   struct shaped_link::connection
+   {
+      explicit connection(shaped_link& link) :
+         incoming(std::string()),
+         outgoing(std::string()),
+         to_target(incoming, outgoing, link._bytes_to_target),
+         from_target(outgoing, incoming, link._bytes_from_target)
+      {}
+
+      bool is_done() const
+      {
+         return to_target.read_loop_done.ready() && to_target.write_loop_done.ready() &&
+                from_target.read_loop_done.ready() && from_target.write_loop_done.ready();
+      }
+
+      fc::tcp_socket incoming; ///< accepted from the connecting node
+      fc::tcp_socket outgoing; ///< to the target
+      pipe           to_target;
+      pipe           from_target;
+   };
+
+   shaped_link::shaped_link(const fc::ip::endpoint& target_endpoint, const link_shape& shape, uint32_t random_seed) :
+      _target_endpoint(target_endpoint),
+      _shape(shape),
+      _random_generator(random_seed)
+   {
+      _server.set_reuse_address();
+      _server.listen(fc::ip::endpoint(fc::ip::address("127.0.0.1"), 0));
+      _accept_loop_done = fc::async([this]() { accept_loop(); }, "shaped_link accept_loop");
+   }
+
+   shaped_link::~shaped_link()
+   {
+      close();
+   }
+
+   fc::ip::endpoint shaped_link::get_listening_endpoint() const
+   {
+      return _server.get_local_endpoint();
+   }
+
+   void shaped_link::accept_loop()
+   {
+      while (!_accept_loop_done.canceled())
+      {
+         std::shared_ptr<connection> new_connection = std::make_shared<connection>(*this);
+         try
+         {
+            _server.accept(new_connection->incoming);
+         }
+         catch (const fc::canceled_exception&)
+         {
+            throw;
+         }
+         catch (const fc::exception&)
+         {
+            // the server was closed
+            return;
+         }
+
+         _connections.remove_if([](const std::shared_ptr<connection>& c) { return c->is_done(); });
+
+         try
+         {
+            new_connection->outgoing.connect_to(_target_endpoint);
+         }
+         catch (const fc::canceled_exception&)
+         {
+            throw;
+         }
+         catch (const fc::exception& e)
+         {
+            wlog("unable to forward connection to ${endpoint}: ${e}", ("endpoint", _target_endpoint)("e", e.to_detail_string()));
+            new_connection->incoming.close();
+            continue;
+         }
+
+         for (pipe* p : { &new_connection->to_target, &new_connection->from_target })
+         {
+            // the connection stays in _connections until all of its loops are done
+            p->read_loop_done = fc::async([this, p]() { read_loop(*p); }, "shaped_link read_loop");
+            p->write_loop_done = fc::async([this, p]() { write_loop(*p); }, "shaped_link write_loop");
+         }
+         _connections.push_back(new_connection);
+      }
+   }
+
+   fc::time_point shaped_link::get_delivery_time(pipe& p, size_t bytes)
+   {
+      fc::time_point now = fc::time_point::now();
+      fc::time_point delivery_time = now;
+      if (_shape.bytes_per_second)
+      {
+         p.link_free_time = std::max(p.link_free_time, now) + fc::microseconds(bytes * 1000000 / _shape.bytes_per_second);
+         delivery_time = p.link_free_time;
+      }
+      delivery_time += fc::milliseconds(_shape.latency_ms);
+
+      if (_shape.loss_rate > 0)
+      {
+         size_t segments = (bytes + tcp_segment_size - 1) / tcp_segment_size;
+         double chance_of_loss = 1 - std::pow(1 - _shape.loss_rate, (double)segments);
+         if (std::uniform_real_distribution<double>(0, 1)(_random_generator) < chance_of_loss)
+            delivery_time += fc::milliseconds(std::max<uint32_t>(minimum_retransmission_timeout_ms, 2 * _shape.latency_ms));
+      }
+
+      // tcp delivers in order, nothing overtakes data held up by a retransmission
+      delivery_time = std::max(delivery_time, p.last_delivery_time);
+      p.last_delivery_time = delivery_time;
+      return delivery_time;
+   }
+
+   void shaped_link::read_loop(pipe& p)
+   {
+      std::vector<char> buffer(read_chunk_size);
+      try
+      {
+         while (!p.writer_done)
+         {
+            if (p.bytes_in_flight >= maximum_bytes_in_flight)
+            {
+               wait_for(p.space_available, "shaped_link::space_available");
+               continue;
+            }
+
+            size_t bytes_read = p.from.readsome(buffer.data(), buffer.size());
+            pipe::chunk new_chunk;
+            new_chunk.data.assign(buffer.begin(), buffer.begin() + bytes_read);
+            new_chunk.delivery_time = get_delivery_time(p, bytes_read);
+            p.bytes_in_flight += bytes_read;
+            p.chunks.push_back(std::move(new_chunk));
+            wake(p.data_available);
+         }
+      }
+      catch (const fc::canceled_exception&)
+      {
+         throw;
+      }
+      catch (const fc::exception&)
+      {
+         // end of stream, the writer forwards what is still in flight and closes the other side
+      }
+      p.reader_done = true;
+      wake(p.data_available);
+   }
+
+   void shaped_link::write_loop(pipe& p)
+   {
+      bool write_failed = false;
+      try
+      {
+         for (;;)
+         {
+            if (p.chunks.empty())
+            {
+               if (p.reader_done)
+                  break;
+               wait_for(p.data_available, "shaped_link::data_available");
+               continue;
+            }
+
+            if (p.chunks.front().delivery_time > fc::time_point::now())
+               fc::sleep_until(p.chunks.front().delivery_time);
+
+            pipe::chunk next_chunk = std::move(p.chunks.front());
+            p.chunks.pop_front();
+            p.to.write(next_chunk.data.data(), next_chunk.data.size());
+            p.bytes_in_flight -= next_chunk.data.size();
+            p.bytes_forwarded += next_chunk.data.size();
+            wake(p.space_available);
+         }
+      }
+      catch (const fc::canceled_exception&)
+      {
+         throw;
+      }
+      catch (const fc::exception&)
+      {
+         write_failed = true;
+      }
+      p.writer_done = true;
+      wake(p.space_available);
+
+      try
+      {
+         p.to.close();
+         // nobody is receiving anymore, stop reading too
+         if (write_failed)
+            p.from.close();
+      }
+      catch (const fc::exception&)
+      {
+      }
+   }
+
+   void shaped_link::close()
+   {
+      try
+      {
+         _server.close();
+         if (_accept_loop_done.valid() && !_accept_loop_done.ready())
+            _accept_loop_done.cancel_and_wait("shaped_link::close()");
+      }
+      catch (const fc::exception&)
+      {
+      }
+
+      for (const std::shared_ptr<connection>& c : _connections)
+      {
+         for (fc::tcp_socket* socket : { &c->incoming, &c->outgoing })
+            try
+            {
+               socket->close();
+            }
+            catch (const fc::exception&)
+            {
+            }
+         for (pipe* p : { &c->to_target, &c->from_target })
+            for (fc::future<void>* loop_done : { &p->read_loop_done, &p->write_loop_done })
+               try
+               {
+                  if (loop_done->valid() && !loop_done->ready())
+                     loop_done->cancel_and_wait("shaped_link::close()");
+               }
+               catch (const fc::exception&)
+               {
+               }
+      }
+      _connections.clear();
+   }
+
+} } } // graphene::net::simulation
@@ -0,0 +1,63 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+
+#include <fc/network/ip.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/future.hpp>
+
+#include <list>
+#include <memory>
+#include <random>
+
+namespace graphene { namespace net { namespace simulation {
+
+   /** properties of a simulated network link, the same in both directions */
+   struct link_shape
+   {
+      uint32_t latency_ms = 0;        ///< one way delay
+      uint64_t bytes_per_second = 0;  ///< 0 for unlimited
+      double   loss_rate = 0;         ///< chance that a tcp segment is lost and has to be retransmitted
+   };
+
+   /**
+    *  Forwards the tcp connections made to its listening endpoint to a target endpoint,
+    *  delaying the data in each direction as a link with the given shape would.
+    *
+    *  The link is simulated on top of tcp, so lost segments are not dropped: a lost segment
+    *  holds up itself and everything sent after it for a retransmission timeout instead.
+    *
+    *  Must be created, used and destroyed on the same fc::thread.
+    */
+   class shaped_link
+   {
+   public:
+      shaped_link(const fc::ip::endpoint& target_endpoint, const link_shape& shape, uint32_t random_seed);
+      ~shaped_link();
+
+      fc::ip::endpoint get_listening_endpoint() const;
+      /** bytes forwarded from the connecting side to the target and back */
+      uint64_t get_bytes_to_target() const { return _bytes_to_target; }
+      uint64_t get_bytes_from_target() const { return _bytes_from_target; }
+
+      void close();
+
+   private:
+      struct pipe;
+      struct connection;
+
+      void accept_loop();
+      void read_loop(pipe& p);
+      void write_loop(pipe& p);
+      fc::time_point get_delivery_time(pipe& p, size_t bytes);
+
+      fc::ip::endpoint                         _target_endpoint;
+      link_shape                               _shape;
+      std::mt19937                             _random_generator;
+      fc::tcp_server                           _server;
+      fc::future<void>                         _accept_loop_done;
+      std::list<std::shared_ptr<connection>>   _connections;
+      uint64_t                                 _bytes_to_target = 0;
+      uint64_t                                 _bytes_from_target = 0;
+   };
+
+} } } // graphene::net::simulation
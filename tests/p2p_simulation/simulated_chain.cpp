@@ -0,0 +1,232 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include "simulated_chain.hpp"
+
+#include <graphene/net/exceptions.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net { namespace simulation {
+
+   simulated_chain::simulated_chain(const chain_id_type& chain_id, const fc::time_point_sec& genesis_time,
+                                    uint8_t block_interval_in_seconds, uint32_t maximum_block_size) :
+      _chain_id(chain_id),
+      _block_interval_in_seconds(block_interval_in_seconds),
+      _maximum_block_size(maximum_block_size),
+      _genesis_time(genesis_time)
+   {
+   }
+
+   block_message simulated_chain::produce_block(const fc::time_point_sec& timestamp, uint32_t max_transactions)
+   {
+      graphene::chain::signed_block block;
+      block.previous = get_head_block_id();
+      block.timestamp = timestamp;
+      for (const item_hash_t& transaction_id : _pending_transaction_ids)
+      {
+         if (block.transactions.size() >= max_transactions)
+            break;
+         block.transactions.push_back(graphene::chain::processed_transaction(_transactions[transaction_id].trx));
+      }
+      block.transaction_merkle_root = block.calculate_merkle_root();
+
+      block_message block_to_broadcast(block);
+      append_block(block_to_broadcast);
+      return block_to_broadcast;
+   }
+
+   trx_message simulated_chain::add_local_transaction(const signed_transaction& trx)
+   {
+      trx_message transaction_to_broadcast(trx);
+      message_hash_type transaction_id = message(transaction_to_broadcast).id();
+      if (_transactions.emplace(transaction_id, transaction_to_broadcast).second)
+         _pending_transaction_ids.insert(transaction_id);
+      return transaction_to_broadcast;
+   }
+
+   block_message simulated_chain::get_block_by_number(uint32_t block_num) const
+   {
+      FC_ASSERT(block_num >= 1 && block_num <= head_block_num(), "no block ${block_num}", ("block_num", block_num));
+      return _blocks[block_num - 1];
+   }
+
+   void simulated_chain::append_block(const block_message& block)
+   {
+      _blocks.push_back(block);
+      _block_numbers[block.block_id] = head_block_num();
+      for (const graphene::chain::processed_transaction& transaction : block.block.transactions)
+      {
+         trx_message included_transaction(transaction);
+         message_hash_type transaction_id = message(included_transaction).id();
+         _transactions.emplace(transaction_id, included_transaction);
+         _pending_transaction_ids.erase(transaction_id);
+      }
+   }
+
+   bool simulated_chain::has_item(const net::item_id& id)
+   {
+      if (id.item_type == block_message_type)
+         return _block_numbers.find(id.item_hash) != _block_numbers.end();
+      if (id.item_type == trx_message_type)
+         return _transactions.find(id.item_hash) != _transactions.end();
+      return false;
+   }
+
+   uint32_t simulated_chain::handle_block(const block_message& blk_msg, bool sync_mode,
+                                          std::vector<fc::uint160_t>& contained_transaction_message_ids)
+   {
+      if (_block_numbers.find(blk_msg.block_id) == _block_numbers.end())
+      {
+         FC_ASSERT(blk_msg.block.previous == get_head_block_id(),
+                   "block ${block_num} does not link to our head block ${head_block_num}",
+                   ("block_num", blk_msg.block.block_num())("head_block_num", head_block_num()));
+         append_block(blk_msg);
+         if (on_item_received)
+            on_item_received(item_id(block_message_type, blk_msg.block_id), fc::time_point::now());
+      }
+
+      contained_transaction_message_ids.reserve(blk_msg.block.transactions.size());
+      for (const graphene::chain::processed_transaction& transaction : blk_msg.block.transactions)
+         contained_transaction_message_ids.push_back(message(trx_message(transaction)).id());
+      return _maximum_block_size;
+   }
+
+   void simulated_chain::handle_transaction(const trx_message& trx_msg)
+   {
+      message_hash_type transaction_id = message(trx_msg).id();
+      if (!_transactions.emplace(transaction_id, trx_msg).second)
+         return;
+      _pending_transaction_ids.insert(transaction_id);
+      if (on_item_received)
+         on_item_received(item_id(trx_message_type, transaction_id), fc::time_point::now());
+   }
+
+   void simulated_chain::handle_message(const message& message_to_process)
+   {
+      FC_THROW("simulated chain does not handle messages of type ${type}", ("type", message_to_process.msg_type));
+   }
+
+   std::vector<item_hash_t> simulated_chain::get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
+                                                           uint32_t& remaining_item_count,
+                                                           uint32_t limit)
+   {
+      std::vector<item_hash_t> result;
+      remaining_item_count = 0;
+      if (_blocks.empty())
+         return result;
+
+      // an empty synopsis means the peer has no blocks
+      uint32_t last_known_block_num = 0;
+      if (!blockchain_synopsis.empty())
+      {
+         auto last_known_block = std::find_if(blockchain_synopsis.rbegin(), blockchain_synopsis.rend(),
+                                              [this](const item_hash_t& block_id) {
+                                                 return block_id == item_hash_t() || _block_numbers.find(block_id) != _block_numbers.end();
+                                              });
+         if (last_known_block == blockchain_synopsis.rend())
+            FC_THROW_EXCEPTION(peer_is_on_an_unreachable_fork_exception,
+                               "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis");
+         last_known_block_num = get_block_number(*last_known_block);
+      }
+
+      for (uint32_t block_num = std::max<uint32_t>(last_known_block_num, 1);
+           block_num <= head_block_num() && result.size() < limit;
+           ++block_num)
+         result.push_back(_blocks[block_num - 1].block_id);
+      if (!result.empty() && get_block_number(result.back()) < head_block_num())
+         remaining_item_count = head_block_num() - get_block_number(result.back());
+      return result;
+   }
+
+   message simulated_chain::get_item(const item_id& id)
+   {
+      if (id.item_type == block_message_type)
+      {
+         auto itr = _block_numbers.find(id.item_hash);
+         if (itr != _block_numbers.end())
+            return message(_blocks[itr->second - 1]);
+      }
+      else if (id.item_type == trx_message_type)
+      {
+         auto itr = _transactions.find(id.item_hash);
+         if (itr != _transactions.end())
+            return message(itr->second);
+      }
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "item ${id} not found", ("id", id));
+   }
+
+   chain_id_type simulated_chain::get_chain_id() const
+   {
+      return _chain_id;
+   }
+
+   std::vector<item_hash_t> simulated_chain::get_blockchain_synopsis(const item_hash_t& reference_point,
+                                                                     uint32_t number_of_blocks_after_reference_point)
+   {
+      // same layout as the synopsis of the real chain, without an irreversible part
+      std::vector<item_hash_t> synopsis;
+      uint32_t high_block_num = head_block_num();
+      if (reference_point != item_hash_t())
+      {
+         auto itr = _block_numbers.find(reference_point);
+         if (itr != _block_numbers.end())
+            high_block_num = itr->second;
+      }
+
+      uint32_t true_high_block_num = high_block_num + number_of_blocks_after_reference_point;
+      uint32_t low_block_num = 1;
+      do
+      {
+         if (low_block_num <= high_block_num)
+            synopsis.push_back(_blocks[low_block_num - 1].block_id);
+         low_block_num += (true_high_block_num - low_block_num + 2) / 2;
+      }
+      while (low_block_num <= high_block_num);
+      return synopsis;
+   }
+
+   void simulated_chain::sync_status(uint32_t item_type, uint32_t item_count)
+   {
+   }
+
+   void simulated_chain::connection_count_changed(uint32_t c)
+   {
+   }
+
+   uint32_t simulated_chain::get_block_number(const item_hash_t& block_id)
+   {
+      return graphene::chain::block_header::num_from_id(block_id);
+   }
+
+   fc::time_point_sec simulated_chain::get_block_time(const item_hash_t& block_id)
+   {
+      if (block_id == item_hash_t())
+         return _genesis_time;
+      auto itr = _block_numbers.find(block_id);
+      if (itr != _block_numbers.end())
+         return _blocks[itr->second - 1].block.timestamp;
+      return fc::time_point_sec::min();
+   }
+
+   fc::time_point_sec simulated_chain::get_blockchain_now()
+   {
+      return fc::time_point::now();
+   }
+
+   item_hash_t simulated_chain::get_head_block_id() const
+   {
+      return _blocks.empty() ? item_hash_t() : _blocks.back().block_id;
+   }
+
+   void simulated_chain::error_encountered(const std::string& message, const fc::optional<fc::exception>& error)
+   {
+      elog("${message}", ("message", message));
+   }
+
+   uint8_t simulated_chain::get_current_block_interval_in_seconds() const
+   {
+      return _block_interval_in_seconds;
+   }
+
+} } } // graphene::net::simulation
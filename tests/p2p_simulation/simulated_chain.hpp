@@ -0,0 +1,76 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#pragma once
+
+#include <graphene/net/node.hpp>
+#include <graphene/chain/protocol/block.hpp>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace graphene { namespace net { namespace simulation {
+
+   /**
+    *  node_delegate keeping a chain of blocks and a pool of pending transactions in memory.
+    *  Blocks are accepted when they link to the head block and transactions always,
+    *  nothing else is validated.
+    *
+    *  Like the real delegate it is called on the thread that created the node.
+    */
+   class simulated_chain : public node_delegate
+   {
+   public:
+      simulated_chain(const chain_id_type& chain_id, const fc::time_point_sec& genesis_time,
+                      uint8_t block_interval_in_seconds, uint32_t maximum_block_size);
+
+      /**
+       *  Appends a block containing up to max_transactions of the pending transactions.
+       *  The caller broadcasts it
+       */
+      block_message produce_block(const fc::time_point_sec& timestamp, uint32_t max_transactions);
+      /** adds a transaction originating on this node to the pending ones, the caller broadcasts it */
+      trx_message add_local_transaction(const signed_transaction& trx);
+
+      uint32_t      head_block_num() const { return static_cast<uint32_t>(_blocks.size()); }
+      size_t        pending_transaction_count() const { return _pending_transaction_ids.size(); }
+      block_message get_block_by_number(uint32_t block_num) const;
+
+      /** called for every block and transaction received from the network and accepted */
+      std::function<void(const item_id& item, const fc::time_point& receive_time)> on_item_received;
+
+      bool has_item( const net::item_id& id ) override;
+      uint32_t handle_block( const block_message& blk_msg, bool sync_mode,
+                             std::vector<fc::uint160_t>& contained_transaction_message_ids ) override;
+      void handle_transaction( const trx_message& trx_msg ) override;
+      void handle_message( const message& message_to_process ) override;
+      std::vector<item_hash_t> get_block_ids( const std::vector<item_hash_t>& blockchain_synopsis,
+                                              uint32_t& remaining_item_count,
+                                              uint32_t limit ) override;
+      message get_item( const item_id& id ) override;
+      chain_id_type get_chain_id() const override;
+      std::vector<item_hash_t> get_blockchain_synopsis( const item_hash_t& reference_point,
+                                                        uint32_t number_of_blocks_after_reference_point ) override;
+      void sync_status( uint32_t item_type, uint32_t item_count ) override;
+      void connection_count_changed( uint32_t c ) override;
+      uint32_t get_block_number( const item_hash_t& block_id ) override;
+      fc::time_point_sec get_block_time( const item_hash_t& block_id ) override;
+      fc::time_point_sec get_blockchain_now() override;
+      item_hash_t get_head_block_id() const override;
+      void error_encountered( const std::string& message, const fc::optional<fc::exception>& error ) override;
+      uint8_t get_current_block_interval_in_seconds() const override;
+
+   private:
+      void append_block( const block_message& block );
+
+      chain_id_type                          _chain_id;
+      uint8_t                                _block_interval_in_seconds;
+      uint32_t                               _maximum_block_size;
+      fc::time_point_sec                     _genesis_time;
+      std::vector<block_message>             _blocks; // block n is _blocks[n - 1]
+      std::map<item_hash_t, uint32_t>        _block_numbers;
+      std::map<item_hash_t, trx_message>     _transactions; // pending and included ones, by message id
+      std::set<item_hash_t>                  _pending_transaction_ids;
+   };
+
+} } } // graphene::net::simulation
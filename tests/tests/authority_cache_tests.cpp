@@ -0,0 +1,222 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/authority_cache.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+struct authority_cache_fixture : database_fixture
+{
+   /// pushes a transfer from the account signed with key, the same transfer may be pushed again
+   void push_transfer( const account_object& from, const fc::ecc::private_key& key )
+   {
+      signed_transaction tx;
+      transfer_operation op;
+      op.from = from.id;
+      op.to = account_id_type();
+      op.amount = asset( 1 );
+      tx.operations.push_back( op );
+      set_expiration( db, tx );
+      sign( tx, key );
+      PUSH_TX( db, tx, database::skip_transaction_dupe_check );
+   }
+
+   void update_account( const account_object& account, const fc::ecc::private_key& key,
+                        fc::optional<authority> owner, fc::optional<authority> active )
+   {
+      signed_transaction tx;
+      account_update_operation op;
+      op.account = account.id;
+      op.owner = owner;
+      op.active = active;
+      tx.operations.push_back( op );
+      set_expiration( db, tx );
+      sign( tx, key );
+      PUSH_TX( db, tx, database::skip_transaction_dupe_check );
+   }
+
+   static authority key_authority( const fc::ecc::private_key& key )
+   {
+      return authority( 1, public_key_type( key.get_public_key() ), 1 );
+   }
+
+   uint64_t misses() { return db.get_authority_cache().get_misses(); }
+   uint64_t hits() { return db.get_authority_cache().get_hits(); }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( authority_cache_tests, authority_cache_fixture )
+
+BOOST_AUTO_TEST_CASE( cached_result_is_reused )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      fund( nathan );
+
+      push_transfer( nathan, nathan_key );
+      uint64_t hits_before = hits();
+      uint64_t misses_before = misses();
+      push_transfer( nathan, nathan_key );
+      BOOST_CHECK_EQUAL( hits(), hits_before + 1 );
+      BOOST_CHECK_EQUAL( misses(), misses_before );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( active_change_reverifies )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      fc::ecc::private_key new_key = generate_private_key( "nathan new" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      fund( nathan );
+
+      push_transfer( nathan, nathan_key );
+      update_account( nathan, nathan_key, fc::optional<authority>(), key_authority( new_key ) );
+
+      uint64_t misses_before = misses();
+      BOOST_CHECK_THROW( push_transfer( nathan, nathan_key ), fc::exception );
+      BOOST_CHECK_EQUAL( misses(), misses_before + 1 );
+      push_transfer( nathan, new_key );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( owner_change_reverifies )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      fc::ecc::private_key new_key = generate_private_key( "nathan new" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      fund( nathan );
+
+      push_transfer( nathan, nathan_key );
+      update_account( nathan, nathan_key, key_authority( new_key ), fc::optional<authority>() );
+
+      // the active authority didn't change, the transfer is still approved but not from the cache
+      uint64_t hits_before = hits();
+      uint64_t misses_before = misses();
+      push_transfer( nathan, nathan_key );
+      BOOST_CHECK_EQUAL( hits(), hits_before );
+      BOOST_CHECK_EQUAL( misses(), misses_before + 1 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( nested_authority_change_reverifies )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      fc::ecc::private_key alice_key = generate_private_key( "alice" );
+      fc::ecc::private_key alice_new_key = generate_private_key( "alice new" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      const account_object& alice = create_account( "alice", alice_key.get_public_key() );
+      fund( nathan );
+
+      // alice signs for nathan through the account_auths of nathan's active authority
+      update_account( nathan, nathan_key, fc::optional<authority>(), authority( 1, alice.id, 1 ) );
+      push_transfer( nathan, alice_key );
+
+      // only alice changes, the cached result for nathan depends on alice's authority
+      update_account( alice, alice_key, fc::optional<authority>(), key_authority( alice_new_key ) );
+      uint64_t misses_before = misses();
+      BOOST_CHECK_THROW( push_transfer( nathan, alice_key ), fc::exception );
+      BOOST_CHECK_EQUAL( misses(), misses_before + 1 );
+      push_transfer( nathan, alice_new_key );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( pop_block_reverifies )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      fc::ecc::private_key new_key = generate_private_key( "nathan new" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      fund( nathan );
+      generate_block();
+      const authority old_active = nathan.active;
+
+      update_account( nathan, nathan_key, fc::optional<authority>(), key_authority( new_key ) );
+      generate_block();
+      push_transfer( nathan, new_key );
+
+      // undoing the block restores the old key, the new one must not stay approved
+      db.pop_block();
+      BOOST_CHECK( nathan.active == old_active );
+      uint64_t misses_before = misses();
+      BOOST_CHECK_THROW( push_transfer( nathan, new_key ), fc::exception );
+      BOOST_CHECK_EQUAL( misses(), misses_before + 1 );
+      push_transfer( nathan, nathan_key );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( max_authority_depth_change_reverifies )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      fc::ecc::private_key alice_key = generate_private_key( "alice" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      const account_object& alice = create_account( "alice", alice_key.get_public_key() );
+      fund( nathan );
+
+      update_account( nathan, nathan_key, fc::optional<authority>(), authority( 1, alice.id, 1 ) );
+      push_transfer( nathan, alice_key );
+
+      // alice is one level down, with no nesting allowed alice can't sign for nathan anymore
+      db.modify( db.get_global_properties(), []( global_property_object& p ) {
+         p.parameters.max_authority_depth = 0;
+      } );
+      uint64_t misses_before = misses();
+      BOOST_CHECK_THROW( push_transfer( nathan, alice_key ), fc::exception );
+      BOOST_CHECK_EQUAL( misses(), misses_before + 1 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( account_removal_reverifies )
+{
+   try {
+      fc::ecc::private_key nathan_key = generate_private_key( "nathan" );
+      const account_object& nathan = create_account( "nathan", nathan_key.get_public_key() );
+      const account_object& bob = create_account( "bob", generate_private_key( "bob" ).get_public_key() );
+      fund( nathan );
+
+      push_transfer( nathan, nathan_key );
+      db.remove( bob );
+
+      uint64_t hits_before = hits();
+      uint64_t misses_before = misses();
+      push_transfer( nathan, nathan_key );
+      BOOST_CHECK_EQUAL( hits(), hits_before );
+      BOOST_CHECK_EQUAL( misses(), misses_before + 1 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
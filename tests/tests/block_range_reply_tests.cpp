@@ -0,0 +1,168 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/block_range_reply.hpp>
+#include <graphene/net/peer_connection.hpp>
+
+#include <limits>
+
+using namespace graphene::net;
+
+namespace {
+
+const uint32_t max_message_size = 2 * 1024 * 1024;
+
+std::shared_ptr<const message> make_block_message( size_t data_size )
+{
+   std::shared_ptr<message> result = std::make_shared<message>();
+   result->msg_type = block_message_type;
+   result->data.resize( data_size );
+   result->size = static_cast<uint32_t>( data_size );
+   return result;
+}
+
+fetch_block_range_message make_request( size_t block_count, uint32_t max_frame_size )
+{
+   fetch_block_range_message request;
+   request.block_ids.resize( block_count );
+   request.max_frame_size = max_frame_size;
+   return request;
+}
+
+/// a node which never gets to answer, the replies are only queued
+class queueing_only_node : public peer_connection_delegate
+{
+public:
+   void on_message( peer_connection*, const message& ) override {}
+   void on_connection_closed( peer_connection* ) override {}
+   message get_message_for_item( const item_id& ) override { FC_THROW( "not expected" ); }
+   std::shared_ptr<const message> get_message_for_item_optimized( const item_id& ) override { FC_THROW( "not expected" ); }
+   std::shared_ptr<const message> get_shared_compressed_message( const message& ) override { return nullptr; }
+};
+
+peer_send_queue_status get_block_send_queue_status( const peer_connection& peer )
+{
+   for( const peer_send_queue_status& status : peer.get_send_queue_status() )
+      if( status.queue_class == "blocks" )
+         return status;
+   FC_THROW( "no block send queue" );
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(block_range_reply_tests)
+
+BOOST_AUTO_TEST_CASE( request_limit )
+{
+   BOOST_CHECK_NO_THROW( block_range_reply( make_request( GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST, 4096 ), max_message_size ) );
+   BOOST_CHECK_THROW( block_range_reply( make_request( GRAPHENE_NET_MAX_BLOCKS_PER_BLOCK_RANGE_REQUEST + 1, 4096 ), max_message_size ),
+                      fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( frame_size_limits )
+{
+   // the smallest of the requested size, our message size and the configured maximum wins
+   BOOST_CHECK_EQUAL( block_range_reply( make_request( 1, 4096 ), max_message_size ).get_max_frame_size(), 4096u );
+   BOOST_CHECK_EQUAL( block_range_reply( make_request( 1, 1024 * 1024 ), 2048 ).get_max_frame_size(), 2048u );
+   BOOST_CHECK_EQUAL( block_range_reply( make_request( 1, std::numeric_limits<uint32_t>::max() ), std::numeric_limits<uint32_t>::max() ).get_max_frame_size(),
+                      size_t( GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE ) );
+}
+
+BOOST_AUTO_TEST_CASE( split_into_frames )
+{
+   // a message of 1000 data bytes packs into 1010 bytes, four of them fit into a frame of 4096 bytes
+   block_range_reply reply( make_request( 12, 4096 ), max_message_size );
+   std::vector<std::shared_ptr<const message>> messages;
+   for( int i = 0; i < 11; ++i )
+   {
+      messages.push_back( make_block_message( i == 6 ? 5000 : 1000 ) );
+      reply.add( messages.back() );
+   }
+   std::vector<block_range_reply::frame> frames = reply.finish();
+
+   BOOST_REQUIRE_EQUAL( frames.size(), 4u );
+   BOOST_CHECK( frames[0].is_block_range );
+   BOOST_CHECK_EQUAL( frames[0].messages.size(), 4u );
+   BOOST_CHECK( frames[1].is_block_range );
+   BOOST_CHECK_EQUAL( frames[1].messages.size(), 2u );
+   // the oversized message is sent on its own, in the requested order
+   BOOST_CHECK( !frames[2].is_block_range );
+   BOOST_REQUIRE_EQUAL( frames[2].messages.size(), 1u );
+   BOOST_CHECK( frames[2].messages.front() == messages[6] );
+   BOOST_CHECK( frames[3].is_block_range );
+   BOOST_CHECK_EQUAL( frames[3].messages.size(), 4u );
+
+   // the frames hold the messages passed in, nothing is loaded again
+   size_t i = 0;
+   for( const block_range_reply::frame& frame : frames )
+      for( const std::shared_ptr<const message>& m : frame.messages )
+         BOOST_CHECK( m == messages[i++] );
+   BOOST_CHECK_EQUAL( i, messages.size() );
+}
+
+BOOST_AUTO_TEST_CASE( empty_reply )
+{
+   block_range_reply reply( make_request( 0, 4096 ), max_message_size );
+   BOOST_CHECK( reply.finish().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( pack_message_vector_matches_copied_messages )
+{
+   std::vector<std::shared_ptr<const message>> shared_messages;
+   std::vector<message> copied_messages;
+   for( size_t data_size : { 0, 1, 200, 70000 } )
+   {
+      shared_messages.push_back( make_block_message( data_size ) );
+      copied_messages.push_back( *shared_messages.back() );
+   }
+
+   message packed = pack_message_vector<block_range_message>( shared_messages );
+   message copied = block_range_message( copied_messages );
+   BOOST_CHECK_EQUAL( packed.msg_type, copied.msg_type );
+   BOOST_CHECK_EQUAL( packed.size, copied.size );
+   BOOST_CHECK( packed.data == copied.data );
+
+   message packed_batch = pack_message_vector<transaction_batch_message>( shared_messages );
+   BOOST_CHECK_EQUAL( packed_batch.msg_type, uint32_t( transaction_batch_message_type ) );
+   BOOST_CHECK_EQUAL( packed_batch.as<transaction_batch_message>().transactions.size(), shared_messages.size() );
+
+   BOOST_CHECK( pack_message_vector<block_range_message>( {} ).data == message( block_range_message() ).data );
+}
+
+BOOST_AUTO_TEST_CASE( reply_larger_than_send_queue )
+{
+   try {
+      queueing_only_node node;
+      peer_connection_ptr peer = peer_connection::make_shared( &node, "" );
+
+      // 3 MB of blocks in frames of 1 MiB, the block send queue takes 1 MiB
+      block_range_reply reply( make_request( 30, GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE ), max_message_size );
+      for( int i = 0; i < 30; ++i )
+         reply.add( make_block_message( 100 * 1000 ) );
+      std::vector<block_range_reply::frame> frames = reply.finish();
+      BOOST_REQUIRE_GT( frames.size(), 1u );
+      peer->send_block_range_reply( std::move( frames ) );
+
+      // the first frame is queued, the rest waits for the queue to drain instead of closing the connection
+      peer_send_queue_status status = get_block_send_queue_status( *peer );
+      BOOST_CHECK_EQUAL( status.queued_messages, 1u );
+      BOOST_CHECK_LE( status.queued_bytes, uint64_t( GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES ) );
+      BOOST_CHECK( peer->negotiation_status != peer_connection::connection_negotiation_status::closing );
+
+      // a block larger than the queue goes out on its own
+      peer_connection_ptr other_peer = peer_connection::make_shared( &node, "" );
+      block_range_reply large_reply( make_request( 1, GRAPHENE_NET_BLOCK_RANGE_MAX_FRAME_SIZE ), 4 * max_message_size );
+      large_reply.add( make_block_message( 2 * GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES ) );
+      other_peer->send_block_range_reply( large_reply.finish() );
+      BOOST_CHECK_EQUAL( get_block_send_queue_status( *other_peer ).queued_messages, 1u );
+      BOOST_CHECK( other_peer->negotiation_status != peer_connection::connection_negotiation_status::closing );
+
+      peer->destroy_connection();
+      other_peer->destroy_connection();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
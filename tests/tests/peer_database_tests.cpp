@@ -0,0 +1,243 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/peer_database.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+
+#include "../common/tempdir.hpp"
+
+using namespace graphene::net;
+
+namespace {
+
+potential_peer_record make_record( uint32_t n, uint32_t last_seen_offset )
+{
+   return potential_peer_record( fc::ip::endpoint( fc::ip::address( 0x0a000000 + n ), 1776 ),
+                                 fc::time_point_sec( 1500000000 + last_seen_offset ) );
+}
+
+potential_peer_record make_record( uint32_t n )
+{
+   return make_record( n, n );
+}
+
+bool contains( peer_database& db, const potential_peer_record& record )
+{
+   fc::optional<potential_peer_record> found = db.lookup_entry_for_endpoint( record.endpoint );
+   return found && found->last_seen_time == record.last_seen_time;
+}
+
+boost::filesystem::path journal_file( const boost::filesystem::path& database_file )
+{
+   return database_file.string() + ".journal";
+}
+
+/// the files as a crash would leave them: the snapshot and the journal, without the compaction at close
+boost::filesystem::path copy_files( const boost::filesystem::path& database_file, const fc::temp_directory& to_dir )
+{
+   boost::filesystem::path copy = to_dir.path() / database_file.filename();
+   boost::filesystem::copy_file( database_file, copy );
+   boost::filesystem::copy_file( journal_file( database_file ), journal_file( copy ) );
+   return copy;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(peer_database_tests)
+
+BOOST_AUTO_TEST_CASE( round_trip_across_close_and_open )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path database_file = data_dir.path() / "peers.dat";
+      {
+         peer_database db;
+         db.open( database_file );
+         for( uint32_t n = 0; n < 10; ++n )
+            db.update_entry( make_record( n ) );
+         db.update_entry( make_record( 3, 100 ) );
+         db.erase( make_record( 5 ).endpoint );
+         db.close();
+      }
+
+      peer_database db;
+      db.open( database_file );
+      BOOST_CHECK_EQUAL( db.size(), 9u );
+      BOOST_CHECK( contains( db, make_record( 3, 100 ) ) );
+      BOOST_CHECK( !db.lookup_entry_for_endpoint( make_record( 5 ).endpoint ) );
+      for( uint32_t n : { 0, 1, 2, 4, 6, 7, 8, 9 } )
+         BOOST_CHECK( contains( db, make_record( n ) ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( journal_replayed_after_crash )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory crash_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path database_file = data_dir.path() / "peers.dat";
+
+      peer_database db;
+      db.open( database_file );
+      for( uint32_t n = 0; n < 10; ++n )
+         db.update_entry( make_record( n ) );
+      db.erase( make_record( 5 ).endpoint );
+      db.flush();
+      boost::filesystem::path copy = copy_files( database_file, crash_dir );
+      BOOST_CHECK_GT( boost::filesystem::file_size( journal_file( copy ) ), 0u );
+
+      peer_database recovered;
+      recovered.open( copy );
+      BOOST_CHECK_EQUAL( recovered.size(), 9u );
+      BOOST_CHECK( !recovered.lookup_entry_for_endpoint( make_record( 5 ).endpoint ) );
+      for( uint32_t n : { 0, 1, 2, 3, 4, 6, 7, 8, 9 } )
+         BOOST_CHECK( contains( recovered, make_record( n ) ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( replay_stops_at_damaged_last_entry )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path database_file = data_dir.path() / "peers.dat";
+      peer_database db;
+      db.open( database_file );
+      for( uint32_t n = 0; n < 10; ++n )
+         db.update_entry( make_record( n ) );
+      db.flush();
+
+      // the last entry cut short, and the last entry with a changed payload byte
+      for( bool truncate : { true, false } )
+      {
+         fc::temp_directory crash_dir( graphene::utilities::temp_directory_path() );
+         boost::filesystem::path copy = copy_files( database_file, crash_dir );
+         uintmax_t journal_size = boost::filesystem::file_size( journal_file( copy ) );
+         if( truncate )
+            boost::filesystem::resize_file( journal_file( copy ), journal_size - 3 );
+         else
+         {
+            std::fstream journal( journal_file( copy ).string(), std::ios::in | std::ios::out | std::ios::binary );
+            journal.seekg( journal_size - 1 );
+            char last_byte = 0;
+            journal.read( &last_byte, 1 );
+            last_byte ^= 1;
+            journal.seekp( journal_size - 1 );
+            journal.write( &last_byte, 1 );
+         }
+
+         peer_database recovered;
+         recovered.open( copy );
+         BOOST_CHECK_EQUAL( recovered.size(), 9u );
+         for( uint32_t n = 0; n < 9; ++n )
+            BOOST_CHECK( contains( recovered, make_record( n ) ) );
+         BOOST_CHECK( !recovered.lookup_entry_for_endpoint( make_record( 9 ).endpoint ) );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( journal_compacted_when_full )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory crash_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path database_file = data_dir.path() / "peers.dat";
+      peer_database db;
+      db.open( database_file );
+
+      // the same ten peers seen again and again
+      const uint32_t entries = GRAPHENE_NET_PEER_DATABASE_MAXIMUM_JOURNAL_ENTRIES;
+      for( uint32_t i = 0; i < entries; ++i )
+         db.update_entry( make_record( i % 10, i ) );
+      db.flush();
+      BOOST_CHECK_GT( boost::filesystem::file_size( journal_file( database_file ) ), 0u );
+
+      // the next change goes into a new snapshot, the journal starts over
+      db.update_entry( make_record( 0, entries ) );
+      db.flush();
+      BOOST_CHECK_EQUAL( boost::filesystem::file_size( journal_file( database_file ) ), 0u );
+
+      peer_database recovered;
+      recovered.open( copy_files( database_file, crash_dir ) );
+      BOOST_CHECK_EQUAL( recovered.size(), 10u );
+      BOOST_CHECK( contains( recovered, make_record( 0, entries ) ) );
+      for( uint32_t n = 1; n < 10; ++n )
+         BOOST_CHECK( contains( recovered, make_record( n, entries - 10 + n ) ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( json_database_imported_once )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path database_file = data_dir.path() / "peers.dat";
+      std::vector<potential_peer_record> json_records = { make_record( 0 ), make_record( 1 ), make_record( 2 ) };
+      fc::json::save_to_file( json_records, data_dir.path() / "peers.json" );
+
+      {
+         peer_database db;
+         db.open( database_file );
+         BOOST_CHECK_EQUAL( db.size(), 3u );
+         for( const potential_peer_record& record : json_records )
+            BOOST_CHECK( contains( db, record ) );
+         db.erase( make_record( 1 ).endpoint );
+         db.close();
+      }
+
+      // peers.json is still there, the binary database wins
+      peer_database db;
+      db.open( database_file );
+      BOOST_CHECK_EQUAL( db.size(), 2u );
+      BOOST_CHECK( !db.lookup_entry_for_endpoint( make_record( 1 ).endpoint ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( size_limit_drops_peers_seen_longest_ago )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      peer_database db;
+      db.open( data_dir.path() / "peers.dat" );
+
+      const uint32_t limit = GRAPHENE_NET_MAXIMUM_PEER_DATABASE_SIZE;
+      for( uint32_t n = 0; n < limit + 10; ++n )
+         db.update_entry( make_record( n, n + 1000 ) );
+      BOOST_CHECK_EQUAL( db.size(), limit );
+      for( uint32_t n = 0; n < 10; ++n )
+         BOOST_CHECK( !db.lookup_entry_for_endpoint( make_record( n ).endpoint ) );
+      for( uint32_t n = 10; n < limit + 10; ++n )
+         BOOST_CHECK( contains( db, make_record( n, n + 1000 ) ) );
+
+      // a new peer is kept even if it was seen longest ago, the oldest of the others goes
+      db.update_entry( make_record( limit + 10, 0 ) );
+      BOOST_CHECK_EQUAL( db.size(), limit );
+      BOOST_CHECK( contains( db, make_record( limit + 10, 0 ) ) );
+      BOOST_CHECK( !db.lookup_entry_for_endpoint( make_record( 10 ).endpoint ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
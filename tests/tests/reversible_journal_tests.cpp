@@ -0,0 +1,125 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+#include <fstream>
+
+#include "../common/tempdir.hpp"
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+/// generates blocks until some of them are irreversible, the last few blocks stay reversible
+void generate_reversible_blocks( database& db )
+{
+   while( db.get_dynamic_global_properties().last_irreversible_block_num < 20 )
+      generate_block( db );
+   BOOST_REQUIRE_GT( db.head_block_num(), db.get_dynamic_global_properties().last_irreversible_block_num );
+}
+
+boost::filesystem::path journal_file( const fc::temp_directory& data_dir )
+{
+   return data_dir.path() / "database" / "reversible_blocks";
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(reversible_journal_tests)
+
+BOOST_AUTO_TEST_CASE( restore_reversible_blocks )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      block_id_type head_id;
+      block_id_type previous_id;
+      {
+         database db;
+         db.open( data_dir.path(), make_test_genesis );
+         generate_reversible_blocks( db );
+         head_id = db.head_block_id();
+         previous_id = db.fetch_block_by_id( head_id )->previous;
+         db.close();
+         BOOST_CHECK( exists( journal_file( data_dir ) ) );
+      }
+      {
+         database db;
+         db.open( data_dir.path(), make_test_genesis );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         // a loaded journal is removed, it is written again on close
+         BOOST_CHECK( !exists( journal_file( data_dir ) ) );
+
+         // the undo history is back, so the head block can be popped
+         db.pop_block();
+         BOOST_CHECK( db.head_block_id() == previous_id );
+         generate_block( db );
+         BOOST_CHECK_EQUAL( db.head_block_num(), block_header::num_from_id( head_id ) );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( replay_on_corrupt_journal )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      block_id_type head_id;
+      {
+         database db;
+         db.open( data_dir.path(), make_test_genesis );
+         generate_reversible_blocks( db );
+         head_id = db.head_block_id();
+         db.close();
+      }
+
+      BOOST_REQUIRE( exists( journal_file( data_dir ) ) );
+      {
+         std::fstream journal( journal_file( data_dir ).generic_string(), std::fstream::binary | std::fstream::in | std::fstream::out );
+         journal.seekp( 0, journal.end );
+         std::streamoff size = journal.tellp();
+         journal.seekp( size / 2 );
+         journal.put( 0x55 );
+      }
+
+      database db;
+      db.open( data_dir.path(), make_test_genesis );
+      // the state is rebuilt from the block database instead of being left without undo history
+      BOOST_CHECK( db.head_block_id() == head_id );
+      BOOST_CHECK( !exists( journal_file( data_dir ) ) );
+      generate_block( db );
+      BOOST_CHECK_EQUAL( db.head_block_num(), block_header::num_from_id( head_id ) + 1 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( no_journal_on_wipe )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db;
+      db.open( data_dir.path(), make_test_genesis );
+      generate_reversible_blocks( db );
+
+      db.wipe( data_dir.path(), false );
+      BOOST_CHECK( !exists( journal_file( data_dir ) ) );
+      BOOST_CHECK( !exists( data_dir.path() / "object_database" ) );
+
+      // the wiped state is not kept in memory either
+      db.open( data_dir.path(), make_test_genesis );
+      BOOST_CHECK_EQUAL( db.head_block_num(), 0u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
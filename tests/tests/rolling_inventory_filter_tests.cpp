@@ -0,0 +1,104 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/rolling_inventory_filter.hpp>
+
+#include <fc/crypto/ripemd160.hpp>
+
+#include <set>
+
+using namespace graphene::net;
+
+namespace {
+
+const uint64_t items_per_generation = GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION;
+
+item_id make_item( uint64_t n )
+{
+   return item_id( trx_message_type, fc::ripemd160::hash( reinterpret_cast<const char*>( &n ), sizeof(n) ) );
+}
+
+/// items numbered from first on which were never inserted, and are reported anyway
+std::set<uint64_t> false_positives( const rolling_inventory_filter& filter, uint64_t first, uint64_t count )
+{
+   std::set<uint64_t> result;
+   for( uint64_t n = first; n < first + count; ++n )
+      if( filter.contains( make_item( n ) ) )
+         result.insert( n );
+   return result;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(rolling_inventory_filter_tests)
+
+BOOST_AUTO_TEST_CASE( inserted_items_are_found )
+{
+   rolling_inventory_filter filter;
+   BOOST_CHECK( !filter.contains( make_item( 0 ) ) );
+
+   for( uint64_t n = 0; n < 1000; ++n )
+      filter.insert( make_item( n ) );
+   BOOST_CHECK_EQUAL( filter.size(), 1000u );
+   for( uint64_t n = 0; n < 1000; ++n )
+      BOOST_CHECK( filter.contains( make_item( n ) ) );
+
+   filter.clear();
+   BOOST_CHECK_EQUAL( filter.size(), 0u );
+   BOOST_CHECK( !filter.contains( make_item( 0 ) ) );
+}
+
+BOOST_AUTO_TEST_CASE( rotation_expires_old_items )
+{
+   rolling_inventory_filter filter;
+   const uint64_t old_items = 1000;
+
+   // the first generation holds the old items, all three generations fill up
+   for( uint64_t n = 0; n < 3 * items_per_generation; ++n )
+      filter.insert( make_item( n ) );
+   BOOST_CHECK_EQUAL( filter.size(), 3 * items_per_generation );
+   for( uint64_t n = 0; n < old_items; ++n )
+      BOOST_CHECK( filter.contains( make_item( n ) ) );
+
+   // the next item reuses the first generation
+   filter.insert( make_item( 3 * items_per_generation ) );
+   BOOST_CHECK_EQUAL( filter.size(), 2 * items_per_generation + 1 );
+   BOOST_CHECK( filter.contains( make_item( 3 * items_per_generation ) ) );
+   BOOST_CHECK( filter.contains( make_item( items_per_generation ) ) );
+
+   // what is still reported of the old items are false positives of the two other generations
+   BOOST_CHECK_LE( false_positives( filter, 0, old_items ).size(), 5u );
+}
+
+BOOST_AUTO_TEST_CASE( false_positive_rate )
+{
+   rolling_inventory_filter filter;
+   for( uint64_t n = 0; n < 3 * items_per_generation; ++n )
+      filter.insert( make_item( n ) );
+
+   // about 1 in 10^4 per generation, three full generations stay well below 1 in 10^3
+   const uint64_t probes = 1000000;
+   size_t reported = false_positives( filter, 3 * items_per_generation, probes ).size();
+   BOOST_TEST_MESSAGE( "false positives: " << reported << " of " << probes );
+   BOOST_CHECK_LT( reported, probes / 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( salts_differ_between_filters )
+{
+   // with the same items, filters keyed alike would report the same false positives
+   rolling_inventory_filter first;
+   rolling_inventory_filter second;
+   for( uint64_t n = 0; n < 3 * items_per_generation; ++n )
+   {
+      first.insert( make_item( n ) );
+      second.insert( make_item( n ) );
+   }
+
+   const uint64_t probes = 1000000;
+   std::set<uint64_t> first_false_positives = false_positives( first, 3 * items_per_generation, probes );
+   std::set<uint64_t> second_false_positives = false_positives( second, 3 * items_per_generation, probes );
+   BOOST_REQUIRE( !first_false_positives.empty() || !second_false_positives.empty() );
+   BOOST_CHECK( first_false_positives != second_false_positives );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
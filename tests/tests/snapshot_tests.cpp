@@ -0,0 +1,135 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+#include "../common/tempdir.hpp"
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+/// generates blocks until some of them are irreversible and exports the state
+state_snapshot_header export_snapshot( database& db, const boost::filesystem::path& snapshot_file )
+{
+   while( db.get_dynamic_global_properties().last_irreversible_block_num < 20 )
+      generate_block( db );
+   return db.export_state_snapshot( snapshot_file );
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(snapshot_tests)
+
+BOOST_AUTO_TEST_CASE( import_and_push_next_block )
+{
+   try {
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory target_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path snapshot_file = source_dir.path() / "state.snapshot";
+
+      database source;
+      source.open( source_dir.path(), make_test_genesis );
+      state_snapshot_header header = export_snapshot( source, snapshot_file );
+      BOOST_CHECK( header.head_block_id == source.head_block_id() );
+      BOOST_CHECK_EQUAL( header.version, state_snapshot_header::current_version );
+
+      database target;
+      target.set_state_snapshot_to_import( snapshot_file );
+      target.open( target_dir.path(), make_test_genesis );
+      BOOST_CHECK_EQUAL( target.head_block_num(), header.head_block_num );
+      BOOST_CHECK( target.head_block_id() == header.head_block_id );
+      // the head block is known, so the node can report it and link the next one
+      BOOST_CHECK( target.get_block_id_for_num( header.head_block_num ) == header.head_block_id );
+      BOOST_CHECK( target.is_known_block( header.head_block_id ) );
+      BOOST_REQUIRE( target.fetch_block_by_id( header.head_block_id ).valid() );
+
+      for( uint32_t i = 0; i < 5; ++i )
+         PUSH_BLOCK( target, generate_block( source ) );
+      BOOST_CHECK_EQUAL( target.head_block_num(), header.head_block_num + 5 );
+      BOOST_CHECK( target.head_block_id() == source.head_block_id() );
+
+      // the node continues with its own blocks as well
+      generate_block( target );
+      BOOST_CHECK_EQUAL( target.head_block_num(), header.head_block_num + 6 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reopen_and_reindex_after_import )
+{
+   try {
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory target_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path snapshot_file = source_dir.path() / "state.snapshot";
+
+      database source;
+      source.open( source_dir.path(), make_test_genesis );
+      state_snapshot_header header = export_snapshot( source, snapshot_file );
+
+      block_id_type head_id;
+      {
+         database target;
+         target.set_state_snapshot_to_import( snapshot_file );
+         target.open( target_dir.path(), make_test_genesis );
+         for( uint32_t i = 0; i < 10; ++i )
+            PUSH_BLOCK( target, generate_block( source ) );
+         head_id = target.head_block_id();
+         target.close();
+      }
+      {
+         database target;
+         target.open( target_dir.path(), make_test_genesis );
+         BOOST_CHECK( target.head_block_id() == head_id );
+         target.reindex( target_dir.path(), make_test_genesis() );
+         BOOST_CHECK( target.head_block_id() == head_id );
+         BOOST_CHECK( target.get_block_id_for_num( header.head_block_num ) == header.head_block_id );
+
+         PUSH_BLOCK( target, generate_block( source ) );
+         BOOST_CHECK( target.head_block_id() == source.head_block_id() );
+      }
+
+      // without the snapshot the missing history can not be replayed
+      boost::filesystem::remove( snapshot_file );
+      {
+         database target;
+         target.open( target_dir.path(), make_test_genesis );
+         BOOST_CHECK_THROW( target.reindex( target_dir.path(), make_test_genesis() ), fc::exception );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reject_other_chain )
+{
+   try {
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory target_dir( graphene::utilities::temp_directory_path() );
+      boost::filesystem::path snapshot_file = source_dir.path() / "state.snapshot";
+
+      database source;
+      source.open( source_dir.path(), make_test_genesis );
+      export_snapshot( source, snapshot_file );
+
+      database target;
+      target.set_state_snapshot_to_import( snapshot_file );
+      BOOST_CHECK_THROW( target.open( target_dir.path(), [] {
+         genesis_state_type genesis = make_test_genesis();
+         genesis.initial_timestamp = time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP + GRAPHENE_DEFAULT_BLOCK_INTERVAL );
+         return genesis;
+      } ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,249 @@
+/* (c) 2016, 2021 FFF Services. For details refers to LICENSE.txt */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace graphene::net;
+
+namespace {
+
+/// two stcp_sockets connected over loopback, done with the key exchange
+struct connected_sockets
+{
+   fc::tcp_server listener;
+   stcp_socket    client;
+   stcp_socket    server;
+
+   connected_sockets() : client( "" ), server( "" )
+   {
+      listener.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+      fc::future<void> accepted = fc::async( [&]() {
+         listener.accept( server.get_socket() );
+         server.accept();
+      }, "stcp_socket_tests accept" );
+      client.connect_to( listener.get_local_endpoint() );
+      accepted.wait();
+   }
+   ~connected_sockets()
+   {
+      client.close();
+      server.close();
+   }
+};
+
+std::vector<char> make_data( size_t size, char seed )
+{
+   std::vector<char> data( size );
+   for( size_t i = 0; i < size; ++i )
+      data[i] = char( seed + i % 251 );
+   return data;
+}
+
+/// reads exactly size bytes, with reads of at most max_read bytes
+std::vector<char> read_exactly( stcp_socket& socket, size_t size, size_t max_read )
+{
+   std::vector<char> data( size );
+   for( size_t received = 0; received < size; )
+      received += socket.readsome( data.data() + received, std::min( max_read, size - received ) );
+   return data;
+}
+
+// a record is a header of 16 bytes, the ciphertext and a tag of 16 bytes
+const size_t record_header_size = 16;
+const size_t record_overhead = record_header_size + 16;
+
+/**
+ *  Lets the client send data as one record and takes the record off the wire before the server
+ *  reads it, so a test can pass it on as it is or changed in one place with write_raw()
+ */
+std::vector<char> capture_record( connected_sockets& sockets, const std::vector<char>& data )
+{
+   sockets.client.write_gather( { { data.data(), data.size() } } );
+   sockets.client.flush();
+   std::vector<char> record( record_overhead + data.size() );
+   sockets.server.get_socket().read( record.data(), record.size() );
+   return record;
+}
+
+void write_raw( connected_sockets& sockets, const std::vector<char>& record )
+{
+   sockets.client.get_socket().write( record.data(), record.size() );
+   sockets.client.get_socket().flush();
+}
+
+/// a pair of sockets which switched to authenticated records
+struct authenticated_sockets : connected_sockets
+{
+   authenticated_sockets()
+   {
+      client.start_authenticated_send();
+      server.start_authenticated_receive( 0 );
+   }
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(stcp_socket_tests)
+
+BOOST_AUTO_TEST_CASE( records_of_all_sizes )
+{
+   try {
+      connected_sockets sockets;
+      sockets.client.start_authenticated_send();
+      sockets.server.start_authenticated_receive( 0 );
+
+      // a single block, several records in one write, records split over several reads
+      for( size_t size : { 16u, 4096u, 64u * 1024, 64u * 1024 + 16, 3u * 64 * 1024 + 48 } )
+      {
+         std::vector<char> sent = make_data( size, char( size ) );
+         sockets.client.write_gather( { { sent.data(), sent.size() } } );
+         sockets.client.flush();
+         BOOST_CHECK( read_exactly( sockets.server, size, 1024 ) == sent );
+
+         sockets.client.write_gather( { { sent.data(), sent.size() } } );
+         sockets.client.flush();
+         BOOST_CHECK( read_exactly( sockets.server, size, 128 * 1024 ) == sent );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( switch_within_one_read )
+{
+   try {
+      connected_sockets sockets;
+      const size_t legacy_size = 32;
+      std::vector<char> legacy_data = make_data( legacy_size, 1 );
+      std::vector<char> authenticated_data = make_data( 48, 2 );
+
+      // as message_oriented_connection does it: the last message of the aes stream, then records right behind it
+      sockets.client.write_gather( { { legacy_data.data(), legacy_data.size() } } );
+      sockets.client.start_authenticated_send();
+      sockets.client.write_gather( { { authenticated_data.data(), authenticated_data.size() } } );
+      sockets.client.flush();
+      fc::usleep( fc::milliseconds( 100 ) );
+
+      // the read picks up the record too, it must not wait for bytes that were never sent
+      std::vector<char> received( 64 * 1024 );
+      size_t received_size = 0;
+      while( received_size < legacy_size )
+         received_size += sockets.server.readsome( received.data() + received_size, received.size() - received_size );
+      BOOST_CHECK_EQUAL( received_size % 16, 0u );
+      BOOST_CHECK( std::equal( legacy_data.begin(), legacy_data.end(), received.begin() ) );
+
+      sockets.server.start_authenticated_receive( received_size - legacy_size );
+      BOOST_CHECK( read_exactly( sockets.server, authenticated_data.size(), 1024 ) == authenticated_data );
+
+      // and the records keep flowing
+      sockets.client.write_gather( { { legacy_data.data(), legacy_data.size() } } );
+      sockets.client.flush();
+      BOOST_CHECK( read_exactly( sockets.server, legacy_data.size(), 1024 ) == legacy_data );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( record_size_is_little_endian )
+{
+   try {
+      authenticated_sockets sockets;
+      std::vector<char> data = make_data( 48, 3 );
+
+      std::vector<char> record = capture_record( sockets, data );
+      BOOST_CHECK_EQUAL( int( record[0] ), 48 );
+      BOOST_CHECK( std::all_of( record.begin() + 1, record.begin() + record_header_size, []( char c ) { return c == 0; } ) );
+      write_raw( sockets, record );
+      BOOST_CHECK( read_exactly( sockets.server, data.size(), 1024 ) == data );
+
+      // the next record with its size written big endian, nothing else differs
+      record = capture_record( sockets, data );
+      std::swap( record[0], record[3] );
+      write_raw( sockets, record );
+      char buffer[64];
+      BOOST_CHECK_THROW( sockets.server.readsome( buffer, sizeof(buffer) ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reject_reserved_header_bytes )
+{
+   try {
+      authenticated_sockets sockets;
+      std::vector<char> record = capture_record( sockets, make_data( 48, 4 ) );
+      record[8] = 1;
+      write_raw( sockets, record );
+      char buffer[64];
+      BOOST_CHECK_THROW( sockets.server.readsome( buffer, sizeof(buffer) ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reject_changed_records )
+{
+   try {
+      const size_t data_size = 48;
+      // a byte of the size, of the ciphertext, the first and the last byte of the tag
+      for( size_t offset : { size_t( 0 ), record_header_size + 5, record_header_size + data_size,
+                             record_overhead + data_size - 1 } )
+      {
+         authenticated_sockets sockets;
+         std::vector<char> record = capture_record( sockets, make_data( data_size, 5 ) );
+         record[offset] ^= 0x10;
+         write_raw( sockets, record );
+         char buffer[64];
+         BOOST_CHECK_THROW( sockets.server.readsome( buffer, sizeof(buffer) ), fc::exception );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reject_replayed_records )
+{
+   try {
+      authenticated_sockets sockets;
+      std::vector<char> data = make_data( 48, 6 );
+      std::vector<char> record = capture_record( sockets, data );
+      write_raw( sockets, record );
+      BOOST_CHECK( read_exactly( sockets.server, data.size(), 1024 ) == data );
+
+      write_raw( sockets, record );
+      char buffer[64];
+      BOOST_CHECK_THROW( sockets.server.readsome( buffer, sizeof(buffer) ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reject_reordered_records )
+{
+   try {
+      authenticated_sockets sockets;
+      std::vector<char> first = capture_record( sockets, make_data( 48, 7 ) );
+      std::vector<char> second = capture_record( sockets, make_data( 48, 8 ) );
+      write_raw( sockets, second );
+      write_raw( sockets, first );
+      char buffer[64];
+      BOOST_CHECK_THROW( sockets.server.readsome( buffer, sizeof(buffer) ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()